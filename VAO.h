@@ -2,18 +2,71 @@
 #define RENDERER_H
 
 #include "shader.h"
+#include "vertexLayout.h"
 #include <string>
 #include <vector>
 
 using namespace std;
 
+/* Describes how one vertex attribute is stored in the VBO */
+struct VertexAttrib {
+    unsigned int components; // eg. 3 for a vec3 (GL_INT_2_10_10_10_REV must be 4)
+    GLenum type = GL_FLOAT; // GL_FLOAT, GL_HALF_FLOAT, GL_SHORT, GL_INT_2_10_10_10_REV ...
+    bool normalized = false; // map integer types to [-1, 1] rather than converting directly
+};
+
+/* Returns the number of bytes an attribute takes up in a vertex */
+inline unsigned int attribBytes(const VertexAttrib &attrib) {
+    switch (attrib.type) {
+        case GL_BYTE: case GL_UNSIGNED_BYTE: return attrib.components;
+        case GL_SHORT: case GL_UNSIGNED_SHORT: case GL_HALF_FLOAT: return attrib.components * 2;
+        case GL_INT_2_10_10_10_REV: case GL_UNSIGNED_INT_2_10_10_10_REV: return 4; // all 4 components share one word
+        default: return attrib.components * 4; // GL_FLOAT, GL_INT, GL_UNSIGNED_INT
+    }
+}
+
+/* A sorted set of [begin, end) ranges, where touching or overlapping ranges are merged into one */
+class DirtyRanges {
+public:
+    struct Range { unsigned int begin, end; };
+
+    void add(unsigned int begin, unsigned int end) {
+        if (begin >= end) return;
+
+        /* find the first range that ends at or after our start, as it may touch us */
+        auto it = ranges.begin();
+        while (it != ranges.end() && it->end < begin) it++;
+
+        /* swallow every range we touch */
+        auto last = it;
+        while (last != ranges.end() && last->begin <= end) {
+            begin = min(begin, last->begin);
+            end = max(end, last->end);
+            last++;
+        }
+        it = ranges.erase(it, last);
+        ranges.insert(it, {begin, end});
+    }
+    void clear() { ranges.clear(); }
+    bool empty() const { return ranges.empty(); }
+
+    const vector<Range>& get() const { return ranges; }
+
+private:
+    vector<Range> ranges;
+};
+
 /* This class encapsulates VAOs to streamline rendering */
 class MyVAO {
     unsigned int VAO, VBO;
+    unsigned int EBO = 0; // only made once indices are added
+    unsigned int numIndices = 0;
 
     unsigned int stride = 0; // the stride between each vertex in the VBO
     unsigned int numVertices = 0; 
 
+    DirtyRanges dirty; // vertex ranges changed on the CPU but not yet uploaded
+
 public:
     MyVAO() {
         /* Gen the VAO and VBO */
@@ -26,44 +79,168 @@ public:
         glBindVertexArray(0); // unbind the VAO
     }
     void addAttrib(unsigned int attribSizes[], unsigned int numAttributes) {
+        /* attribSize is the size of the attributes (eg. 3 for a vec3), all stored as floats */
+        vector<VertexAttrib> attribs;
+        for (unsigned int id = 0; id < numAttributes; id++) {
+            attribs.push_back({attribSizes[id], GL_FLOAT, false});
+        }
+
+        addAttrib(attribs.data(), numAttributes);
+    }
+    void addAttrib(const VertexAttrib attribs[], unsigned int numAttributes) {
         /* Attributes are added one at a time with IDs in {1, ..} */
-        /* attribSize is the size of the attributes (eg. 3 for a vec3) */
         /* Attributes may only be added after data */
         
         /* First bind the VAO and VBO to configure attributes */
         glBindVertexArray(VAO); 
 
-        unsigned int startIndex = 0; // index from which the attribute starts
-        for (int id = 0; id < numAttributes; id++) {
-            unsigned int attribSize = attribSizes[id];
+        size_t startIndex = 0; // index from which the attribute starts
+        for (unsigned int id = 0; id < numAttributes; id++) {
+            const VertexAttrib &attrib = attribs[id];
 
-            glVertexAttribPointer(id, attribSize, GL_FLOAT, GL_FALSE, stride, (void*)startIndex);
+            /* integer types reach the shader as floats, either normalized or converted directly */
+            glVertexAttribPointer(id, attrib.components, attrib.type, attrib.normalized ? GL_TRUE : GL_FALSE, stride, (void*)startIndex);
             glEnableVertexAttribArray(id);
 
-            startIndex += attribSize * sizeof(float);
+            /* keep each attribute 4-byte aligned, as most hardware fetches words */
+            startIndex += (attribBytes(attrib) + 3) & ~3u;
         }
         
         /* Unbind the VAO */
         glBindVertexArray(0);
     }
-    void addData(float vertices[], unsigned int numVerticesIn, unsigned int strideIn) {
+    void addData(const void* vertices, unsigned int numVerticesIn, unsigned int strideIn, GLenum usage = GL_STATIC_DRAW) {
+        /* strideIn is the size of one vertex in bytes */
+        /* usage should be GL_DYNAMIC_DRAW if the data will be updated with markDirty */
         glBindVertexArray(VAO); // bind the VAO
+        glBindBuffer(GL_ARRAY_BUFFER, VBO); // the array buffer binding isn't part of the VAO's state
 
         numVertices = numVerticesIn;
         stride = strideIn;
 
-        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * stride * numVertices, &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)stride * numVertices, vertices, usage);
 
         glBindVertexArray(0); // unbind the VAO
     }
+    template <typename Layout, typename Vertex>
+    void addData(std::span<const Vertex> vertices, GLenum usage = GL_STATIC_DRAW) {
+        /* Uploads typed vertices and configures their attributes from the layout in one go */
+        /* A vertex struct that doesn't match the layout is a compile error */
+        Layout::template check<Vertex>();
+
+        glBindVertexArray(VAO); // bind the VAO
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+        numVertices = (unsigned int)vertices.size();
+        stride = Layout::stride;
+
+        glBufferData(GL_ARRAY_BUFFER, vertices.size_bytes(), vertices.data(), usage);
+        Layout::apply();
+
+        glBindVertexArray(0); // unbind the VAO
+    }
+    void addIndices(const unsigned int indices[], unsigned int numIndicesIn, GLenum usage = GL_STATIC_DRAW) {
+        /* gives the VAO an element buffer, so vertices can be shared between triangles */
+        if (!EBO) glGenBuffers(1, &EBO);
+        numIndices = numIndicesIn;
+
+        glBindVertexArray(VAO); // the element buffer binding is part of the VAO's state
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)sizeof(unsigned int) * numIndices, indices, usage);
+        glBindVertexArray(0);
+    }
+    void* mapData(unsigned int numVerticesIn) {
+        /* orphans the VBO and maps room for numVerticesIn vertices, to stream this frame's vertices straight in.
+        Orphaning means it never waits on the GPU drawing the last ones. Call unmapData before drawing */
+        numVertices = numVerticesIn;
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)stride * max(numVertices, 1u), nullptr, GL_STREAM_DRAW);
+        void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, (GLsizeiptr)stride * max(numVertices, 1u), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return mapped;
+    }
+    bool unmapData() {
+        /* false if the buffer's contents were lost while it was mapped, so nothing should be drawn from it this frame */
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        bool ok = glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (!ok) numVertices = 0;
+        return ok;
+    }
+    void markDirty(unsigned int firstVertex, unsigned int count) {
+        /* Records that these vertices have changed on the CPU, adjacent ranges are coalesced */
+        dirty.add(firstVertex, min(firstVertex + count, numVertices));
+    }
+    size_t numDirtyRanges() const { return dirty.get().size(); }
+    size_t uploadDirty(const void* vertices) {
+        /* Uploads just the dirty ranges from vertices, the full CPU copy of the buffer */
+        /* Returns the number of bytes uploaded */
+        size_t bytes = 0;
+        if (dirty.empty()) return bytes;
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        for (const DirtyRanges::Range &range: dirty.get()) {
+            size_t offset = (size_t)range.begin * stride;
+            size_t size = (size_t)(range.end - range.begin) * stride;
+
+            glBufferSubData(GL_ARRAY_BUFFER, offset, size, (const unsigned char*)vertices + offset);
+            bytes += size;
+        }
+        dirty.clear();
+
+        return bytes;
+    }
     void draw() {
         glBindVertexArray(VAO); // bind the VAO
         glDrawArrays(GL_TRIANGLES, 0, numVertices);
         glBindVertexArray(0); // unbind the VAO
     }
+    size_t sizeBytes() const {
+        /* the size of the vertex data held in the VBO */
+        return (size_t)stride * numVertices;
+    }
+    void bind() {
+        /* binds the VAO and its VBO, eg. to add attributes from other buffers */
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    }
+    void unbind() {
+        glBindVertexArray(0);
+    }
+    void addInstanceAttrib(unsigned int id, unsigned int buffer, const VertexAttrib &attrib, size_t offset, unsigned int attribStride = 0) {
+        /* an attribute read from another buffer once per instance rather than per vertex, at offset bytes in with attribStride between instances */
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glVertexAttribPointer(id, attrib.components, attrib.type, attrib.normalized ? GL_TRUE : GL_FALSE, attribStride, (void*)offset);
+        glEnableVertexAttribArray(id);
+        glVertexAttribDivisor(id, 1);
+        glBindVertexArray(0);
+    }
+    void drawInstanced(unsigned int numInstances) {
+        /* draws every vertex once per instance, in one call */
+        glBindVertexArray(VAO); // bind the VAO
+        glDrawArraysInstanced(GL_TRIANGLES, 0, numVertices, numInstances);
+        glBindVertexArray(0); // unbind the VAO
+    }
+    void drawRanges(const GLint firsts[], const GLsizei counts[], unsigned int numRanges) {
+        /* draws just these [first, first + count) vertex ranges, in one call */
+        if (numRanges == 0) return;
+        glBindVertexArray(VAO); // bind the VAO
+        glMultiDrawArrays(GL_TRIANGLES, firsts, counts, numRanges);
+        glBindVertexArray(0); // unbind the VAO
+    }
+    void drawIndexed(unsigned int firstIndex, unsigned int count) {
+        /* draws triangles from [firstIndex, firstIndex + count) of the element buffer */
+        glBindVertexArray(VAO); // bind the VAO
+        glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * firstIndex));
+        glBindVertexArray(0); // unbind the VAO
+    }
+    unsigned int getNumVertices() const { return numVertices; }
+    unsigned int getNumIndices() const { return numIndices; }
     void del() {
         glDeleteVertexArrays(1, &VAO);
         glDeleteBuffers(1, &VBO);
+        if (EBO) glDeleteBuffers(1, &EBO);
     }
 };
 
@@ -0,0 +1,117 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+/* A bump allocator for short-lived CPU staging data (eg. geometry before upload).
+Allocations are never freed individually, instead the arena is rewound to a marker,
+and the blocks it grabbed from the system are kept for the next round. */
+class ScratchArena {
+    struct Block {
+        unique_ptr<unsigned char[]> memory;
+        size_t size = 0;
+        size_t used = 0;
+    };
+
+    vector<Block> blocks;
+    size_t current = 0; // the block we are bumping in
+    size_t blockSize;
+
+    /* stats, so churn and peak use are measurable */
+    size_t inUse = 0, peak = 0, reserved = 0;
+    size_t systemAllocs = 0, allocs = 0;
+
+public:
+    /* a position in the arena that it can be rewound to */
+    struct Marker {
+        size_t block = 0;
+        size_t used = 0;
+        size_t inUse = 0;
+    };
+
+    ScratchArena(size_t blockSizeIn = 16 << 20) : blockSize(blockSizeIn) {}
+
+    void* alloc(size_t bytes, size_t align = alignof(max_align_t)) {
+        /* find the first block from the current one with room, otherwise grab a new one */
+        allocs ++;
+        while (current < blocks.size()) {
+            Block &block = blocks[current];
+            size_t start = (block.used + align - 1) & ~(align - 1);
+            if (start + bytes <= block.size) {
+                inUse += start + bytes - block.used;
+                block.used = start + bytes;
+                if (inUse > peak) peak = inUse;
+                return block.memory.get() + start;
+            }
+            inUse += block.size - block.used; // the tail of this block is wasted until reset
+            block.used = block.size;
+            current ++;
+        }
+
+        Block block;
+        block.size = bytes + align > blockSize ? bytes + align : blockSize;
+        block.memory.reset(new unsigned char[block.size]);
+        reserved += block.size;
+        systemAllocs ++;
+        blocks.push_back(std::move(block));
+
+        return alloc(bytes, align);
+    }
+
+    template <typename T>
+    T* alloc(size_t count) {
+        /* only for types that need no destructor, as the arena never runs one */
+        static_assert(is_trivially_destructible_v<T>, "arena allocations are never destroyed");
+        return static_cast<T*>(alloc(sizeof(T) * count, alignof(T)));
+    }
+
+    Marker mark() const {
+        if (current < blocks.size()) return {current, blocks[current].used, inUse};
+        return {current, 0, inUse};
+    }
+
+    void reset(const Marker &marker) {
+        /* rewind everything allocated after the marker, keeping the blocks */
+        for (size_t i = marker.block + 1; i < blocks.size(); i++) blocks[i].used = 0;
+        if (marker.block < blocks.size()) blocks[marker.block].used = marker.used;
+        current = marker.block;
+        inUse = marker.inUse;
+    }
+    void reset() { reset(Marker()); }
+
+    void release() {
+        /* give every block back to the system */
+        blocks.clear();
+        current = 0;
+        inUse = 0;
+        reserved = 0;
+    }
+
+    size_t bytesInUse() const { return inUse; }
+    size_t peakBytes() const { return peak; }
+    size_t reservedBytes() const { return reserved; }
+    size_t systemAllocations() const { return systemAllocs; }
+    size_t allocations() const { return allocs; }
+};
+
+/* Rewinds an arena to where it was when the scope was opened */
+class ArenaScope {
+    ScratchArena &arena;
+    ScratchArena::Marker marker;
+
+public:
+    ArenaScope(ScratchArena &arenaIn) : arena(arenaIn), marker(arenaIn.mark()) {}
+    ~ArenaScope() { arena.reset(marker); }
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+};
+
+#endif
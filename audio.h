@@ -0,0 +1,305 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include "fft.h"
+#include "simulation.h"
+#include "timing.h"
+#include "tripleBuffer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <math.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/* ---------------------------- WAV stream ---------------------------- */
+/* Reads a WAV file a little at a time, as mono floats from -1 to 1, going back to the start when it runs out.
+Takes 8, 16, 24 and 32 bit PCM and 32 bit float, in plain or extensible format chunks, with any number of channels, which are averaged. */
+class WavStream {
+    ifstream file;
+    unsigned int channels = 0, bytesPerSample = 0, rate = 0;
+    bool isFloat = false;
+    streampos dataStart = 0;
+    uint64_t dataFrames = 0, position = 0; // in frames, ie. a sample of every channel
+    vector<uint8_t> raw;
+
+    static uint32_t little(const uint8_t* p, int bytes) {
+        uint32_t value = 0;
+        for (int i = 0; i < bytes; i++) value |= (uint32_t)p[i] << (8 * i);
+        return value;
+    }
+
+    float sample(const uint8_t* p) const {
+        switch (bytesPerSample) {
+            case 1: return (p[0] - 128) / 128.0f; // 8 bit is unsigned
+            case 2: return (int16_t)little(p, 2) / 32768.0f;
+            case 3: return (int32_t)(little(p, 3) << 8) / 2147483648.0f;
+            default:
+                if (isFloat) {
+                    float value;
+                    memcpy(&value, p, 4);
+                    return value;
+                }
+                return (int32_t)little(p, 4) / 2147483648.0f;
+        }
+    }
+
+public:
+    bool open(const string &path) {
+        file.open(path, ios::binary);
+        uint8_t header[12];
+        if (!file.read((char*)header, 12) || memcmp(header, "RIFF", 4) || memcmp(header + 8, "WAVE", 4)) return false;
+
+        /* the chunks we don't need (eg. LIST) are skipped, each is padded to an even length */
+        uint8_t chunk[8];
+        while (file.read((char*)chunk, 8)) {
+            uint32_t length = little(chunk + 4, 4);
+            if (!memcmp(chunk, "fmt ", 4)) {
+                vector<uint8_t> format(length);
+                if (length < 16 || !file.read((char*)format.data(), length)) return false;
+                unsigned int tag = little(&format[0], 2);
+                if (tag == 0xFFFE && length >= 26) tag = little(&format[24], 2); // extensible: the tag starts the sub-format GUID
+                channels = little(&format[2], 2);
+                rate = little(&format[4], 4);
+                bytesPerSample = little(&format[14], 2) / 8;
+                isFloat = tag == 3;
+                if ((tag != 1 && tag != 3) || (isFloat && bytesPerSample != 4) || bytesPerSample < 1 || bytesPerSample > 4) return false;
+                if (length & 1) file.seekg(1, ios::cur);
+            } else if (!memcmp(chunk, "data", 4)) {
+                if (!channels) return false; // the format has to come first
+                dataStart = file.tellg();
+                dataFrames = length / (channels * bytesPerSample);
+                return dataFrames > 0 && rate > 0;
+            } else {
+                file.seekg(length + (length & 1), ios::cur);
+            }
+        }
+        return false;
+    }
+
+    void read(float* out, size_t frames) {
+        /* the next frames frames, mixed down to mono */
+        size_t frameBytes = (size_t)channels * bytesPerSample;
+        while (frames) {
+            if (position == dataFrames) {
+                file.clear();
+                file.seekg(dataStart);
+                position = 0;
+            }
+            size_t count = (size_t)min<uint64_t>(frames, dataFrames - position);
+            raw.resize(count * frameBytes);
+            file.read((char*)raw.data(), raw.size());
+            size_t got = (size_t)file.gcount() / frameBytes;
+            if (got < count) {
+                /* cut short, so play it as if the data ended here */
+                fill(raw.begin() + got * frameBytes, raw.end(), bytesPerSample == 1 ? 128 : 0);
+                dataFrames = position + got;
+                if (got == 0) {
+                    fill(out, out + frames, 0.0f);
+                    return;
+                }
+                count = got;
+            }
+            for (size_t f = 0; f < count; f++) {
+                float sum = 0.0f;
+                for (unsigned int c = 0; c < channels; c++) sum += sample(&raw[f * frameBytes + c * bytesPerSample]);
+                out[f] = sum / channels;
+            }
+            out += count;
+            frames -= count;
+            position += count;
+        }
+    }
+
+    unsigned int sampleRate() const { return rate; }
+    double seconds() const { return rate ? (double)dataFrames / rate : 0.0; }
+};
+
+/* ---------------------------- Band analyzer ---------------------------- */
+/* The energy in each of a number of bands of a window of samples, in decibels against a full scale sine.
+The window is tapered with a Hann window before its FFT, and the bands are spaced evenly in pitch from 40 Hz up to 16 kHz
+(or just under the Nyquist frequency), each at least one bin wide, since a pulse per octave is what the ear hears as even. */
+class BandAnalyzer {
+    unsigned int size;
+    FFT fft;
+    vector<float> window, re, im, scratchRe, scratchIm;
+    vector<unsigned int> edges; // the first bin of each band, and one past the last band's
+
+public:
+    BandAnalyzer(unsigned int sizeIn, unsigned int numBands, unsigned int sampleRate, bool vectorize = true)
+        : size(sizeIn), fft(sizeIn, vectorize), window(sizeIn), re(sizeIn), im(sizeIn), scratchRe(sizeIn), scratchIm(sizeIn) {
+        for (unsigned int i = 0; i < size; i++) window[i] = 0.5f - 0.5f * (float)cos(2.0 * M_PI * i / size);
+
+        double lowest = 40.0, highest = min(16000.0, 0.45 * sampleRate);
+        unsigned int previous = 0;
+        for (unsigned int b = 0; b <= numBands; b++) {
+            double hz = lowest * pow(highest / lowest, (double)b / numBands);
+            unsigned int bin = max(previous + (b > 0), (unsigned int)(hz * size / sampleRate + 0.5));
+            edges.push_back(min(bin, size / 2));
+            previous = edges.back();
+        }
+    }
+
+    unsigned int numBands() const { return (unsigned int)edges.size() - 1; }
+    unsigned int firstBin(unsigned int band) const { return edges[band]; }
+    unsigned int fftSize() const { return size; }
+
+    void analyze(const float* samples, float* decibels) {
+        /* samples is fftSize() long, oldest first */
+        for (unsigned int i = 0; i < size; i++) re[i] = samples[i] * window[i];
+        fill(im.begin(), im.end(), 0.0f);
+        fft.forward(re.data(), im.data(), scratchRe.data(), scratchIm.data());
+
+        /* a full scale sine peaks at size / 4 after the window, and the window spreads it over bins adding up to 1.5 times that squared: 0 dB */
+        float reference = 16.0f / (1.5f * (float)size * size);
+        for (unsigned int b = 0; b < numBands(); b++) {
+            float energy = 0.0f;
+            for (unsigned int i = edges[b]; i < max(edges[b + 1], edges[b] + 1); i++) energy += re[i] * re[i] + im[i] * im[i];
+            decibels[b] = 10.0f * log10f(energy * reference + 1e-12f);
+        }
+    }
+};
+
+/* ---------------------------- Audio analysis ---------------------------- */
+/* How loud each band is, 0 to 1, for the curves to pulse with, and when the newest sample behind it is heard */
+struct AudioBands {
+    static const unsigned int maxBands = FramePacket::maxCurves;
+
+    unsigned int numBands = 0;
+    float levels[maxBands] = {};
+    uint64_t hop = 0;
+    Clock::time_point heard; // when the newest sample analysed plays
+    Clock::time_point published;
+};
+
+/* Streams a WAV file on a thread of its own, in time with the clock as though it were playing from when start() is called,
+and publishes the loudness of each band every hop (a quarter of the FFT size) through a TripleBuffer, so the render thread only ever
+takes the newest, without waiting on or being waited on by the analysis. Nothing is played, the file is the timeline for the visuals.
+
+Each band's level is its energy against the loudest it has been lately, which falls back slowly, so quiet and loud tracks both pulse,
+and it rises at once but falls away over a few hops, so beats read as pulses rather than flicker.
+The render thread reports when it shows each set of levels, for the latency from the newest sample to the swap. */
+class AudioAnalysis {
+    WavStream stream;
+    unique_ptr<BandAnalyzer> analyzer;
+    unsigned int hop = 0;
+    TripleBuffer<AudioBands> bands;
+
+    thread worker;
+    atomic<bool> running{false};
+
+    /* the render thread's side */
+    uint64_t shownHop = ~0ull;
+    StageTimer latencyTimer, handOffTimer;
+    double maxLatencyMs = 0.0;
+    unsigned int framesShown = 0, framesFresh = 0;
+
+    void run() {
+        unsigned int size = analyzer->fftSize(), numBands = analyzer->numBands();
+        vector<float> history(size, 0.0f), decibels(numBands), loudest(numBands, -60.0f), levels(numBands, 0.0f);
+        double hopSeconds = (double)hop / stream.sampleRate();
+
+        /* how much the loudest falls back each hop, and how much of the gap a level falls each hop */
+        const float fallback = 3.0f * (float)hopSeconds, release = 1.0f - (float)pow(0.02, hopSeconds * 4.0);
+        const float range = 24.0f; // decibels below the loudest that read as silent
+
+        Clock::time_point begin = Clock::now();
+        for (uint64_t h = 0; running.load(memory_order_relaxed); h++) {
+            /* a hop can be analysed once its last sample has played */
+            Clock::time_point due = begin + chrono::duration_cast<Clock::duration>(chrono::duration<double>((h + 1) * hopSeconds));
+            this_thread::sleep_until(due);
+
+            ScopedStage stage(analyzeTimer);
+            memmove(history.data(), history.data() + hop, (size - hop) * sizeof(float));
+            stream.read(history.data() + size - hop, hop);
+            analyzer->analyze(history.data(), decibels.data());
+
+            AudioBands &out = bands.back();
+            out.numBands = numBands;
+            for (unsigned int b = 0; b < numBands; b++) {
+                loudest[b] = max(decibels[b], max(loudest[b] - fallback, -60.0f));
+                float level = clamp(1.0f - (loudest[b] - decibels[b]) / range, 0.0f, 1.0f);
+                levels[b] = level > levels[b] ? level : levels[b] + release * (level - levels[b]);
+                out.levels[b] = levels[b];
+            }
+            out.hop = h;
+            out.heard = due;
+            out.published = Clock::now();
+            bands.publish();
+        }
+    }
+
+public:
+    StageTimer analyzeTimer; // written by the analysis thread
+
+    bool open(const string &path, unsigned int numBands, unsigned int fftSize) {
+        /* false if the file isn't a WAV file we can read */
+        if (!stream.open(path)) return false;
+        analyzer = make_unique<BandAnalyzer>(fftSize, min(numBands, AudioBands::maxBands), stream.sampleRate());
+        hop = fftSize / 4;
+        return true;
+    }
+
+    unsigned int sampleRate() const { return stream.sampleRate(); }
+    double seconds() const { return stream.seconds(); }
+
+    void start() {
+        running = true;
+        worker = thread(&AudioAnalysis::run, this);
+    }
+    void stop() {
+        running = false;
+        if (worker.joinable()) worker.join();
+    }
+
+    bool latest(AudioBands &levels) {
+        /* render thread only: replace levels with the newest published, if there are new ones */
+        return bands.latest(levels);
+    }
+
+    void shown(const AudioBands &levels, Clock::time_point when) {
+        /* render thread only: levels reached the screen at when, usually just after the swap */
+        framesShown ++;
+        if (levels.numBands == 0) return;
+        Clock::duration latency = when - levels.heard;
+        latencyTimer.add(latency);
+        maxLatencyMs = max(maxLatencyMs, msBetween(levels.heard, when));
+        if (levels.hop != shownHop) {
+            framesFresh ++;
+            handOffTimer.add(levels.published - levels.heard);
+            shownHop = levels.hop;
+        }
+    }
+
+    void report() {
+        /* render thread only */
+        double hopMs = 1000.0 * hop / stream.sampleRate(), windowMs = 500.0 * analyzer->fftSize() / stream.sampleRate();
+        cout << "  audio: " << analyzeTimer.count() << " hops of " << hopMs << " ms, analysis " << analyzeTimer.averageMs() << " ms each, new levels in "
+             << (framesShown ? 100.0 * framesFresh / framesShown : 0.0) << "% of frames" << endl;
+        cout << "  audio latency, newest sample to swap: " << latencyTimer.averageMs() << " ms average, " << maxLatencyMs << " max (analysis "
+             << handOffTimer.averageMs() << " ms), and the window's centre is " << windowMs << " ms before its newest sample" << endl;
+        analyzeTimer.reset(); latencyTimer.reset(); handOffTimer.reset();
+        maxLatencyMs = 0.0;
+        framesShown = framesFresh = 0;
+    }
+};
+
+/* Pulses the curves with the bands, the lowest band at the bottom curve: each curve's sine grows with its band, and reddens.
+It adds to the packet's colours, so goes on a copy made for the frame, never on a packet that may be drawn again */
+inline void pulseCurves(FramePacket &frame, const AudioBands &levels) {
+    if (levels.numBands == 0) return;
+    for (unsigned int i = 0; i < frame.numCurves; i++) {
+        float level = levels.levels[min(i * levels.numBands / frame.numCurves, levels.numBands - 1)];
+        frame.curves[i].amplitude = 1.0f + 1.5f * level;
+        frame.curves[i].colour = min(1.0f, frame.curves[i].colour + level);
+    }
+}
+
+#endif
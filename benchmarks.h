@@ -0,0 +1,769 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include "jobSystem.h"
+#include "sineCurve.h"
+#include "curveRenderers.h"
+#include "renderTarget.h"
+#include "simulation.h"
+#include "fft.h"
+#include "audio.h"
+#include "spectralWaves.h"
+#include "waveStrings.h"
+#include "boids.h"
+#include "life.h"
+#include "fluid.h"
+#include "slideLoader.h"
+#include "options.h"
+#include "starfieldScene.h"
+#include "metaballsScene.h"
+#include "fractal.h"
+#include "timing.h"
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* Microbenchmarks, run with --bench=<name> instead of opening a window */
+
+/* The thread counts to measure scaling over: powers of two up to, and including, every core */
+inline vector<unsigned int> benchThreadCounts() {
+    unsigned int cores = max(1u, thread::hardware_concurrency());
+    vector<unsigned int> counts;
+    for (unsigned int n = 1; n < cores; n *= 2) counts.push_back(n);
+    counts.push_back(cores);
+    return counts;
+}
+
+/* Times fn over repeats runs and returns the best, in ms, as the least disturbed by the rest of the system */
+template <typename F>
+double bestOf(int repeats, const F &fn) {
+    double best = 1e30;
+    for (int r = 0; r < repeats; r++) {
+        Clock::time_point start = Clock::now();
+        fn();
+        best = min(best, msBetween(start, Clock::now()));
+    }
+    return best;
+}
+
+void benchJobs() {
+    cout << "Job system (" << thread::hardware_concurrency() << " cores)" << endl;
+
+    /* the cost of spawning and joining a job that does nothing */
+    const int numJobs = 100000;
+    for (unsigned int threads: benchThreadCounts()) {
+        JobSystem jobs(threads);
+        double ms = bestOf(5, [&] {
+            JobSystem::Counter counter;
+            for (int i = 0; i < numJobs; i++) jobs.spawn(counter, [] {});
+            jobs.wait(counter);
+        });
+        cout << "  spawn+join, " << threads << " threads: " << ms * 1e6 / numJobs << " ns/job" << endl;
+    }
+
+    /* the same, but forked recursively by parallelFor with a grain of 1 */
+    for (unsigned int threads: benchThreadCounts()) {
+        JobSystem jobs(threads);
+        atomic<size_t> sum{0};
+        double ms = bestOf(5, [&] {
+            jobs.parallelFor(0, numJobs, 1, [&](size_t first, size_t last) { sum.fetch_add(last - first, memory_order_relaxed); });
+        });
+        cout << "  parallelFor fork/join, " << threads << " threads: " << ms * 1e6 / numJobs << " ns/job" << endl;
+    }
+
+    /* scaling of real work: generating a large sine mesh */
+    const unsigned int points = 2000000;
+    ScratchArena arena;
+    double single = 0.0;
+    for (unsigned int threads: benchThreadCounts()) {
+        JobSystem jobs(threads);
+        for (size_t grain: {1024, 4096, 16384}) {
+            double ms = bestOf(5, [&] {
+                ArenaScope scope(arena);
+                float* mesh = arena.alloc<float>(18 * (size_t)(points - 1));
+                jobs.parallelFor(0, points - 1, grain, [&](size_t first, size_t last) {
+                    for (size_t i = first; i < last; i++) writeSineRect(mesh + 18 * i, (int)i, points, SineShape());
+                });
+            });
+            if (threads == 1 && grain == 4096) single = ms;
+            cout << "  sine mesh " << points << " points, " << threads << " threads, grain " << grain << ": " << ms << " ms";
+            if (single > 0.0) cout << " (" << single / ms << "x)";
+            cout << endl;
+        }
+    }
+}
+
+void benchFFT() {
+    cout << "FFT (" << simdName() << ", " << thread::hardware_concurrency() << " cores)" << endl;
+    mt19937 random(1);
+    uniform_real_distribution<float> value(-1.0f, 1.0f);
+
+    /* accuracy: against a direct DFT in double, and a forward then inverse round trip */
+    {
+        const unsigned int n = 256;
+        FFT fft(n);
+        vector<float> re(n), im(n), scratchR(n), scratchI(n);
+        for (unsigned int i = 0; i < n; i++) { re[i] = value(random); im[i] = value(random); }
+        vector<float> inR = re, inI = im;
+        fft.forward(re.data(), im.data(), scratchR.data(), scratchI.data());
+
+        double maxError = 0.0, maxValue = 0.0;
+        for (unsigned int k = 0; k < n; k++) {
+            double sumR = 0.0, sumI = 0.0;
+            for (unsigned int j = 0; j < n; j++) {
+                double angle = -2.0 * M_PI * (double)((size_t)j * k % n) / n;
+                sumR += inR[j] * cos(angle) - inI[j] * sin(angle);
+                sumI += inR[j] * sin(angle) + inI[j] * cos(angle);
+            }
+            maxError = max(maxError, max(fabs(sumR - re[k]), fabs(sumI - im[k])));
+            maxValue = max(maxValue, max(fabs(sumR), fabs(sumI)));
+        }
+        cout << "  " << n << " points against a direct DFT: max error " << maxError / maxValue << " of the largest output" << endl;
+    }
+    {
+        const unsigned int n = 65536;
+        FFT fft(n);
+        vector<float> re(n), im(n), scratchR(n), scratchI(n);
+        for (unsigned int i = 0; i < n; i++) { re[i] = value(random); im[i] = value(random); }
+        vector<float> inR = re, inI = im;
+        fft.forward(re.data(), im.data(), scratchR.data(), scratchI.data());
+        fft.inverse(re.data(), im.data(), scratchR.data(), scratchI.data());
+
+        double maxError = 0.0;
+        for (unsigned int i = 0; i < n; i++) maxError = max(maxError, (double)max(fabs(re[i] / n - inR[i]), fabs(im[i] / n - inI[i])));
+        cout << "  " << n << " points forward then inverse: max error " << maxError << endl;
+    }
+
+    /* speed over sizes, against the same passes one butterfly at a time */
+    for (unsigned int n = 256; n <= 65536; n *= 2) {
+        FFT vectorFFT(n), scalarFFT(n, false);
+        vector<float> re(n), im(n), scratchR(n), scratchI(n);
+        for (unsigned int i = 0; i < n; i++) { re[i] = value(random); im[i] = value(random); }
+
+        /* enough transforms per timing to stay well above the clock's resolution */
+        int batch = max(1, (int)(1 << 22) / (int)n);
+        auto timeOf = [&](const FFT &fft) {
+            return bestOf(5, [&] {
+                for (int b = 0; b < batch; b++) fft.inverse(re.data(), im.data(), scratchR.data(), scratchI.data());
+            }) / batch;
+        };
+        double scalarMs = timeOf(scalarFFT), vectorMs = timeOf(vectorFFT);
+        cout << "  " << n << " points: " << vectorMs * 1000.0 << " us (" << vectorFFT.flops() / (vectorMs * 1e6) << " GFLOP/s), scalar "
+             << scalarMs * 1000.0 << " us (" << scalarMs / vectorMs << "x)" << endl;
+    }
+
+    /* the screensaver's use: synthesising one row of heights per curve each frame, scaling over threads */
+    const unsigned int numCurves = 9;
+    for (unsigned int n: {4096u, 65536u}) {
+        SpectralWaves waves(n, numCurves);
+        double single = 0.0;
+        for (unsigned int threads: benchThreadCounts()) {
+            JobSystem jobs(threads);
+            double ms = bestOf(20, [&] { waves.advance(&jobs); });
+            if (threads == 1) single = ms;
+            cout << "  spectral waves, " << numCurves << " curves of " << n << " points, " << threads << " threads: " << ms << " ms/frame ("
+                 << single / ms << "x)" << endl;
+        }
+    }
+}
+
+void benchStrings() {
+    cout << "Wave strings (" << simdName() << ", " << thread::hardware_concurrency() << " cores)" << endl;
+    const unsigned int numStrings = 1000, samples = 4096;
+    vector<float> heights((size_t)numStrings * samples); // stands in for the mapped vertex buffer
+
+    /* the solver one sample at a time and a float4 at a time, each sweeping every string per substep or blocked by string */
+    double baseline = 0.0;
+    for (bool vectorize: {false, true}) {
+        for (bool blocked: {false, true}) {
+            WaveStrings strings(numStrings, samples, vectorize);
+            double ms = bestOf(10, [&] { strings.advance(nullptr, heights.data(), blocked); });
+            if (baseline == 0.0) baseline = ms;
+            cout << "  " << numStrings << " x " << samples << ", 1 thread, " << (vectorize ? "float4" : "scalar") << ", " << (blocked ? "blocked by string" : "sweeping per substep")
+                 << ": " << ms << " ms/step (" << strings.updatesPerStep() / (ms * 1e6) << " G updates/s, " << baseline / ms << "x)" << endl;
+        }
+    }
+
+    /* scaling of the screensaver's configuration, against the 16.7 ms of a 60 Hz frame */
+    double single = 0.0;
+    for (unsigned int threads: benchThreadCounts()) {
+        JobSystem jobs(threads);
+        WaveStrings strings(numStrings, samples);
+        double ms = bestOf(10, [&] { strings.advance(&jobs, heights.data()); });
+        if (threads == 1) single = ms;
+        cout << "  " << threads << " threads: " << ms << " ms/frame (" << single / ms << "x), " << 100.0 * ms / (1000.0 / 60.0) << "% of a 60 Hz frame" << endl;
+    }
+}
+
+/* The best time in ms of fn over repeats runs, after one warm up run, including waiting for the GPU to finish.
+Wall time around glFinish is used rather than timer queries, as software rasterizers defer the work past the query. */
+template <typename F>
+double bestFinishedMsOf(int repeats, const F &fn) {
+    fn();
+    glFinish();
+    return bestOf(repeats, [&] {
+        fn();
+        glFinish();
+    });
+}
+
+void benchCurveRenderers() {
+    cout << "Curve renderers, best ms per frame until the GPU finishes" << endl;
+
+    ScratchArena arena;
+    MyVAO vao;
+    SineMesh mesh;
+    {
+        ArenaScope scope(arena);
+        mesh = genSineCurvePacked(100000, SineFormat::Float, arena);
+        uploadSineMesh(vao, mesh);
+    }
+    ShaderCache shaders;
+    MeshCurves meshCurves(shaders, vao, mesh.scale, chunkSineMesh(mesh));
+    AnalyticCurves analyticCurves(shaders);
+
+    struct Resolution { const char* name; int width, height; };
+    const Resolution resolutions[] = {{"720p", 1280, 720}, {"1080p", 1920, 1080}, {"1440p", 2560, 1440}, {"4K", 3840, 2160}};
+
+    glEnable(GL_DEPTH_TEST);
+    for (const Resolution &resolution: resolutions) {
+        RenderTarget target;
+        target.resize(resolution.width, resolution.height);
+        target.bind();
+        glViewport(0, 0, resolution.width, resolution.height);
+
+        for (unsigned int numCurves: {1u, 9u, 32u, 64u}) {
+            FramePacket frame = Simulation(numCurves).first();
+            auto clear = [] {
+                glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            };
+
+            double meshMs = bestFinishedMsOf(3, [&] { clear(); meshCurves.draw(frame); });
+            double analyticMs = bestFinishedMsOf(3, [&] { clear(); analyticCurves.draw(frame); });
+
+            cout << "  " << resolution.name << ", " << numCurves << " curves: mesh " << meshMs << " ms, analytic " << analyticMs
+                 << " ms -> " << (meshMs <= analyticMs ? "mesh" : "analytic") << endl;
+        }
+        target.del();
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    vao.del();
+    meshCurves.del();
+    analyticCurves.del();
+    shaders.del();
+}
+
+void benchBoids() {
+    cout << "Boids (" << simdName() << ", " << thread::hardware_concurrency() << " cores), best ms per frame" << endl;
+
+    for (unsigned int numBoids: {50000u, 200000u}) {
+        for (bool vectorize: {false, true}) {
+            /* let flocks form first, as they make the neighbour counts, and so the cost, far less even than at the start */
+            Flock flock(numBoids, 16.0f / 9.0f, 3.0f, vectorize);
+            {
+                JobSystem jobs;
+                for (int frame = 0; frame < 300; frame++) flock.advance(&jobs, 1.0f / 60.0f);
+            }
+
+            /* the scalar neighbour loop on one thread only, as the baseline */
+            for (unsigned int threads: vectorize ? benchThreadCounts() : vector<unsigned int>{1}) {
+                JobSystem jobs(threads);
+                double gridMs = bestOf(10, [&] { flock.rebuildGrid(&jobs); });
+                double updateMs = bestOf(10, [&] { flock.rebuildGrid(&jobs); flock.updateBoids(&jobs, 1.0f / 60.0f); }) - gridMs;
+                double checks = flock.checksPerBoid();
+                cout << "  " << numBoids << " boids in " << flock.cells() << " cells, " << (vectorize ? simdName() : "scalar") << ", " << threads
+                     << " threads: grid rebuild " << gridMs << " ms (" << gridMs * 1e6 / numBoids << " ns/boid), update " << updateMs << " ms ("
+                     << checks << " neighbours checked per boid, " << updateMs * 1e6 * threads / (checks * numBoids) << " ns/check per thread), "
+                     << 100.0 * (gridMs + updateMs) / (1000.0 / 60.0) << "% of a 60 Hz frame" << endl;
+            }
+        }
+    }
+}
+
+/* An RGBA8 test photo: smooth gradients under fine detail, so both the filtering and the edges show in the error */
+inline vector<uint8_t> syntheticPhoto(int width, int height) {
+    vector<uint8_t> photo((size_t)width * height * 4);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint32_t hash = (uint32_t)x * 0x9E3779B1u ^ (uint32_t)y * 0x85EBCA77u;
+            hash ^= hash >> 15;
+            uint8_t* pixel = &photo[((size_t)y * width + x) * 4];
+            pixel[0] = (uint8_t)(x * 255 / width);
+            pixel[1] = (uint8_t)(y * 255 / height);
+            pixel[2] = (uint8_t)(((x ^ y) & 0xF0) | (hash & 0x0F));
+            pixel[3] = 255;
+        }
+    }
+    return photo;
+}
+
+void benchResample() {
+    cout << "Resampler (" << simdName() << ", " << thread::hardware_concurrency() << " cores), best ms against the scalar reference" << endl;
+
+    struct Case { int sourceWidth, sourceHeight, destWidth, destHeight; };
+    const Case cases[] = {{8000, 6000, 1440, 1080}, {640, 480, 1440, 1080}};
+    for (const Case &c: cases) {
+        vector<uint8_t> source = syntheticPhoto(c.sourceWidth, c.sourceHeight);
+        vector<uint8_t> reference((size_t)c.destWidth * c.destHeight * 4), dest(reference.size());
+        double megapixels = (double)c.sourceWidth * c.sourceHeight / 1e6;
+
+        for (ResampleFilter filter: {ResampleFilter::Box, ResampleFilter::Lanczos}) {
+            cout << "  " << c.sourceWidth << " x " << c.sourceHeight << " to " << c.destWidth << " x " << c.destHeight << ", "
+                 << (filter == ResampleFilter::Box ? "box" : "lanczos") << endl;
+            double referenceMs = bestOf(1, [&] {
+                resampleReference(source.data(), c.sourceWidth, c.sourceHeight, reference.data(), c.destWidth, c.destHeight, filter);
+            });
+            cout << "    scalar reference: " << referenceMs << " ms (" << megapixels / referenceMs * 1e3 << " MP/s)" << endl;
+
+            /* whole rows at a time, then in tiles, then in tiles over more threads */
+            Resampler rows(c.sourceWidth, c.sourceHeight, c.destWidth, c.destHeight, filter, 0);
+            double rowsMs = bestOf(3, [&] { rows.resample(source.data(), dest.data()); });
+            cout << "    " << simdName() << " whole rows: " << rowsMs << " ms (" << referenceMs / rowsMs << "x)" << endl;
+
+            Resampler tiled(c.sourceWidth, c.sourceHeight, c.destWidth, c.destHeight, filter);
+            for (unsigned int threads: benchThreadCounts()) {
+                JobSystem jobs(threads);
+                double ms = bestOf(3, [&] { tiled.resample(source.data(), dest.data(), &jobs); });
+                cout << "    " << simdName() << " " << tiled.tileCount() << " tiles, " << threads << " threads: " << ms << " ms ("
+                     << referenceMs / ms << "x, " << megapixels / ms * 1e3 << " MP/s)" << endl;
+            }
+
+            /* quality: the float pipeline should only differ from the reference by rounding */
+            int maxError = 0;
+            size_t differing = 0;
+            double squaredError = 0.0;
+            for (size_t i = 0; i < dest.size(); i++) {
+                int error = abs((int)dest[i] - (int)reference[i]);
+                maxError = max(maxError, error);
+                differing += error != 0;
+                squaredError += (double)error * error;
+            }
+            double psnr = squaredError > 0.0 ? 10.0 * log10(255.0 * 255.0 / (squaredError / dest.size())) : INFINITY;
+            cout << "    against the reference: max error " << maxError << ", " << 100.0 * differing / dest.size() << "% of values differ, PSNR "
+                 << psnr << " dB" << endl;
+        }
+    }
+}
+
+/* The slideshow's pipeline, a stage at a time: decoding and shrinking the images in directory (if one is given),
+shrinking a synthetic 48 megapixel photo, and uploading a 1080p slide through a pixel buffer */
+void benchSlides(const string &directory) {
+    const int width = 1920, height = 1080;
+    cout << "Slideshow pipeline, " << simdName() << ", slides fitted to " << width << " x " << height << endl;
+
+    vector<string> paths = directory.empty() ? vector<string>() : SlideLoader::list(directory);
+    if (!paths.empty()) {
+        double decodeMs = 0.0, resampleMs = 0.0;
+        size_t pixels = 0, loaded = 0;
+        for (const string &path: paths) {
+            Slide slide = SlideLoader::load(path, width, height);
+            if (!slide.ok()) continue;
+            loaded ++;
+            decodeMs += slide.decodeMs;
+            resampleMs += slide.resampleMs;
+            pixels += slide.sourcePixels;
+        }
+        cout << "  " << loaded << " images, " << pixels / 1e6 << " MP: decode " << pixels / (decodeMs * 1e3) << " MP/s, resample "
+             << pixels / (resampleMs * 1e3) << " MP/s" << endl;
+    } else {
+        cout << "  (pass --slides=<dir> to time decoding real images too)" << endl;
+    }
+
+    /* a synthetic photo, big enough that a slide hitching on it would show */
+    const int sourceWidth = 8000, sourceHeight = 6000;
+    vector<uint8_t> source((size_t)sourceWidth * sourceHeight * 4);
+    for (int y = 0; y < sourceHeight; y++) {
+        for (int x = 0; x < sourceWidth; x++) {
+            uint8_t* pixel = &source[((size_t)y * sourceWidth + x) * 4];
+            pixel[0] = (uint8_t)x; pixel[1] = (uint8_t)y; pixel[2] = (uint8_t)(x ^ y); pixel[3] = 255;
+        }
+    }
+    int fitWidth, fitHeight;
+    fitInside(sourceWidth, sourceHeight, width, height, fitWidth, fitHeight);
+    vector<uint8_t> slide((size_t)fitWidth * fitHeight * 4);
+    Resampler resampler(sourceWidth, sourceHeight, fitWidth, fitHeight);
+    double resampleMs = bestOf(3, [&] { resampler.resample(source.data(), slide.data()); });
+    cout << "  resample " << sourceWidth << " x " << sourceHeight << " to " << fitWidth << " x " << fitHeight << ": " << resampleMs << " ms ("
+         << (double)sourceWidth * sourceHeight / (resampleMs * 1e3) << " MP/s)" << endl;
+
+    /* uploading it straight from memory, against copying it into an orphaned pixel buffer and filling the texture from that */
+    unsigned int texture, pixelBuffer;
+    glGenTextures(1, &texture);
+    glGenBuffers(1, &pixelBuffer);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    double bytes = (double)slide.size();
+
+    double directMs = bestFinishedMsOf(5, [&] {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, fitWidth, fitHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, slide.data());
+    });
+    double copyMs = 0.0;
+    double bufferMs = bestFinishedMsOf(5, [&] {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, slide.size(), nullptr, GL_STREAM_DRAW);
+        Clock::time_point start = Clock::now();
+        void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, slide.size(), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped) memcpy(mapped, slide.data(), slide.size());
+        bool ok = mapped && glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        copyMs = msBetween(start, Clock::now());
+        if (ok) glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, fitWidth, fitHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    });
+    cout << "  upload " << bytes / 1e6 << " MB: direct " << directMs << " ms (" << bytes / (directMs * 1e6) << " GB/s), pixel buffer " << bufferMs
+         << " ms of which copying " << copyMs << " ms, so " << ceil(bytes / (4 << 20)) << " frames of the slideshow's 4 MB steps" << endl;
+
+    glDeleteBuffers(1, &pixelBuffer);
+    glDeleteTextures(1, &texture);
+}
+
+/* Life in cell updates per second on an 8192 x 8192 torus, a word at a time against a bits128 at a time, over each thread count,
+after checking both against a plain byte per cell Life on a grid whose rows aren't a whole number of bits128s */
+void benchLife() {
+    cout << "Life (" << simdName() << ", " << thread::hardware_concurrency() << " cores)" << endl;
+
+    const int checkWidth = 320, checkHeight = 200, checkGenerations = 100;
+    bool matches = true;
+    for (bool vectorize: {false, true}) {
+        LifeGrid grid(checkWidth, checkHeight);
+        grid.randomize(0, 0, checkWidth, checkHeight, 7);
+        vector<uint8_t> cells(checkWidth * checkHeight), next(cells.size());
+        for (int y = 0; y < checkHeight; y++) for (int x = 0; x < checkWidth; x++) cells[y * checkWidth + x] = grid.alive(x, y);
+
+        for (int g = 0; g < checkGenerations; g++) {
+            grid.step(nullptr, vectorize);
+            for (int y = 0; y < checkHeight; y++) {
+                for (int x = 0; x < checkWidth; x++) {
+                    int neighbours = 0;
+                    for (int dy = -1; dy <= 1; dy++) {
+                        for (int dx = -1; dx <= 1; dx++) {
+                            if (dx || dy) neighbours += cells[((y + dy + checkHeight) % checkHeight) * checkWidth + (x + dx + checkWidth) % checkWidth];
+                        }
+                    }
+                    next[y * checkWidth + x] = neighbours == 3 || (neighbours == 2 && cells[y * checkWidth + x]);
+                }
+            }
+            swap(cells, next);
+        }
+        for (int y = 0; y < checkHeight; y++) for (int x = 0; x < checkWidth; x++) matches &= grid.alive(x, y) == (bool)cells[y * checkWidth + x];
+    }
+    cout << "  " << checkGenerations << " generations of " << checkWidth << "x" << checkHeight << (matches ? " match" : " DON'T match")
+         << " a byte per cell" << endl;
+
+    const int size = 8192;
+    double cells = (double)size * size;
+    LifeGrid grid(size, size);
+    grid.randomize(0, 0, size, size, 1);
+    for (unsigned int threads: benchThreadCounts()) {
+        JobSystem jobs(threads);
+        double ms[2];
+        for (bool vectorize: {false, true}) ms[vectorize] = bestOf(5, [&] { grid.step(&jobs, vectorize); });
+        cout << "  " << size << "x" << size << ", " << threads << " threads: word " << ms[0] << " ms (" << cells / (ms[0] * 1e6) << " G cell updates/s), "
+             << simdName() << " " << ms[1] << " ms (" << cells / (ms[1] * 1e6) << " G cell updates/s, " << ms[0] / ms[1] << "x)" << endl;
+    }
+}
+
+/* The audio-reactive mode's pieces: which band a tone lands in and what an analysis costs at each FFT size, the latency the hop and window add,
+and the triple buffer handing the newest of a stream of values from one thread to another, checked for torn values */
+void benchAudio() {
+    cout << "Audio analysis (" << simdName() << ", " << thread::hardware_concurrency() << " cores)" << endl;
+    const unsigned int sampleRate = 48000, numBands = 9;
+    for (unsigned int n: {1024u, 2048u, 4096u}) {
+        BandAnalyzer analyzer(n, numBands, sampleRate);
+        vector<float> samples(n), decibels(numBands);
+        unsigned int loudestBand = 0, expectedBand = 0;
+        for (unsigned int b = 0; b < numBands; b++) if (analyzer.firstBin(b) <= 440.0 * n / sampleRate) expectedBand = b;
+        for (unsigned int i = 0; i < n; i++) samples[i] = 0.5f * (float)sin(2.0 * M_PI * 440.0 * i / sampleRate);
+        analyzer.analyze(samples.data(), decibels.data());
+        for (unsigned int b = 0; b < numBands; b++) if (decibels[b] > decibels[loudestBand]) loudestBand = b;
+
+        double ms = bestOf(20, [&] { analyzer.analyze(samples.data(), decibels.data()); });
+        cout << "  " << n << " points: " << ms * 1000.0 << " us a hop, a half scale 440 Hz tone reads " << decibels[loudestBand] << " dB in band "
+             << loudestBand << (loudestBand == expectedBand ? "" : " (WRONG BAND)") << ", hop " << 250.0 * n / sampleRate << " ms, window centre "
+             << 500.0 * n / sampleRate << " ms behind its newest sample" << endl;
+    }
+
+    /* every field of a value is its sequence number, so a value that mixes two publishes shows */
+    struct Value { uint64_t fields[32]; Clock::time_point published; };
+    TripleBuffer<Value> buffer;
+    atomic<bool> writing{true};
+    uint64_t published = 0;
+    thread writer([&] {
+        for (uint64_t sequence = 1; writing.load(memory_order_relaxed); sequence++) {
+            Value &value = buffer.back();
+            fill(value.fields, value.fields + 32, sequence);
+            value.published = Clock::now();
+            buffer.publish();
+            published = sequence;
+            if (sequence % 64 == 0) this_thread::yield(); // so a single core still gets to the reader
+        }
+    });
+    uint64_t reads = 0, torn = 0, last = 0, backwards = 0;
+    StageTimer age;
+    Value value;
+    Clock::time_point end = Clock::now() + chrono::milliseconds(300);
+    while (Clock::now() < end) {
+        if (!buffer.latest(value)) {
+            this_thread::yield();
+            continue;
+        }
+        reads ++;
+        age.add(Clock::now() - value.published);
+        for (uint64_t field: value.fields) torn += field != value.fields[0];
+        backwards += value.fields[0] <= last;
+        last = value.fields[0];
+    }
+    writing = false;
+    writer.join();
+    cout << "  triple buffer over 300 ms: " << published << " published, " << reads << " taken, " << age.averageMs() * 1000.0
+         << " us old on average, " << torn << " torn, " << backwards << " out of order" << endl;
+}
+
+/* The fluid's step on a 512 x 288 grid with four emitters, a cell at a time against float4s over each thread count, where the time goes
+kernel by kernel, and how close to divergence free the pressure iterations get it */
+void benchFluid() {
+    cout << "Fluid (" << simdName() << ", " << thread::hardware_concurrency() << " cores)" << endl;
+    const int width = 512, height = 288, warmSteps = 60;
+    const float dt = 1.0f / 60.0f;
+    vector<FluidSolver::Emitter> emitters;
+    for (int i = 0; i < 4; i++) {
+        float angle = 1.5707963f * i;
+        emitters.push_back({width * (0.5f + 0.3f * cos(angle)), height * (0.5f + 0.3f * sin(angle)), -200.0f * sin(angle), 200.0f * cos(angle), 7.0f, i % 2});
+    }
+
+    for (unsigned int threads: benchThreadCounts()) {
+        JobSystem jobs(threads);
+        double ms[2];
+        for (bool vectorize: {false, true}) {
+            FluidSolver solver(width, height, 0.5f);
+            for (int i = 0; i < warmSteps; i++) solver.step(&jobs, dt, emitters, vectorize);
+            ms[vectorize] = bestOf(5, [&] { solver.step(&jobs, dt, emitters, vectorize); });
+        }
+        cout << "  " << width << "x" << height << ", 40 iterations, " << threads << " threads: scalar " << ms[0] << " ms, " << simdName() << " "
+             << ms[1] << " ms (" << ms[0] / ms[1] << "x)" << endl;
+    }
+
+    JobSystem jobs;
+    FluidSolver solver(width, height, 0.5f);
+    for (int i = 0; i < warmSteps; i++) solver.step(&jobs, dt, emitters);
+    FluidSolver::KernelTimers &kernels = solver.kernelTimers();
+    kernels.reset();
+    for (int i = 0; i < warmSteps; i++) solver.step(&jobs, dt, emitters);
+    cout << "  per step, " << jobs.threads() << " threads: forces " << kernels.forces.averageMs() << " ms, advect " << kernels.advect.averageMs()
+         << " ms, diffuse " << kernels.diffuse.averageMs() << " ms, divergence " << kernels.divergence.averageMs() << " ms, pressure "
+         << kernels.pressure.averageMs() << " ms, gradient " << kernels.gradient.averageMs() << " ms" << endl;
+
+    /* each from the same start, so only the iterations differ */
+    for (unsigned int iterations: {10u, 20u, 40u, 80u}) {
+        FluidSolver solver(width, height, 0.5f);
+        solver.setIterations(iterations);
+        for (int i = 0; i < warmSteps; i++) solver.step(&jobs, dt, emitters);
+        double ms = bestOf(5, [&] { solver.step(&jobs, dt, emitters); });
+        cout << "  " << iterations << " pressure iterations: " << ms << " ms, divergence left " << solver.maxDivergence() << "/s" << endl;
+    }
+}
+
+/* The starfield's two paths at 1080p: stars stepped on the CPU and streamed, against worked out from their seeds in the vertex shader */
+void benchStarfield() {
+    cout << "Starfield (" << simdName() << ", " << thread::hardware_concurrency() << " cores), best ms per frame until the GPU finishes" << endl;
+    const int width = 1920, height = 1080;
+    RenderTarget target;
+    target.resize(width, height);
+    target.bind();
+    glViewport(0, 0, width, height);
+
+    JobSystem jobs;
+    ShaderCache shaders;
+    for (unsigned int numStars: {1000000u, 4000000u}) {
+        /* the CPU's share on its own, without a buffer to write to */
+        Starfield field(numStars);
+        double stepMs = bestOf(10, [&] { field.advance(&jobs); });
+
+        /* and each path as the scene runs it, made from a command line of its own */
+        double frameMs[2];
+        for (bool analytic: {false, true}) {
+            vector<string> args = {"bench", "--stars=" + to_string(numStars), string("--star-motion=") + (analytic ? "gpu" : "cpu")};
+            vector<char*> argv;
+            for (string &arg: args) argv.push_back(arg.data());
+            SceneContext context{jobs, shaders, (int)argv.size(), argv.data()};
+
+            StarfieldScene scene(context);
+            frameMs[analytic] = bestFinishedMsOf(3, [&] {
+                scene.update(0.0, 1.0f / 60.0f);
+                scene.draw(width, height);
+            });
+            scene.del();
+        }
+        cout << "  " << numStars << " stars: CPU step " << stepMs << " ms (" << numStars / (stepMs * 1e3) << " M stars/s, " << jobs.threads()
+             << " threads), frame moving them on the CPU " << frameMs[0] << " ms, on the GPU " << frameMs[1] << " ms -> "
+             << (frameMs[0] < frameMs[1] ? "cpu" : "gpu") << endl;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    target.del();
+    shaders.del();
+}
+
+/* The metaballs at 1080p: the field a sample at a time against four, and the contour, for grids of a few resolutions,
+then a frame of each path as the scene runs it, the grid on the CPU against the field per pixel in a fragment shader */
+void benchMetaballs() {
+    cout << "Metaballs (" << simdName() << ", " << thread::hardware_concurrency() << " cores), 24 balls, best ms" << endl;
+    const int width = 1920, height = 1080;
+    JobSystem jobs;
+    Metaballs balls(24, (float)width / height, height);
+    balls.move(10.0);
+    vector<float> vertices;
+    for (unsigned int rows: {135u, 270u, 540u, 1080u}) {
+        balls.setRows(rows);
+        double scalarMs = bestOf(3, [&] { balls.evaluate(&jobs, false); });
+        double simdMs = bestOf(3, [&] { balls.evaluate(&jobs); });
+        unsigned int count = balls.classify(&jobs);
+        vertices.resize(2 * (size_t)max(count, 1u));
+        double contourMs = bestOf(3, [&] { balls.classify(&jobs); balls.write(&jobs, vertices.data()); });
+        cout << "  " << balls.gridColumns() << "x" << rows << " grid: field scalar " << scalarMs << " ms, " << simdName() << " " << simdMs << " ms ("
+             << scalarMs / simdMs << "x), contour " << contourMs << " ms, " << count / 3 << " triangles (" << jobs.threads() << " threads)" << endl;
+    }
+
+    RenderTarget target;
+    target.resize(width, height);
+    target.bind();
+    glViewport(0, 0, width, height);
+    ShaderCache shaders;
+    double frameMs[2];
+    for (bool onGpu: {false, true}) {
+        vector<string> args = {"bench", string("--metaballs=") + (onGpu ? "gpu" : "cpu"), "--metaball-budget=0"};
+        vector<char*> argv;
+        for (string &arg: args) argv.push_back(arg.data());
+        SceneContext context{jobs, shaders, (int)argv.size(), argv.data()};
+
+        MetaballsScene scene(context);
+        double time = 0.0;
+        frameMs[onGpu] = bestFinishedMsOf(3, [&] {
+            scene.update(time += 1.0 / 60.0, 1.0f / 60.0f); // the balls move with the time, so each frame is a new contour
+            scene.draw(width, height);
+        });
+        scene.del();
+    }
+    cout << "  frame until the GPU finishes: CPU 540 row grid " << frameMs[0] << " ms, GPU per pixel " << frameMs[1] << " ms -> "
+         << (frameMs[0] < frameMs[1] ? "cpu" : "gpu") << endl;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    target.del();
+    shaders.del();
+}
+
+/* The fractal in pixels per second, the same view of the Mandelbrot set 100x in both ways:
+on the CPU a pixel at a time against four in two double2s, over each thread count, with how soon the first pass of a zoom step is ready,
+then in the fragment shader at 1080p. Then the CPU path a trillion times in, far past where the shader's floats give out */
+void benchFractal() {
+    cout << "Fractal (" << simdName() << ", " << thread::hardware_concurrency() << " cores), seahorse valley at 100x, best of 3" << endl;
+    FractalView view;
+    view.centreX = -0.743643887037158704752;
+    view.centreY = 0.131825904205311970493;
+    view.scale = 0.015;
+    view.maxIterations = 150 + (unsigned int)(60.0 * log2(100.0));
+
+    const int cpuWidth = 1280, cpuHeight = 720;
+    double pixels = (double)cpuWidth * cpuHeight;
+    FractalImage image;
+    for (unsigned int threads: benchThreadCounts()) {
+        JobSystem jobs(threads);
+        double ms[2], firstPassMs = 0.0;
+        for (bool vectorize: {false, true}) {
+            ms[vectorize] = bestOf(3, [&] {
+                image.begin(view, cpuWidth, cpuHeight);
+                image.render(&jobs, vectorize);
+            });
+        }
+        firstPassMs = bestOf(3, [&] {
+            image.begin(view, cpuWidth, cpuHeight);
+            while (image.passStride() == 8) image.refine(&jobs, 0.0);
+        });
+        cout << "  CPU " << cpuWidth << "x" << cpuHeight << ", " << threads << " threads: scalar " << ms[0] << " ms (" << pixels / (ms[0] * 1e3)
+             << " MP/s), " << simdName() << " " << ms[1] << " ms (" << pixels / (ms[1] * 1e3) << " MP/s, " << ms[0] / ms[1]
+             << "x), first pass " << firstPassMs << " ms" << endl;
+    }
+    {
+        /* how often neighbouring pixels differ in the deep view, a blocky image from running out of precision would have few */
+        FractalView deep = view;
+        deep.scale = 1.5e-12;
+        deep.maxIterations = 150 + (unsigned int)(60.0 * log2(1e12));
+        JobSystem jobs;
+        double deepMs = bestOf(1, [&] {
+            image.begin(deep, cpuWidth, cpuHeight);
+            image.render(&jobs);
+        });
+        size_t changes = 0;
+        const uint32_t* row = (const uint32_t*)image.data();
+        for (size_t i = 1; i < (size_t)cpuWidth * cpuHeight; i++) changes += row[i] != row[i - 1];
+        cout << "  CPU at 1e12x, " << deep.maxIterations << " iterations: " << deepMs << " ms, colour changes between neighbours in "
+             << 100.0 * changes / pixels << "% of pixels" << endl;
+    }
+
+    const int width = 1920, height = 1080;
+    RenderTarget target;
+    target.resize(width, height);
+    target.bind();
+    glViewport(0, 0, width, height);
+    ShaderCache shaders;
+    Shader &shader = shaders.get("shaders/fullscreenVertexShader.txt", "shaders/fractalFragmentShader.txt");
+    unsigned int emptyVAO;
+    glGenVertexArrays(1, &emptyVAO);
+    shader.use();
+    shader.setVec2("uvScale", glm::vec2(1.0f));
+    shader.setVec2("centre", glm::vec2((float)view.centreX, (float)view.centreY));
+    shader.setFloat("scale", (float)view.scale);
+    shader.setFloat("aspect", (float)width / height);
+    shader.setInt("maxIterations", (int)view.maxIterations);
+    glDisable(GL_DEPTH_TEST);
+    double gpuMs = bestFinishedMsOf(3, [&] {
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+    });
+    glEnable(GL_DEPTH_TEST);
+    cout << "  GPU " << width << "x" << height << ": " << gpuMs << " ms (" << (double)width * height / (gpuMs * 1e3) << " MP/s)" << endl;
+
+    glDeleteVertexArrays(1, &emptyVAO);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    target.del();
+    shaders.del();
+}
+
+/* Whether a benchmark needs an OpenGL context, ie. a window, to run */
+inline bool benchNeedsContext(const string &name) {
+    return name == "all" || name == "curves" || name == "slides" || name == "starfield" || name == "metaballs" || name == "fractal";
+}
+
+/* Runs the named benchmark, or all of them for "all". Returns the process exit code.
+Benchmarks that need a context are only run if there is one current. Some take their own options from the command line */
+int runBenchmarks(const string &name, bool haveContext, int argc, char* argv[]) {
+    bool all = name == "all";
+    bool ran = false;
+
+    if (all || name == "jobs") { benchJobs(); ran = true; }
+    if (all || name == "fft") { benchFFT(); ran = true; }
+    if (all || name == "audio") { benchAudio(); ran = true; }
+    if (all || name == "strings") { benchStrings(); ran = true; }
+    if (all || name == "resample") { benchResample(); ran = true; }
+    if (all || name == "boids") { benchBoids(); ran = true; }
+    if (all || name == "life") { benchLife(); ran = true; }
+    if (all || name == "fluid") { benchFluid(); ran = true; }
+    if (haveContext && (all || name == "curves")) { benchCurveRenderers(); ran = true; }
+    if (haveContext && (all || name == "starfield")) { benchStarfield(); ran = true; }
+    if (haveContext && (all || name == "metaballs")) { benchMetaballs(); ran = true; }
+    if (haveContext && (all || name == "fractal")) { benchFractal(); ran = true; }
+    if (haveContext && (all || name == "slides")) { benchSlides(getOption(argc, argv, "slides", "")); ran = true; }
+
+    if (!ran) {
+        cout << "Unknown benchmark " << name << endl;
+        return 1;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,266 @@
+#ifndef BOIDS_H
+#define BOIDS_H
+
+#include "jobSystem.h"
+#include "simd.h"
+#include "timing.h"
+#include <algorithm>
+#include <cstdint>
+#include <math.h>
+#include <vector>
+
+using namespace std;
+
+/* A flock of boids: each steers to match its neighbours' heading (alignment), towards their centre (cohesion) and away from any too close (separation).
+The world is a torus as wide as the screen's aspect and 1 high, so the flock wraps around the edges.
+
+Neighbours are found with a uniform grid of cells as wide as the neighbour radius, so only the 3 x 3 cells around a boid need checking.
+The grid is rebuilt every frame with a counting sort: count the boids per cell, prefix sum the counts into where each cell starts,
+then scatter the boids into that order. The boids themselves are moved, not indices to them, so a cell's boids sit next to each other
+and the neighbour loop reads memory in order. Updating writes the next state back into the other buffer in the same sorted order,
+so next frame's sort finds the boids nearly where they belong. Every buffer is sized once up front, so a frame allocates nothing. */
+class Flock {
+public:
+    /* structure of arrays, x, y, vx and vy for every boid one after another in a single block, so the block uploads as is (bytes() of it) */
+    struct State {
+        vector<float> data;
+        float* x;
+        float* y;
+        float* vx;
+        float* vy;
+
+        void resize(unsigned int n) {
+            data.assign((size_t)n * 4 + 4, 0.0f); // with room to read a float4 past the last boid
+            x = data.data(); y = x + n; vx = y + n; vy = vx + n;
+        }
+    };
+
+private:
+    unsigned int numBoids;
+    bool vectorize;
+    State current, sorted; // current is in last frame's cell order, sorted in this frame's
+
+    /* the grid */
+    unsigned int gridWidth, gridHeight;
+    float cellSize, invCellSize, worldWidth, worldHeight;
+    vector<uint32_t> cellOf; // of each boid in current
+    vector<uint32_t> cellStart; // where each cell's boids start in sorted, one past the end for the last
+    vector<uint32_t> cursor; // scratch for the scatter
+
+    /* neighbour checks made in the last update, for the report */
+    vector<uint64_t> checks; // per band of grain boids, so threads don't share a counter
+    static const unsigned int grain = 2048;
+
+    /* behaviour, with lengths in neighbour radii and times in seconds */
+    static constexpr float separationRadius = 0.4f;
+    static constexpr float alignment = 1.5f, cohesion = 1.2f, separationWeight = 3.0f;
+    static constexpr float minSpeed = 4.0f, maxSpeed = 10.0f; // radii per second
+    static constexpr float maxNeighbours = 24.0f; // skip the rows above and below once a boid's own row has this many, to bound the cost inside tight flocks
+
+    uint32_t cellAt(float x, float y) const {
+        unsigned int cx = min((unsigned int)(x * invCellSize), gridWidth - 1);
+        unsigned int cy = min((unsigned int)(y * invCellSize), gridHeight - 1);
+        return cy * gridWidth + cx;
+    }
+
+    /* what a boid has seen of its neighbours so far */
+    struct Neighbourhood {
+        float sumVx = 0.0f, sumVy = 0.0f, sumDx = 0.0f, sumDy = 0.0f, awayX = 0.0f, awayY = 0.0f, found = 0.0f;
+    };
+
+    void gather(Neighbourhood &n, unsigned int begin, unsigned int end, float x, float y, unsigned int self) const {
+        /* adds in sorted boids [begin, end), seen from (x, y), which has been moved across any wrap so they lie next to it.
+        About a third of them are in range, too unpredictable to branch on, so each is summed in with a weight of 1 or 0 instead */
+        const float radius2 = cellSize * cellSize, separation = cellSize * separationRadius, separation2 = separation * separation;
+        if (vectorize) {
+            /* four at a time. Lanes past the end read the next boids (or the padding) and are weighted 0.
+            The separation push (separation - d) / (d separation) is 1/d - 1/separation, so it's an rsqrt clamped at 0 */
+            static const float lanes[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+            const float4 x4 = splat4(x), y4 = splat4(y), radius4 = splat4(radius2), invSeparation = splat4(1.0f / separation);
+            const float4 zero = splat4(0.0f), tiny = splat4(1e-12f), lane = load4(lanes);
+            float4 sumVx = zero, sumVy = zero, sumDx = zero, sumDy = zero, awayX = zero, awayY = zero, found = zero;
+            for (unsigned int j = begin; j < end; j += 4) {
+                float4 valid = less4(lane, splat4((float)(end - j)));
+                float4 dx = load4(sorted.x + j) - x4, dy = load4(sorted.y + j) - y4;
+                float4 d2 = dx * dx + dy * dy;
+                float4 near = less4(d2, radius4) * valid;
+                sumVx = sumVx + near * load4(sorted.vx + j); sumVy = sumVy + near * load4(sorted.vy + j);
+                sumDx = sumDx + near * dx; sumDy = sumDy + near * dy;
+                found = found + near;
+                float4 push = max4(rsqrt4(d2 + tiny) - invSeparation, zero) * valid;
+                awayX = awayX - dx * push; awayY = awayY - dy * push;
+            }
+            n.sumVx += sum4(sumVx); n.sumVy += sum4(sumVy); n.sumDx += sum4(sumDx); n.sumDy += sum4(sumDy);
+            n.awayX += sum4(awayX); n.awayY += sum4(awayY); n.found += sum4(found);
+
+            /* the boid itself was counted as a neighbour, but as it is 0 away it only added to the velocities and the count */
+            if (self >= begin && self < end) {
+                n.sumVx -= sorted.vx[self]; n.sumVy -= sorted.vy[self];
+                n.found -= 1.0f;
+            }
+            return;
+        }
+
+        for (unsigned int j = begin; j < end; j++) {
+            float dx = sorted.x[j] - x, dy = sorted.y[j] - y;
+            float d2 = dx * dx + dy * dy;
+            float near = d2 < radius2 && j != self ? 1.0f : 0.0f;
+            n.sumVx += near * sorted.vx[j]; n.sumVy += near * sorted.vy[j];
+            n.sumDx += near * dx; n.sumDy += near * dy;
+            n.found += near;
+
+            if (d2 < separation2 && j != self) {
+                /* pushed away harder the closer it is, from nothing at the separation radius. Rare enough to branch on */
+                float d = sqrt(d2) + 1e-9f;
+                float push = (separation - d) / (d * separation);
+                n.awayX -= dx * push; n.awayY -= dy * push;
+            }
+        }
+    }
+
+    uint64_t updateRange(unsigned int first, unsigned int last, float dt) {
+        /* steers and moves sorted boids [first, last) into current, returning the neighbour checks made */
+        const float speedMin = minSpeed * cellSize, speedMax = maxSpeed * cellSize;
+        uint64_t checked = 0;
+
+        for (unsigned int i = first; i < last; i++) {
+            float x = sorted.x[i], y = sorted.y[i], vx = sorted.vx[i], vy = sorted.vy[i];
+            int cx = (int)min((unsigned int)(x * invCellSize), gridWidth - 1), cy = (int)min((unsigned int)(y * invCellSize), gridHeight - 1);
+
+            /* its own row first, then the rows either side both or neither, so a full neighbourhood never leans one way */
+            static const int rowOrder[3] = {0, -1, 1};
+            Neighbourhood n;
+            for (int r = 0; r < 3; r++) {
+                if (r == 1 && n.found >= maxNeighbours) break;
+                /* rows past the edges wrap, seen from a boid moved the other way so they lie next to it */
+                int ny = cy + rowOrder[r];
+                float seenY = y;
+                if (ny < 0) { ny += gridHeight; seenY += worldHeight; }
+                else if (ny >= (int)gridHeight) { ny -= gridHeight; seenY -= worldHeight; }
+                unsigned int row = ny * gridWidth;
+
+                if (cx > 0 && cx + 1 < (int)gridWidth) {
+                    /* the three cells are next to each other in sorted order, so they are one run */
+                    unsigned int begin = cellStart[row + cx - 1], end = cellStart[row + cx + 2];
+                    checked += end - begin;
+                    gather(n, begin, end, x, seenY, i);
+                    continue;
+                }
+                for (int ox = -1; ox <= 1; ox++) {
+                    int nx = cx + ox;
+                    float seenX = x;
+                    if (nx < 0) { nx += gridWidth; seenX += worldWidth; }
+                    else if (nx >= (int)gridWidth) { nx -= gridWidth; seenX -= worldWidth; }
+                    unsigned int begin = cellStart[row + nx], end = cellStart[row + nx + 1];
+                    checked += end - begin;
+                    gather(n, begin, end, seenX, seenY, i);
+                }
+            }
+
+            if (n.found > 0.0f) {
+                float inv = 1.0f / n.found;
+                vx += dt * (alignment * (n.sumVx * inv - vx) + cohesion * speedMax * n.sumDx * inv / cellSize + separationWeight * speedMax * n.awayX);
+                vy += dt * (alignment * (n.sumVy * inv - vy) + cohesion * speedMax * n.sumDy * inv / cellSize + separationWeight * speedMax * n.awayY);
+            }
+            float speed = sqrt(vx * vx + vy * vy) + 1e-9f;
+            float clamped = min(max(speed, speedMin), speedMax);
+            vx *= clamped / speed;
+            vy *= clamped / speed;
+
+            x += vx * dt;
+            y += vy * dt;
+            if (x < 0.0f) x += worldWidth; else if (x >= worldWidth) x -= worldWidth;
+            if (y < 0.0f) y += worldHeight; else if (y >= worldHeight) y -= worldHeight;
+
+            current.x[i] = x; current.y[i] = y; current.vx[i] = vx; current.vy[i] = vy;
+        }
+        return checked;
+    }
+
+public:
+    /* boidsPerCell sets how crowded the world is, and so how many neighbours each boid has */
+    /* vectorize = false looks at neighbours one at a time, to measure against */
+    Flock(unsigned int numBoidsIn, float aspect, float boidsPerCell = 3.0f, bool vectorizeIn = true, uint32_t seed = 1)
+        : numBoids(max(numBoidsIn, 1u)), vectorize(vectorizeIn) {
+        /* cells as square as the aspect allows, and at least 3 across so the 3 x 3 around a cell never counts one twice */
+        float cells = numBoids / boidsPerCell;
+        gridHeight = max(3u, (unsigned int)sqrt(cells / aspect));
+        gridWidth = max(3u, (unsigned int)(gridHeight * aspect));
+        worldHeight = 1.0f;
+        cellSize = worldHeight / gridHeight;
+        invCellSize = 1.0f / cellSize;
+        worldWidth = gridWidth * cellSize;
+
+        current.resize(numBoids);
+        sorted.resize(numBoids);
+        cellOf.resize(numBoids);
+        cellStart.resize((size_t)gridWidth * gridHeight + 1);
+        cursor.resize((size_t)gridWidth * gridHeight);
+        checks.resize((numBoids + grain - 1) / grain);
+
+        /* scattered at random, heading every which way */
+        uint32_t state = seed * 2654435761u + 1;
+        auto random = [&state] {
+            state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+            return (state >> 8) * (1.0f / 16777216.0f);
+        };
+        for (unsigned int i = 0; i < numBoids; i++) {
+            float angle = 6.2831853f * random(), speed = cellSize * (minSpeed + (maxSpeed - minSpeed) * random());
+            current.x[i] = worldWidth * random();
+            current.y[i] = worldHeight * random();
+            current.vx[i] = speed * cos(angle);
+            current.vy[i] = speed * sin(angle);
+        }
+    }
+
+    Flock(const Flock&) = delete; // State points into its own vectors
+    Flock& operator=(const Flock&) = delete;
+
+    void rebuildGrid(JobSystem* jobs) {
+        /* counting sort of current into sorted by cell */
+        parallelFor(jobs, 0, numBoids, 8192, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++) cellOf[i] = cellAt(current.x[i], current.y[i]);
+        });
+
+        fill(cellStart.begin(), cellStart.end(), 0u);
+        for (unsigned int i = 0; i < numBoids; i++) cellStart[cellOf[i] + 1] ++;
+        for (size_t c = 1; c < cellStart.size(); c++) cellStart[c] += cellStart[c - 1];
+
+        copy(cellStart.begin(), cellStart.end() - 1, cursor.begin());
+        for (unsigned int i = 0; i < numBoids; i++) {
+            uint32_t to = cursor[cellOf[i]] ++;
+            sorted.x[to] = current.x[i]; sorted.y[to] = current.y[i];
+            sorted.vx[to] = current.vx[i]; sorted.vy[to] = current.vy[i];
+        }
+    }
+
+    void updateBoids(JobSystem* jobs, float dt) {
+        /* every boid reads sorted and writes current, so they are independent and run in parallel */
+        parallelFor(jobs, 0, checks.size(), 1, [&](size_t first, size_t last) {
+            for (size_t band = first; band < last; band++) {
+                checks[band] = updateRange((unsigned int)(band * grain), (unsigned int)min((band + 1) * grain, (size_t)numBoids), dt);
+            }
+        });
+    }
+
+    void advance(JobSystem* jobs, float dt) {
+        rebuildGrid(jobs);
+        updateBoids(jobs, dt);
+    }
+
+    const State& state() const { return current; }
+    size_t bytes() const { return (size_t)numBoids * 4 * sizeof(float); }
+    unsigned int boids() const { return numBoids; }
+    unsigned int cells() const { return gridWidth * gridHeight; }
+    float radius() const { return cellSize; }
+    float width() const { return worldWidth; }
+
+    double checksPerBoid() const {
+        /* neighbours looked at per boid in the last update, found or not */
+        uint64_t total = 0;
+        for (uint64_t c: checks) total += c;
+        return (double)total / numBoids;
+    }
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef BOIDS_SCENE_H
+#define BOIDS_SCENE_H
+
+#include "scene.h"
+#include "boids.h"
+#include "VAO.h"
+#include "vertexLayout.h"
+#include "timing.h"
+#include <iostream>
+
+using namespace std;
+
+/* ---------------------------- Boids scene ---------------------------- */
+/* A flock of boids (see Flock) filling the screen, each drawn as a small arrowhead facing the way it flies.
+
+The arrowhead is one triangle in a MyVAO, drawn once per boid with instancing. The flock's state is already structure of arrays
+in a single block, so each frame it is copied into an orphaned instance buffer as is, and x, y, vx and vy each come from their own part of it. */
+class BoidsScene : public Scene {
+    JobSystem &jobs;
+    Shader &shader;
+    Flock flock;
+    MyVAO arrowhead;
+    unsigned int instanceBuffer;
+    size_t instanceBytes;
+    FixedStep clock; // the flock always steps 1/60 s, as many times a frame as the time since the last calls for
+    bool uploaded = false;
+
+    StageTimer gridTimer, updateTimer, uploadTimer;
+
+public:
+    BoidsScene(const SceneContext &context)
+        : jobs(context.jobs), shader(context.shaders.get("shaders/boidsVertexShader.txt", "shaders/boidsFragmentShader.txt")),
+          /* --boids=<n> sets how many there are */
+          flock((unsigned int)max(1, stoi(context.option("boids", "200000"))), context.viewportAspect()) {
+        const glm::vec2 corners[3] = {glm::vec2(1.0f, 0.0f), glm::vec2(-0.6f, 0.45f), glm::vec2(-0.6f, -0.45f)};
+        arrowhead.addData<VertexLayout<Attr<glm::vec2, Position>>>(std::span<const glm::vec2>(corners, 3));
+
+        instanceBytes = flock.bytes();
+        glGenBuffers(1, &instanceBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instanceBytes, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        for (unsigned int i = 0; i < 4; i++) {
+            arrowhead.addInstanceAttrib(1 + i, instanceBuffer, {1, GL_FLOAT, false}, i * (size_t)flock.boids() * sizeof(float));
+        }
+
+        shader.use();
+        shader.setVec2("worldSize", glm::vec2(flock.width(), 1.0f));
+        shader.setFloat("size", 0.6f * flock.radius());
+    }
+
+    void update(double time, float dt) override {
+        /* fixed steps, so the flock keeps its speed whatever the frame rate */
+        unsigned int steps = clock.due(dt);
+        if (!steps && uploaded) return; // the buffer still holds the last step
+        for (unsigned int i = 0; i < steps; i++) {
+            {
+                ScopedStage stage(gridTimer);
+                flock.rebuildGrid(&jobs);
+            }
+            {
+                ScopedStage stage(updateTimer);
+                flock.updateBoids(&jobs, (float)clock.seconds());
+            }
+        }
+        uploaded = true;
+
+        /* orphan the buffer, so the upload never waits on the GPU drawing the last frame */
+        ScopedStage stage(uploadTimer);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instanceBytes, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instanceBytes, flock.state().data.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void draw(int width, int height) override {
+        glClearColor(0.02f, 0.03f, 0.06f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glDisable(GL_DEPTH_TEST); // flat, so the depth test would only cost
+        shader.use();
+        arrowhead.drawInstanced(flock.boids());
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    void report() override {
+        cout << "  boids: " << flock.boids() << " in " << flock.cells() << " cells, grid rebuild " << gridTimer.averageMs() << " ms, update "
+             << updateTimer.averageMs() << " ms (" << flock.checksPerBoid() << " neighbours checked per boid, " << jobs.threads() << " threads), upload "
+             << uploadTimer.averageMs() << " ms/frame" << endl;
+        gridTimer.reset(); updateTimer.reset(); uploadTimer.reset();
+    }
+
+    void del() override {
+        arrowhead.del();
+        glDeleteBuffers(1, &instanceBuffer);
+    }
+};
+
+#endif
@@ -0,0 +1,278 @@
+#ifndef CURVE_RENDERERS_H
+#define CURVE_RENDERERS_H
+
+#include "shader.h"
+#include "VAO.h"
+#include "simulation.h"
+#include "sineCurve.h"
+#include "meshBatch.h"
+#include "uniformBuffer.h"
+#include "shaderCache.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* The two ways of drawing a frame of curves. Which is faster depends on the device:
+the mesh costs vertex work per curve, the analytic pass costs fragment work per pixel per curve.
+Run --bench=curves to compare them. */
+enum class CurveRendererType { Mesh, Batched, Analytic };
+
+inline CurveRendererType parseCurveRenderer(const string &name) {
+    if (name == "analytic") return CurveRendererType::Analytic;
+    if (name == "batched") return CurveRendererType::Batched;
+    return CurveRendererType::Mesh;
+}
+
+/* ---------------------------- Uniform blocks ---------------------------- */
+/* The curve shaders' uniform blocks, the GLSL side is shaders/curveUniforms.txt */
+struct FrameUniforms {
+    glm::vec3 meshScale = glm::vec3(1.0f); // undoes any normalization of the vertex format
+    float phase = 0.0f;
+    glm::vec2 resolution = glm::vec2(1.0f); // the viewport in pixels
+    int numCurves = 0;
+
+    auto fields() const { return tie(meshScale, phase, resolution, numCurves); }
+};
+struct CurveUniforms {
+    glm::vec3 trans;
+    float colour;
+    float amplitude;
+
+    auto fields() const { return tie(trans, colour, amplitude); }
+};
+
+/* The per-frame block and one large array of per-curve blocks, each sent once per frame.
+A draw picks out its curve by index, rather than having its transform and colour set as separate uniforms. */
+class CurveUniformBlocks {
+    UniformBuffer<FrameUniforms> frameBlock;
+    UniformBuffer<CurveUniforms> curveBlock;
+
+public:
+    static const unsigned int frameBinding = 0, curveBinding = 1;
+
+    CurveUniformBlocks() : frameBlock(1, frameBinding), curveBlock(FramePacket::maxCurves, curveBinding) {}
+
+    static void attach(const Shader &shader) {
+        shader.bindUniformBlock("Frame", frameBinding);
+        shader.bindUniformBlock("Curves", curveBinding);
+    }
+
+    void setCurve(unsigned int index, const FramePacket::CurveState &curve) {
+        curveBlock.set(index, {curve.trans, curve.colour, curve.amplitude});
+    }
+
+    void upload(const FrameUniforms &frame) {
+        frameBlock.set(0, frame);
+        frameBlock.upload(1);
+        curveBlock.upload((unsigned int)frame.numCurves);
+    }
+
+    void del() {
+        frameBlock.del();
+        curveBlock.del();
+    }
+};
+
+/* The curve renderers' shader files */
+const char* const meshVertexShader = "shaders/vertexShader.txt";
+const char* const meshFragmentShader = "shaders/fragmentShader.txt";
+const char* const analyticVertexShader = "shaders/fullscreenVertexShader.txt";
+const char* const analyticFragmentShader = "shaders/analyticFragmentShader.txt";
+
+/* The defines picking a mesh shader permutation: per-draw data from a batch rather than the Curves block,
+and the debug overdraw view, where every fragment adds a little light so the brightest areas are drawn most often */
+inline ShaderDefines meshShaderDefines(bool batched, bool overdraw) {
+    ShaderDefines defines;
+    if (batched) defines["BATCHED"] = "";
+    if (overdraw) defines["OVERDRAW"] = "";
+    return defines;
+}
+
+/* Sets up additive blending with no depth test for the overdraw view, for as long as it is in scope */
+class OverdrawBlend {
+    bool enabled;
+
+public:
+    OverdrawBlend(bool enabledIn) : enabled(enabledIn) {
+        if (!enabled) return;
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+    }
+    ~OverdrawBlend() {
+        if (!enabled) return;
+        glDisable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+    }
+};
+
+/* Draws every curve as the sine mesh, translated into place.
+The mesh is three times wider than the screen, so each curve only draws the chunks that overlap the viewport after its translation. */
+class MeshCurves {
+    Shader &shader;
+    MyVAO &vao;
+    glm::vec3 scale; // undoes any normalization of the vertex format
+    vector<SineChunk> chunks; // empty to always draw the whole mesh
+
+    /* the ranges to draw for a curve, rebuilt per curve but kept to avoid allocating */
+    vector<GLint> firsts;
+    vector<GLsizei> counts;
+
+    /* how much of the mesh is being submitted, for the stage report */
+    size_t verticesDrawn = 0, verticesTotal = 0;
+
+    CurveUniformBlocks uniforms;
+    GLint curveIndexLocation;
+    bool overdraw;
+
+public:
+    MeshCurves(ShaderCache &shaders, MyVAO &vaoIn, glm::vec3 scaleIn, vector<SineChunk> chunksIn = {}, bool overdrawIn = false)
+        : shader(shaders.get(meshVertexShader, meshFragmentShader, meshShaderDefines(false, overdrawIn))),
+          vao(vaoIn), scale(scaleIn), chunks(chunksIn), overdraw(overdrawIn) {
+        CurveUniformBlocks::attach(shader);
+        curveIndexLocation = glGetUniformLocation(shader.ID, "curveIndex");
+    }
+
+    void draw(const FramePacket &frame) {
+        /* send every curve's translation and colour at once, each draw then only sets its index */
+        FrameUniforms frameUniforms;
+        frameUniforms.meshScale = scale;
+        frameUniforms.numCurves = (int)frame.numCurves;
+        for (unsigned int i = 0; i < frame.numCurves; i ++) uniforms.setCurve(i, frame.curves[i]);
+        uniforms.upload(frameUniforms);
+
+        OverdrawBlend blend(overdraw);
+        shader.use();
+        for (unsigned int i = 0; i < frame.numCurves; i ++) {
+            const FramePacket::CurveState &curve = frame.curves[i];
+            glUniform1i(curveIndexLocation, (int)i);
+
+            verticesTotal += vao.getNumVertices();
+            if (chunks.empty()) {
+                vao.draw();
+                verticesDrawn += vao.getNumVertices();
+                continue;
+            }
+
+            cullSineChunks(chunks, curve.trans.x, firsts, counts);
+            vao.drawRanges(firsts.data(), counts.data(), (unsigned int)firsts.size());
+            for (GLsizei count: counts) verticesDrawn += count;
+        }
+    }
+
+    double drawnFraction(bool reset = true) {
+        /* the share of mesh vertices submitted since the last call */
+        double fraction = verticesTotal ? (double)verticesDrawn / verticesTotal : 0.0;
+        if (reset) verticesDrawn = verticesTotal = 0;
+        return fraction;
+    }
+
+    void del() {
+        uniforms.del();
+    }
+};
+
+/* Draws every curve's visible chunks through a MeshBatch: one glMultiDrawArraysIndirect per frame on GL 4.3,
+one glMultiDrawArrays per curve on 3.3. The curve's translation and colour travel as per-draw vertex data instead of uniforms.
+That is a single vec4, so the curves' amplitudes are left out and they keep their shape. */
+class BatchedCurves {
+    Shader &shader;
+    MeshBatch &batch;
+    unsigned int base; // the sine mesh's first vertex in the batch
+    glm::vec3 scale;
+    vector<SineChunk> chunks;
+
+    vector<GLint> firsts;
+    vector<GLsizei> counts;
+
+    CurveUniformBlocks uniforms; // only the frame block, the curves travel with the draws
+    bool overdraw;
+
+public:
+    BatchedCurves(ShaderCache &shaders, MeshBatch &batchIn, unsigned int baseIn, glm::vec3 scaleIn, vector<SineChunk> chunksIn, bool overdrawIn = false)
+        : shader(shaders.get(meshVertexShader, meshFragmentShader, meshShaderDefines(true, overdrawIn))),
+          batch(batchIn), base(baseIn), scale(scaleIn), chunks(chunksIn), overdraw(overdrawIn) {
+        CurveUniformBlocks::attach(shader);
+    }
+
+    void draw(const FramePacket &frame) {
+        FrameUniforms frameUniforms;
+        frameUniforms.meshScale = scale;
+        uniforms.upload(frameUniforms);
+
+        OverdrawBlend blend(overdraw);
+        shader.use();
+
+        batch.begin();
+        for (unsigned int i = 0; i < frame.numCurves; i ++) {
+            const FramePacket::CurveState &curve = frame.curves[i];
+            cullSineChunks(chunks, curve.trans.x, firsts, counts);
+            batch.addDraw(glm::vec4(curve.trans, curve.colour), base, firsts.data(), counts.data(), (unsigned int)firsts.size());
+        }
+        batch.submit();
+    }
+
+    void del() {
+        uniforms.del();
+    }
+};
+
+/* Draws every curve in one full-screen triangle, testing each pixel against every curve's sine in the fragment shader.
+The edges are anti-aliased analytically, and the result matches the mesh, which is depth tested so nearer curves win. */
+class AnalyticCurves {
+    Shader &shader;
+    unsigned int emptyVAO; // the triangle comes from gl_VertexID, but core profile still needs a VAO
+    CurveUniformBlocks uniforms;
+
+public:
+    AnalyticCurves(ShaderCache &shaders) : shader(shaders.get(analyticVertexShader, analyticFragmentShader)) {
+        glGenVertexArrays(1, &emptyVAO);
+        CurveUniformBlocks::attach(shader);
+        shader.use();
+        shader.setVec2("uvScale", glm::vec2(1.0f));
+    }
+
+    void draw(const FramePacket &frame, float phase = 0.0f) {
+        /* sort front to back, the shader composites in that order */
+        unsigned int order[FramePacket::maxCurves];
+        for (unsigned int i = 0; i < frame.numCurves; i++) order[i] = i;
+        sort(order, order + frame.numCurves, [&](unsigned int a, unsigned int b) { return frame.curves[a].trans.z < frame.curves[b].trans.z; });
+        for (unsigned int i = 0; i < frame.numCurves; i++) uniforms.setCurve(i, frame.curves[order[i]]);
+
+        int viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
+        FrameUniforms frameUniforms;
+        frameUniforms.phase = phase;
+        frameUniforms.resolution = glm::vec2(viewport[2], viewport[3]);
+        frameUniforms.numCurves = (int)frame.numCurves;
+        uniforms.upload(frameUniforms);
+
+        shader.use();
+
+        /* every pixel is written, so the depth buffer isn't needed */
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    void del() {
+        uniforms.del();
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+};
+
+/* Reads the shaders a renderer will build, without a GL context, so it can happen while the window is still being made */
+inline void preloadCurveShaders(ShaderCache &shaders, CurveRendererType type, bool overdraw) {
+    switch (type) {
+        case CurveRendererType::Mesh: shaders.preload(meshVertexShader, meshFragmentShader, meshShaderDefines(false, overdraw)); break;
+        case CurveRendererType::Batched: shaders.preload(meshVertexShader, meshFragmentShader, meshShaderDefines(true, overdraw)); break;
+        case CurveRendererType::Analytic: shaders.preload(analyticVertexShader, analyticFragmentShader); break;
+    }
+}
+
+#endif
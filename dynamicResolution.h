@@ -0,0 +1,132 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include "shader.h"
+#include "renderTarget.h"
+#include "gpuTimer.h"
+#include "timing.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+
+/* Renders the scene into an offscreen target whose resolution follows the measured GPU time,
+then upscales it to the window.
+
+The target is allocated at the full framebuffer size and the scene is drawn into a scaled viewport of it,
+so changing the scale never reallocates anything. Only a window resize does,
+and that is debounced so dragging a window edge doesn't reallocate every frame. */
+class DynamicResolution {
+    RenderTarget target;
+    GpuTimer timer;
+    Shader upscaleShader;
+    unsigned int emptyVAO; // the upscale triangle comes from gl_VertexID, but core profile still needs a VAO
+
+    float budgetMs; // the GPU time per frame we aim for
+    bool sharpen;
+    float scale = 1.0f;
+    const float minScale = 0.4f;
+
+    double smoothedMs = 0.0;
+    unsigned int framesSinceChange = 0;
+
+    int windowWidth, windowHeight; // the current framebuffer size
+    bool resizePending = false;
+    Clock::time_point resizeTime;
+    const double resizeDebounceMs = 200.0;
+
+    int sceneWidth() const { return max(1, (int)(target.getWidth() * scale)); }
+    int sceneHeight() const { return max(1, (int)(target.getHeight() * scale)); }
+
+    void adjustScale() {
+        /* Fragment cost goes with pixel count, ie. scale squared, so jump straight to the scale that should fit
+        when over budget, and creep back up when comfortably under. Wait for the in-flight queries to settle between changes. */
+        if (!timer.poll()) return;
+        smoothedMs = smoothedMs == 0.0 ? timer.ms() : 0.9 * smoothedMs + 0.1 * timer.ms();
+
+        if (++framesSinceChange < 10) return;
+
+        float newScale = scale;
+        if (smoothedMs > budgetMs) newScale = scale * sqrt(budgetMs / smoothedMs) * 0.95f;
+        else if (smoothedMs < 0.7 * budgetMs) newScale = scale * 1.05f;
+        newScale = clamp(newScale, minScale, 1.0f);
+
+        if (fabs(newScale - scale) > 0.01f) {
+            scale = newScale;
+            framesSinceChange = 0;
+        }
+    }
+
+public:
+    DynamicResolution(int width, int height, float budgetMsIn, bool sharpenIn)
+        : upscaleShader("shaders/fullscreenVertexShader.txt", "shaders/sharpenFragmentShader.txt"),
+          budgetMs(budgetMsIn), sharpen(sharpenIn), windowWidth(width), windowHeight(height) {
+        glGenVertexArrays(1, &emptyVAO);
+        target.resize(width, height);
+    }
+
+    void onResize(int width, int height) {
+        /* called from the framebuffer size callback, the target catches up once the size settles */
+        windowWidth = width;
+        windowHeight = height;
+        resizePending = true;
+        resizeTime = Clock::now();
+    }
+
+    void beginFrame() {
+        /* bind the offscreen target at the current scale, ready for the scene */
+        if (resizePending && msBetween(resizeTime, Clock::now()) > resizeDebounceMs) {
+            target.resize(max(1, windowWidth), max(1, windowHeight));
+            resizePending = false;
+        }
+        adjustScale();
+
+        target.bind();
+        glViewport(0, 0, sceneWidth(), sceneHeight());
+        timer.begin();
+    }
+
+    void endFrame() {
+        /* upscale the scene into the window */
+        timer.end();
+
+        if (!sharpen) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, target.framebuffer());
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, sceneWidth(), sceneHeight(), 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            return;
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, windowWidth, windowHeight);
+        glDisable(GL_DEPTH_TEST);
+
+        upscaleShader.use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, target.texture());
+        upscaleShader.setInt("source", 0);
+        upscaleShader.setVec2("uvScale", glm::vec2((float)sceneWidth() / target.getWidth(), (float)sceneHeight() / target.getHeight()));
+        upscaleShader.setVec2("texelSize", glm::vec2(1.0f / target.getWidth(), 1.0f / target.getHeight()));
+        upscaleShader.setFloat("sharpness", scale < 1.0f ? 0.5f : 0.0f); // nothing to recover at full resolution
+
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    float getScale() const { return scale; }
+    double gpuMs() const { return smoothedMs; }
+
+    void del() {
+        target.del();
+        timer.del();
+        upscaleShader.del();
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+};
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include "simd.h"
+#include <cstring>
+#include <math.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/* One radix-4 butterfly on split complex values, for floats or for four at once in a float4.
+Outputs are (a + b + c + d), w1 (a - ib - c + id), w2 (a - b + c - d) and w3 (a + ib - c - id) */
+template <typename T>
+inline void fftButterfly4(T ar, T ai, T br, T bi, T cr, T ci, T dr, T di,
+                          T w1r, T w1i, T w2r, T w2i, T w3r, T w3i, T* outR, T* outI) {
+    T apcR = ar + cr, apcI = ai + ci, amcR = ar - cr, amcI = ai - ci;
+    T bpdR = br + dr, bpdI = bi + di, bmdR = br - dr, bmdI = bi - di;
+
+    outR[0] = apcR + bpdR;
+    outI[0] = apcI + bpdI;
+
+    T r = amcR + bmdI, i = amcI - bmdR; // (a - c) - i(b - d)
+    outR[1] = w1r * r - w1i * i;
+    outI[1] = w1r * i + w1i * r;
+
+    r = apcR - bpdR; i = apcI - bpdI;
+    outR[2] = w2r * r - w2i * i;
+    outI[2] = w2r * i + w2i * r;
+
+    r = amcR - bmdI; i = amcI + bmdR; // (a - c) + i(b - d)
+    outR[3] = w3r * r - w3i * i;
+    outI[3] = w3r * i + w3i * r;
+}
+
+/* A complex FFT of one power of two size, planned once (the twiddles) and then run as often as needed.
+It is a Stockham FFT: radix-4 passes, plus one radix-2 pass for odd powers of two, each reading one buffer and writing the other,
+so the output comes out in order without a bit reversal pass. The data is split into real and imaginary arrays, so each pass
+works on four butterflies at a time in a float4: across the contiguous run of a pass' stride, or for the first pass, whose stride
+is 1, across four neighbouring butterflies and transposed on the way out. */
+class FFT {
+    unsigned int n;
+    bool vectorize;
+
+    struct Pass {
+        unsigned int length, stride; // the sub-transform length this pass splits, and the distance between its elements
+        size_t twiddles; // offset of the pass' twiddles, 6 runs of length / 4: w1 re, w1 im, w2 re, w2 im, w3 re, w3 im
+    };
+    vector<Pass> passes;
+    vector<float> twiddles;
+
+    void radix4(const Pass &pass, const float* inR, const float* inI, float* outR, float* outI) const {
+        const unsigned int m = pass.length / 4, s = pass.stride;
+        const float* w = twiddles.data() + pass.twiddles;
+
+        if (vectorize && s >= 4) {
+            /* four neighbouring elements of the stride at once, sharing a twiddle */
+            for (unsigned int p = 0; p < m; p++) {
+                float4 w1r = splat4(w[p]), w1i = splat4(w[m + p]), w2r = splat4(w[2*m + p]);
+                float4 w2i = splat4(w[3*m + p]), w3r = splat4(w[4*m + p]), w3i = splat4(w[5*m + p]);
+                for (unsigned int q = 0; q < s; q += 4) {
+                    size_t a = q + (size_t)s * p, b = a + (size_t)s * m, c = b + (size_t)s * m, d = c + (size_t)s * m;
+                    float4 r[4], i[4];
+                    fftButterfly4(load4(inR + a), load4(inI + a), load4(inR + b), load4(inI + b),
+                                  load4(inR + c), load4(inI + c), load4(inR + d), load4(inI + d),
+                                  w1r, w1i, w2r, w2i, w3r, w3i, r, i);
+                    size_t out = q + (size_t)s * 4 * p;
+                    for (int k = 0; k < 4; k++) {
+                        store4(outR + out + k * s, r[k]);
+                        store4(outI + out + k * s, i[k]);
+                    }
+                }
+            }
+        } else if (vectorize && s == 1 && m >= 4) {
+            /* four neighbouring butterflies at once, whose four outputs each are adjacent, so transpose them to store */
+            for (unsigned int p = 0; p < m; p += 4) {
+                float4 r[4], i[4];
+                fftButterfly4(load4(inR + p), load4(inI + p), load4(inR + m + p), load4(inI + m + p),
+                              load4(inR + 2*m + p), load4(inI + 2*m + p), load4(inR + 3*m + p), load4(inI + 3*m + p),
+                              load4(w + p), load4(w + m + p), load4(w + 2*m + p), load4(w + 3*m + p), load4(w + 4*m + p), load4(w + 5*m + p), r, i);
+                transpose4(r[0], r[1], r[2], r[3]);
+                transpose4(i[0], i[1], i[2], i[3]);
+                for (int k = 0; k < 4; k++) {
+                    store4(outR + 4 * (p + k), r[k]);
+                    store4(outI + 4 * (p + k), i[k]);
+                }
+            }
+        } else {
+            for (unsigned int p = 0; p < m; p++) {
+                for (unsigned int q = 0; q < s; q++) {
+                    size_t a = q + (size_t)s * p, b = a + (size_t)s * m, c = b + (size_t)s * m, d = c + (size_t)s * m;
+                    float r[4], i[4];
+                    fftButterfly4(inR[a], inI[a], inR[b], inI[b], inR[c], inI[c], inR[d], inI[d],
+                                  w[p], w[m + p], w[2*m + p], w[3*m + p], w[4*m + p], w[5*m + p], r, i);
+                    size_t out = q + (size_t)s * 4 * p;
+                    for (int k = 0; k < 4; k++) {
+                        outR[out + k * s] = r[k];
+                        outI[out + k * s] = i[k];
+                    }
+                }
+            }
+        }
+    }
+
+    void radix2(const Pass &pass, const float* inR, const float* inI, float* outR, float* outI) const {
+        /* only ever the last pass, where the length is 2 and so the twiddle is 1 */
+        const unsigned int s = pass.stride;
+        unsigned int q = 0;
+        if (vectorize) {
+            for (; q + 4 <= s; q += 4) {
+                float4 ar = load4(inR + q), ai = load4(inI + q), br = load4(inR + q + s), bi = load4(inI + q + s);
+                store4(outR + q, ar + br);
+                store4(outI + q, ai + bi);
+                store4(outR + q + s, ar - br);
+                store4(outI + q + s, ai - bi);
+            }
+        }
+        for (; q < s; q++) {
+            float ar = inR[q], ai = inI[q], br = inR[q + s], bi = inI[q + s];
+            outR[q] = ar + br;
+            outI[q] = ai + bi;
+            outR[q + s] = ar - br;
+            outI[q + s] = ai - bi;
+        }
+    }
+
+public:
+    /* size must be a power of two. vectorize = false runs the same passes one butterfly at a time, to measure against */
+    FFT(unsigned int sizeIn, bool vectorizeIn = true) : n(sizeIn), vectorize(vectorizeIn) {
+        unsigned int stride = 1;
+        for (unsigned int length = n; length > 1; length /= 4) {
+            Pass pass{length, stride, twiddles.size()};
+            passes.push_back(pass);
+            stride *= 4;
+            if (length == 2) break;
+
+            /* w^p, w^2p and w^3p for w = e^(-2 pi i / length), worked out in double */
+            unsigned int m = length / 4;
+            twiddles.resize(twiddles.size() + 6 * m);
+            float* w = twiddles.data() + pass.twiddles;
+            for (unsigned int p = 0; p < m; p++) {
+                for (unsigned int k = 1; k <= 3; k++) {
+                    double angle = -2.0 * M_PI * k * p / length;
+                    w[(2*k - 2) * m + p] = (float)cos(angle);
+                    w[(2*k - 1) * m + p] = (float)sin(angle);
+                }
+            }
+        }
+    }
+
+    static bool isPowerOfTwo(unsigned int x) { return x >= 2 && (x & (x - 1)) == 0; }
+
+    unsigned int size() const { return n; }
+
+    /* floating point operations of one transform, by the usual 5 n log2(n) count, for throughput figures */
+    double flops() const { return 5.0 * n * log2((double)n); }
+
+    void forward(float* re, float* im, float* scratchRe, float* scratchIm) const {
+        /* transforms re, im in place, using scratch (also size() floats each) as the other buffer */
+        float *inR = re, *inI = im, *outR = scratchRe, *outI = scratchIm;
+        for (const Pass &pass: passes) {
+            if (pass.length == 2) radix2(pass, inR, inI, outR, outI);
+            else radix4(pass, inR, inI, outR, outI);
+            swap(inR, outR);
+            swap(inI, outI);
+        }
+        if (inR != re) {
+            memcpy(re, inR, n * sizeof(float));
+            memcpy(im, inI, n * sizeof(float));
+        }
+    }
+
+    void inverse(float* re, float* im, float* scratchRe, float* scratchIm) const {
+        /* the inverse transform, without the 1 / size() scaling: conjugating both sides of a forward transform */
+        conjugate(im);
+        forward(re, im, scratchRe, scratchIm);
+        conjugate(im);
+    }
+
+    void conjugate(float* im) const {
+        unsigned int i = 0;
+        if (vectorize) for (; i + 4 <= n; i += 4) store4(im + i, -load4(im + i));
+        for (; i < n; i++) im[i] = -im[i];
+    }
+};
+
+#endif
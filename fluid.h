@@ -0,0 +1,261 @@
+#ifndef FLUID_H
+#define FLUID_H
+
+#include "jobSystem.h"
+#include "simd.h"
+#include "timing.h"
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+using namespace std;
+
+/* Stam's stable fluids on a width x height grid of cells, with a border of one cell all round for the walls of a closed tank.
+Velocities are in cells per second, and two dyes are carried along by them, to show the flow.
+
+A step adds the emitters' pushes and ink, advects the velocity along itself, diffuses it by the viscosity, projects it to be divergence free,
+then advects the dyes along it. Advection traces each cell back along the velocity and samples bilinearly, so it is stable for any step.
+Diffusion and the pressure solve are Jacobi iterations rather than Gauss-Seidel: every cell of an iteration only reads the last one,
+so a row goes four cells at a time in a float4, and rows are spread over the job system, where red-black ordering would split each row
+into every other cell. Jacobi converges more slowly, so the pressure gets however many iterations the caller can afford, see setIterations. */
+class FluidSolver {
+public:
+    /* the time spent in each kernel, for working out where a step goes */
+    struct KernelTimers {
+        StageTimer forces, advect, diffuse, divergence, pressure, gradient;
+        void reset() { forces.reset(); advect.reset(); diffuse.reset(); divergence.reset(); pressure.reset(); gradient.reset(); }
+    };
+
+    struct Emitter {
+        float x, y; // in cells
+        float pushX, pushY; // cells per second added at the centre
+        float radius; // in cells
+        int dye; // which of the two dyes it adds
+    };
+
+private:
+    int width, height;
+    size_t stride; // floats per row, with the border
+    vector<float> u, v, uTemp, vTemp, pressure, pressureTemp, divergence;
+    vector<float> dyes[2], dyeTemp;
+    unsigned int iterations = 40;
+    float viscosity, dyeFade;
+    KernelTimers timers;
+
+    size_t at(int x, int y) const { return (size_t)y * stride + x; }
+
+    enum Wall { Copy, NegateX, NegateY };
+    void setBoundary(vector<float> &field, Wall wall) {
+        /* the border cells mirror the edge cells, the velocity across a wall negated so nothing flows through it */
+        for (int x = 1; x <= width; x++) {
+            field[at(x, 0)] = wall == NegateY ? -field[at(x, 1)] : field[at(x, 1)];
+            field[at(x, height + 1)] = wall == NegateY ? -field[at(x, height)] : field[at(x, height)];
+        }
+        for (int y = 1; y <= height; y++) {
+            field[at(0, y)] = wall == NegateX ? -field[at(1, y)] : field[at(1, y)];
+            field[at(width + 1, y)] = wall == NegateX ? -field[at(width, y)] : field[at(width, y)];
+        }
+        field[at(0, 0)] = 0.5f * (field[at(1, 0)] + field[at(0, 1)]);
+        field[at(width + 1, 0)] = 0.5f * (field[at(width, 0)] + field[at(width + 1, 1)]);
+        field[at(0, height + 1)] = 0.5f * (field[at(1, height + 1)] + field[at(0, height)]);
+        field[at(width + 1, height + 1)] = 0.5f * (field[at(width, height + 1)] + field[at(width + 1, height)]);
+    }
+
+    template <typename F>
+    void rows(JobSystem* jobs, const F &fn) {
+        /* fn(y) for every row inside the border, spread over the jobs */
+        parallelFor(jobs, 1, height + 1, 16, [&](size_t first, size_t last) {
+            for (size_t y = first; y < last; y++) fn((int)y);
+        });
+    }
+
+    void jacobi(JobSystem* jobs, vector<float> &x, vector<float> &temp, const vector<float> &b, float a, float c, Wall wall, unsigned int count, bool vectorize) {
+        /* count iterations of x = (b + a * (the sum of x's four neighbours)) / c, the implicit step diffusion and the pressure both come to */
+        float inverse = 1.0f / c;
+        for (unsigned int k = 0; k < count; k++) {
+            rows(jobs, [&](int y) {
+                const float* in = &x[at(0, y)];
+                const float* source = &b[at(0, y)];
+                float* out = &temp[at(0, y)];
+                int i = 1;
+                if (vectorize) {
+                    const float4 a4 = splat4(a), inverse4 = splat4(inverse);
+                    for (; i + 4 <= width + 1; i += 4) {
+                        float4 neighbours = load4(in + i - 1) + load4(in + i + 1) + load4(in + i - stride) + load4(in + i + stride);
+                        store4(out + i, (load4(source + i) + a4 * neighbours) * inverse4);
+                    }
+                }
+                for (; i <= width; i++) out[i] = (source[i] + a * (in[i - 1] + in[i + 1] + in[i - stride] + in[i + stride])) * inverse;
+            });
+            setBoundary(temp, wall);
+            swap(x, temp);
+        }
+    }
+
+    void advect(JobSystem* jobs, vector<float> &out, const vector<float> &in, float dt, Wall wall, bool vectorize, float keep = 1.0f) {
+        /* out at each cell is in where the flow there came from dt ago, times keep */
+        rows(jobs, [&](int y) {
+            const float* uRow = &u[at(0, y)];
+            const float* vRow = &v[at(0, y)];
+            float* outRow = &out[at(0, y)];
+            auto sample = [&](float px, float py) {
+                px = min(max(px, 0.5f), width + 0.5f);
+                py = min(max(py, 0.5f), height + 0.5f);
+                int x0 = (int)px, y0 = (int)py;
+                float fx = px - x0, fy = py - y0;
+                size_t i = at(x0, y0);
+                return (1.0f - fy) * ((1.0f - fx) * in[i] + fx * in[i + 1]) + fy * ((1.0f - fx) * in[i + stride] + fx * in[i + stride + 1]);
+            };
+
+            int x = 1;
+            if (vectorize) {
+                /* the trace back and the clamping four at a time, then the four cells under each lane gathered, and blended four at a time */
+                static const float lanes[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+                const float4 lane = load4(lanes), step = splat4(dt), low = splat4(0.5f), highX = splat4(width + 0.5f), highY = splat4(height + 0.5f);
+                const float4 one = splat4(1.0f), keep4 = splat4(keep);
+                for (; x + 4 <= width + 1; x += 4) {
+                    float4 px = min4(max4(splat4((float)x) + lane - step * load4(uRow + x), low), highX);
+                    float4 py = min4(max4(splat4((float)y) - step * load4(vRow + x), low), highY);
+                    float xs[4], ys[4], fxs[4], fys[4], c00[4], c10[4], c01[4], c11[4];
+                    store4(xs, px); store4(ys, py);
+                    for (int k = 0; k < 4; k++) {
+                        int x0 = (int)xs[k], y0 = (int)ys[k];
+                        fxs[k] = xs[k] - x0;
+                        fys[k] = ys[k] - y0;
+                        size_t i = at(x0, y0);
+                        c00[k] = in[i]; c10[k] = in[i + 1]; c01[k] = in[i + stride]; c11[k] = in[i + stride + 1];
+                    }
+                    float4 fx = load4(fxs), fy = load4(fys);
+                    float4 bottom = (one - fx) * load4(c00) + fx * load4(c10), top = (one - fx) * load4(c01) + fx * load4(c11);
+                    store4(outRow + x, keep4 * ((one - fy) * bottom + fy * top));
+                }
+            }
+            for (; x <= width; x++) outRow[x] = keep * sample(x - dt * uRow[x], y - dt * vRow[x]);
+        });
+        setBoundary(out, wall);
+    }
+
+    void project(JobSystem* jobs, bool vectorize) {
+        /* takes away the gradient of the pressure that makes the velocity divergence free, with the tank's walls */
+        {
+            ScopedStage stage(timers.divergence);
+            rows(jobs, [&](int y) {
+                const float* uRow = &u[at(0, y)];
+                const float* vRow = &v[at(0, y)];
+                float* out = &divergence[at(0, y)];
+                int x = 1;
+                if (vectorize) {
+                    const float4 half = splat4(-0.5f);
+                    for (; x + 4 <= width + 1; x += 4) {
+                        store4(out + x, half * (load4(uRow + x + 1) - load4(uRow + x - 1) + load4(vRow + x + stride) - load4(vRow + x - stride)));
+                    }
+                }
+                for (; x <= width; x++) out[x] = -0.5f * (uRow[x + 1] - uRow[x - 1] + vRow[x + stride] - vRow[x - stride]);
+            });
+            setBoundary(divergence, Copy);
+        }
+        {
+            /* starts from the last step's pressure, which is close, so fewer iterations get further */
+            ScopedStage stage(timers.pressure);
+            jacobi(jobs, pressure, pressureTemp, divergence, 1.0f, 4.0f, Copy, iterations, vectorize);
+        }
+        ScopedStage stage(timers.gradient);
+        rows(jobs, [&](int y) {
+            const float* p = &pressure[at(0, y)];
+            float* uRow = &u[at(0, y)];
+            float* vRow = &v[at(0, y)];
+            int x = 1;
+            if (vectorize) {
+                const float4 half = splat4(0.5f);
+                for (; x + 4 <= width + 1; x += 4) {
+                    store4(uRow + x, load4(uRow + x) - half * (load4(p + x + 1) - load4(p + x - 1)));
+                    store4(vRow + x, load4(vRow + x) - half * (load4(p + x + stride) - load4(p + x - stride)));
+                }
+            }
+            for (; x <= width; x++) {
+                uRow[x] -= 0.5f * (p[x + 1] - p[x - 1]);
+                vRow[x] -= 0.5f * (p[x + stride] - p[x - stride]);
+            }
+        });
+        setBoundary(u, NegateX);
+        setBoundary(v, NegateY);
+    }
+
+public:
+    /* viscosity is in cells squared per second, and the dyes keep dyeFade of themselves a second */
+    FluidSolver(int widthIn, int heightIn, float viscosityIn = 0.0f, float dyeFadeIn = 0.5f)
+        : width(max(widthIn, 4)), height(max(heightIn, 4)), stride(width + 2), viscosity(viscosityIn), dyeFade(dyeFadeIn) {
+        size_t cells = stride * (height + 2);
+        for (vector<float>* field: {&u, &v, &uTemp, &vTemp, &pressure, &pressureTemp, &divergence, &dyes[0], &dyes[1], &dyeTemp}) field->assign(cells, 0.0f);
+    }
+
+    void setIterations(unsigned int count) { iterations = max(count, 1u); }
+    unsigned int getIterations() const { return iterations; }
+
+    void step(JobSystem* jobs, float dt, const vector<Emitter> &emitters, bool vectorize = true) {
+        /* vectorize = false does every kernel a cell at a time, to measure against */
+        {
+            ScopedStage stage(timers.forces);
+            for (const Emitter &emitter: emitters) {
+                /* a soft round splat of push and ink */
+                int r = (int)ceil(emitter.radius);
+                for (int y = max(1, (int)emitter.y - r); y <= min(height, (int)emitter.y + r); y++) {
+                    for (int x = max(1, (int)emitter.x - r); x <= min(width, (int)emitter.x + r); x++) {
+                        float dx = x - emitter.x, dy = y - emitter.y;
+                        float weight = max(0.0f, 1.0f - (dx * dx + dy * dy) / (emitter.radius * emitter.radius));
+                        u[at(x, y)] += dt * weight * emitter.pushX;
+                        v[at(x, y)] += dt * weight * emitter.pushY;
+                        float &dye = dyes[emitter.dye][at(x, y)];
+                        dye = min(1.0f, dye + 4.0f * dt * weight);
+                    }
+                }
+            }
+        }
+        {
+            ScopedStage stage(timers.advect);
+            advect(jobs, uTemp, u, dt, NegateX, vectorize);
+            advect(jobs, vTemp, v, dt, NegateY, vectorize);
+            swap(u, uTemp);
+            swap(v, vTemp);
+        }
+        if (viscosity > 0.0f) {
+            /* implicit, so it is stable however viscous, a quarter as many iterations as the pressure as it is far more diagonal */
+            ScopedStage stage(timers.diffuse);
+            float a = dt * viscosity;
+            unsigned int count = max(2u, iterations / 4);
+            uTemp = u;
+            jacobi(jobs, u, vTemp, uTemp, a, 1.0f + 4.0f * a, NegateX, count, vectorize);
+            uTemp = v;
+            jacobi(jobs, v, vTemp, uTemp, a, 1.0f + 4.0f * a, NegateY, count, vectorize);
+        }
+        project(jobs, vectorize);
+
+        ScopedStage stage(timers.advect);
+        float fade = pow(dyeFade, dt);
+        for (vector<float> &dye: dyes) {
+            advect(jobs, dyeTemp, dye, dt, Copy, vectorize, fade);
+            swap(dye, dyeTemp);
+        }
+    }
+
+    float maxDivergence() const {
+        /* how far from divergence free the velocity is, in cells per second a cell, to see what the pressure iterations buy */
+        float most = 0.0f;
+        for (int y = 1; y <= height; y++) {
+            for (int x = 1; x <= width; x++) {
+                float d = 0.5f * (u[at(x + 1, y)] - u[at(x - 1, y)] + v[at(x, y + 1)] - v[at(x, y - 1)]);
+                most = max(most, fabs(d));
+            }
+        }
+        return most;
+    }
+
+    /* a dye, width + 2 by height + 2 floats with the border, eg. to upload */
+    const float* dye(int i) const { return dyes[i].data(); }
+    size_t rowStride() const { return stride; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    KernelTimers& kernelTimers() { return timers; }
+};
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef FLUID_SCENE_H
+#define FLUID_SCENE_H
+
+#include "scene.h"
+#include "fluid.h"
+#include "timing.h"
+#include <iostream>
+#include <math.h>
+
+using namespace std;
+
+/* ---------------------------- Fluid scene ---------------------------- */
+/* Ink in water: a few emitters circle a tank (see FluidSolver), each pushing the water along its path and letting out one of two inks.
+
+The two dyes are uploaded each frame straight from the solver as single channel float textures, skipping the border with
+GL_UNPACK_SKIP_PIXELS and SKIP_ROWS, and drawn over a full-screen triangle, filtered linearly so the grid doesn't show.
+The pressure iterations follow the measured time of the pressure solve like the dynamic resolution follows the GPU's, so the flow is as close to
+divergence free as the budget allows. Only the pressure is budgeted: the other kernels don't change with the iterations, so counting them
+would only push the iterations down to the minimum whenever they alone take the budget. */
+class FluidScene : public Scene {
+    JobSystem &jobs;
+    Shader &shader;
+    FluidSolver solver;
+    vector<FluidSolver::Emitter> emitters;
+    FixedStep clock; // the solver always steps 1/60 s, as many times a frame as the time since the last calls for
+    bool uploaded = false;
+
+    unsigned int textures[2];
+    unsigned int emptyVAO; // the full-screen triangle comes from gl_VertexID
+
+    float budgetMs; // the pressure solve's time per frame the iterations aim for, over all of the frame's steps, 0 to keep them fixed
+    const unsigned int minIterations = 4, maxIterations = 100;
+    double smoothedMs = 0.0;
+    unsigned int framesSinceChange = 0;
+
+    StageTimer solveTimer, uploadTimer;
+
+    void adjustIterations(double pressureMs) {
+        /* the pressure's time goes with the iterations, so jump straight to the count that should fit when over budget,
+        and creep back up when comfortably under, by at least one so a small count can still grow */
+        if (budgetMs <= 0.0f) return;
+        smoothedMs = smoothedMs == 0.0 ? pressureMs : 0.9 * smoothedMs + 0.1 * pressureMs;
+        if (++framesSinceChange < 10) return;
+
+        float count = (float)solver.getIterations();
+        if (smoothedMs > budgetMs) count *= budgetMs / smoothedMs * 0.95f;
+        else if (smoothedMs < 0.7 * budgetMs) count = max(count + 1.0f, count * 1.1f);
+        unsigned int newCount = (unsigned int)clamp(count, (float)minIterations, (float)maxIterations);
+
+        if (newCount != solver.getIterations()) {
+            solver.setIterations(newCount);
+            framesSinceChange = 0;
+        }
+    }
+
+    void moveEmitters(double time) {
+        /* around ellipses, at different speeds, pushing along the way they go */
+        for (size_t i = 0; i < emitters.size(); i++) {
+            double speed = 0.25 + 0.1 * i, angle = speed * time + 6.2831853 * i / emitters.size();
+            float w = (float)solver.getWidth(), h = (float)solver.getHeight();
+            float rx = (0.25f + 0.05f * i) * w, ry = (0.3f - 0.04f * i) * h;
+            emitters[i].x = 0.5f * w + rx * (float)cos(angle);
+            emitters[i].y = 0.5f * h + ry * (float)sin(angle);
+            emitters[i].pushX = -(float)(sin(angle) * speed) * rx * 6.0f;
+            emitters[i].pushY = (float)(cos(angle) * speed) * ry * 6.0f;
+        }
+    }
+
+public:
+    FluidScene(const SceneContext &context)
+        : jobs(context.jobs), shader(context.shaders.get("shaders/fullscreenVertexShader.txt", "shaders/fluidFragmentShader.txt")),
+          /* --fluid-cells=<n> is how many cells high the tank is, --fluid-viscosity in cells squared per second */
+          solver((int)(context.viewportAspect() * max(16, stoi(context.option("fluid-cells", "256")))), max(16, stoi(context.option("fluid-cells", "256"))),
+                 max(0.0f, stof(context.option("fluid-viscosity", "0.5")))),
+          /* --fluid-budget=<ms> is the time each frame the pressure solve aims for, 0 to keep --fluid-iterations */
+          budgetMs(max(0.0f, stof(context.option("fluid-budget", "3")))) {
+        solver.setIterations((unsigned int)max(1, stoi(context.option("fluid-iterations", "40"))));
+        float radius = max(2.0f, solver.getHeight() / 40.0f);
+        for (int i = 0; i < 4; i++) emitters.push_back({0.0f, 0.0f, 0.0f, 0.0f, radius, i % 2});
+
+        glGenVertexArrays(1, &emptyVAO);
+        glGenTextures(2, textures);
+        for (int i = 0; i < 2; i++) {
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, solver.getWidth(), solver.getHeight(), 0, GL_RED, GL_FLOAT, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+
+        shader.use();
+        shader.setVec2("uvScale", glm::vec2(1.0f));
+        shader.setInt("inkA", 0);
+        shader.setInt("inkB", 1);
+    }
+
+    void update(double time, float dt) override {
+        /* fixed steps of the solver, each with the emitters where they were at its time, so the ink keeps its speed whatever the frame rate */
+        unsigned int steps = clock.due(dt);
+        if (steps) {
+            double pressureBefore = solver.kernelTimers().pressure.totalMs();
+            {
+                ScopedStage stage(solveTimer);
+                for (unsigned int i = 0; i < steps; i++) {
+                    moveEmitters(time - (steps - 1 - i) * clock.seconds());
+                    solver.step(&jobs, (float)clock.seconds(), emitters);
+                }
+            }
+            adjustIterations(solver.kernelTimers().pressure.totalMs() - pressureBefore);
+        } else if (uploaded) {
+            return; // the textures still hold the last step
+        }
+        uploaded = true;
+
+        ScopedStage stage(uploadTimer);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, (GLint)solver.rowStride());
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 1);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 1);
+        for (int i = 0; i < 2; i++) {
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, solver.getWidth(), solver.getHeight(), GL_RED, GL_FLOAT, solver.dye(i));
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    }
+
+    void draw(int width, int height) override {
+        glDisable(GL_DEPTH_TEST); // every pixel is drawn once
+        shader.use();
+        for (int i = 0; i < 2; i++) {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    void report() override {
+        FluidSolver::KernelTimers &kernels = solver.kernelTimers();
+        cout << "  fluid: " << solver.getWidth() << "x" << solver.getHeight() << ", " << solver.getIterations() << " pressure iterations, step "
+             << solveTimer.averageMs() << " ms/frame (" << jobs.threads() << " threads): forces " << kernels.forces.averageMs() << ", advect "
+             << kernels.advect.averageMs() << ", diffuse " << kernels.diffuse.averageMs() << ", divergence " << kernels.divergence.averageMs()
+             << ", pressure " << kernels.pressure.averageMs() << ", gradient " << kernels.gradient.averageMs() << " ms, upload " << uploadTimer.averageMs()
+             << " ms, divergence left " << solver.maxDivergence() << "/s" << endl;
+        kernels.reset(); solveTimer.reset(); uploadTimer.reset();
+    }
+
+    void del() override {
+        glDeleteTextures(2, textures);
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+};
+
+#endif
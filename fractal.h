@@ -0,0 +1,191 @@
+#ifndef FRACTAL_H
+#define FRACTAL_H
+
+#include "jobSystem.h"
+#include "simd.h"
+#include "timing.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <math.h>
+#include <vector>
+
+using namespace std;
+
+/* Where the fractal is looked at from. scale is half the height of the view in the complex plane.
+For a Julia set every pixel starts z at itself and adds juliaC, for the Mandelbrot set z starts at 0 and adds the pixel */
+struct FractalView {
+    double centreX = -0.5, centreY = 0.0, scale = 1.5;
+    bool julia = false;
+    float juliaX = -0.8f, juliaY = 0.156f;
+    unsigned int maxIterations = 200;
+};
+
+/* The colour of a pixel that escaped after a smooth count of iterations, repeating every 1 of t.
+The same as the fractal fragment shader's, so both paths look alike */
+inline void fractalPalette(float t, uint8_t* out) {
+    float blend = 0.5f + 0.5f * sin(6.2831853f * t);
+    float bright = 0.25f + 0.75f * (0.5f + 0.5f * cos(6.2831853f * 3.0f * t));
+    float r = (0.0f + 0.1f * blend) * bright, g = (0.8f - 0.5f * blend) * bright, b = (0.7f + 0.1f * blend) * bright;
+    out[0] = (uint8_t)(r * 255.0f + 0.5f); out[1] = (uint8_t)(g * 255.0f + 0.5f); out[2] = (uint8_t)(b * 255.0f + 0.5f); out[3] = 255;
+}
+
+/* The CPU fractal: an RGBA8 image of a view, filled in progressively so there is something to show straight away.
+The image is cut into square tiles, spread over the job system, and worked through in passes, each sampling every stride'th pixel
+and filling the stride x stride block it starts, with strides 8, 4, 2 then 1. A pass skips the pixels the coarser ones already sampled,
+so refining all the way costs only the full image. Each call to refine does whole tiles until its time is up, so however slow the CPU,
+a frame never waits long, and the image sharpens over the next few. It works in double, so it can zoom about a billion times further
+than the shader, which only has float. Four pixels of a row are iterated at once in two double2s, each lane frozen once it escapes,
+until all four have or they run out of iterations. */
+class FractalImage {
+    int width = 0, height = 0;
+    vector<uint8_t> pixels;
+    vector<uint8_t> palette; // 1024 entries over one repeat of the palette
+
+    FractalView view;
+    int stride = 0; // of the pass being done, 0 once finished
+    size_t nextTile = 0;
+
+    static const int tileSize = 64; // a multiple of the coarsest stride, so every pass lines up with the tiles
+    static const int coarsest = 8;
+    static const unsigned int paletteSize = 1024;
+
+    int tilesX() const { return (width + tileSize - 1) / tileSize; }
+    int tilesY() const { return (height + tileSize - 1) / tileSize; }
+
+    void shade(int x, int y, float iterations, float zr, float zi) {
+        /* fills the stride x stride block at (x, y), from where the pixel escaped, or in the set if it never did */
+        uint8_t colour[4] = {5, 8, 15, 255};
+        if (iterations < view.maxIterations) {
+            float smooth = iterations + 1.0f - log2(max(0.5f * log2(zr * zr + zi * zi), 1e-6f));
+            float t = smooth * 0.02f;
+            const uint8_t* entry = &palette[4 * (size_t)((unsigned int)(max(t, 0.0f) * paletteSize) % paletteSize)];
+            copy(entry, entry + 4, colour);
+        }
+        int right = min(x + stride, width), top = min(y + stride, height);
+        for (int j = y; j < top; j++) {
+            uint32_t* row = (uint32_t*)&pixels[((size_t)j * width) * 4];
+            uint32_t packed;
+            memcpy(&packed, colour, 4);
+            fill(row + x, row + right, packed);
+        }
+    }
+
+    void sampleRow(int y, int first, int last, int step, bool vectorize) {
+        /* iterates the pixels first, first + step ... up to last of row y */
+        double pixelSize = 2.0 * view.scale / height;
+        double py = view.centreY + (y + 0.5 - 0.5 * height) * pixelSize;
+        unsigned int maxIterations = view.maxIterations;
+        int x = first;
+        if (vectorize) {
+            /* four pixels as two double2s, so each pair's iteration runs while the other waits on its last */
+            static const double lanes[2] = {0.0, 1.0};
+            const double2 four = splat2(4.0), two = splat2(2.0), zero = splat2(0.0);
+            const double2 pyv = splat2(py), laneStep = load2(lanes) * splat2(step * pixelSize);
+            for (; x + 3 * step < last; x += 4 * step) {
+                double2 px[2], zr[2], zi[2], cr[2], ci[2], count[2] = {zero, zero};
+                for (int h = 0; h < 2; h++) {
+                    px[h] = splat2(view.centreX + (x + 2 * h * step + 0.5 - 0.5 * width) * pixelSize) + laneStep;
+                    zr[h] = view.julia ? px[h] : zero;
+                    zi[h] = view.julia ? pyv : zero;
+                    cr[h] = view.julia ? splat2(view.juliaX) : px[h];
+                    ci[h] = view.julia ? splat2(view.juliaY) : pyv;
+                }
+                for (unsigned int i = 0; i < maxIterations; i++) {
+                    double2 zr2a = zr[0] * zr[0], zi2a = zi[0] * zi[0], zr2b = zr[1] * zr[1], zi2b = zi[1] * zi[1];
+                    double2 insideA = less2(zr2a + zi2a, four), insideB = less2(zr2b + zi2b, four);
+                    if (sum2(insideA + insideB) == 0.0) break;
+                    count[0] = count[0] + insideA;
+                    count[1] = count[1] + insideB;
+                    /* escaped lanes keep the z they escaped with, for the smooth colouring */
+                    double2 nextRa = zr2a - zi2a + cr[0], nextIa = two * zr[0] * zi[0] + ci[0];
+                    double2 nextRb = zr2b - zi2b + cr[1], nextIb = two * zr[1] * zi[1] + ci[1];
+                    zr[0] = zr[0] + insideA * (nextRa - zr[0]);
+                    zi[0] = zi[0] + insideA * (nextIa - zi[0]);
+                    zr[1] = zr[1] + insideB * (nextRb - zr[1]);
+                    zi[1] = zi[1] + insideB * (nextIb - zi[1]);
+                }
+                for (int h = 0; h < 2; h++) {
+                    double counts[2], outR[2], outI[2];
+                    store2(counts, count[h]); store2(outR, zr[h]); store2(outI, zi[h]);
+                    for (int k = 0; k < 2; k++) shade(x + (2 * h + k) * step, y, (float)counts[k], (float)outR[k], (float)outI[k]);
+                }
+            }
+        }
+        for (; x < last; x += step) {
+            double px = view.centreX + (x + 0.5 - 0.5 * width) * pixelSize;
+            double zr = view.julia ? px : 0.0, zi = view.julia ? py : 0.0;
+            double cr = view.julia ? view.juliaX : px, ci = view.julia ? view.juliaY : py;
+            unsigned int i = 0;
+            for (; i < maxIterations; i++) {
+                double zr2 = zr * zr, zi2 = zi * zi;
+                if (zr2 + zi2 >= 4.0) break;
+                zi = 2.0 * zr * zi + ci;
+                zr = zr2 - zi2 + cr;
+            }
+            shade(x, y, (float)i, (float)zr, (float)zi);
+        }
+    }
+
+    void sampleTile(size_t tile, bool vectorize) {
+        /* this pass's pixels in one tile, skipping those a coarser pass has sampled */
+        int x0 = (int)(tile % tilesX()) * tileSize, y0 = (int)(tile / tilesX()) * tileSize;
+        int x1 = min(x0 + tileSize, width), y1 = min(y0 + tileSize, height);
+        for (int y = y0; y < y1; y += stride) {
+            bool coarseRow = stride < coarsest && y % (2 * stride) == 0;
+            if (coarseRow) sampleRow(y, x0 + stride, x1, 2 * stride, vectorize);
+            else sampleRow(y, x0, x1, stride, vectorize);
+        }
+    }
+
+public:
+    FractalImage() {
+        palette.resize(paletteSize * 4);
+        for (unsigned int i = 0; i < paletteSize; i++) fractalPalette((float)i / paletteSize, &palette[4 * i]);
+    }
+
+    void begin(const FractalView &viewIn, int widthIn, int heightIn) {
+        /* starts on a new view, keeping whatever was there to be painted over */
+        if (widthIn != width || heightIn != height) {
+            width = max(widthIn, 1);
+            height = max(heightIn, 1);
+            pixels.assign((size_t)width * height * 4, 0);
+        }
+        view = viewIn;
+        stride = coarsest;
+        nextTile = 0;
+    }
+
+    bool refine(JobSystem* jobs, double budgetMs, bool vectorize = true) {
+        /* works through tiles, a batch per thread at a time, until budgetMs is used or the image is finished. Returns whether it changed */
+        if (stride == 0) return false;
+        Clock::time_point start = Clock::now();
+        size_t tiles = (size_t)tilesX() * tilesY();
+        size_t batch = jobs ? 2 * (size_t)jobs->threads() : 1;
+        do {
+            size_t first = nextTile, last = min(first + batch, tiles);
+            parallelFor(jobs, first, last, 1, [&](size_t begin, size_t end) {
+                for (size_t tile = begin; tile < end; tile++) sampleTile(tile, vectorize);
+            });
+            nextTile = last;
+            if (nextTile == tiles) {
+                nextTile = 0;
+                stride /= 2;
+            }
+        } while (stride > 0 && msBetween(start, Clock::now()) < budgetMs);
+        return true;
+    }
+
+    void render(JobSystem* jobs, bool vectorize = true) {
+        /* every pass at once, eg. to time the whole image */
+        while (refine(jobs, 1e30, vectorize)) {}
+    }
+
+    bool finished() const { return stride == 0; }
+    int passStride() const { return stride; }
+    const uint8_t* data() const { return pixels.data(); }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+};
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef FRACTAL_SCENE_H
+#define FRACTAL_SCENE_H
+
+#include "scene.h"
+#include "fractal.h"
+#include "timing.h"
+#include <iostream>
+#include <limits>
+#include <math.h>
+
+using namespace std;
+
+/* ---------------------------- Fractal scene ---------------------------- */
+/* An endless zoom into the Mandelbrot set, or a Julia set, towards a point on its edge, with more iterations the deeper it goes.
+The zoom starts again once a pixel nears the precision of the numbers the path works in there: the shader has float, good for
+a little under 10000x, and the CPU double, good for a few trillion times.
+
+--fractal-path picks where it is worked out:
+gpu iterates every pixel each frame in a fragment shader, so the zoom is smooth.
+cpu zooms in steps (see FractalImage): each step starts a new image, coarse at first and sharpening over the next frames within
+--fractal-budget ms of CPU a frame, and until the next step the shader magnifies it by how far the zoom has gone since. */
+class FractalScene : public Scene {
+    JobSystem &jobs;
+    bool onGpu;
+    Shader &shader;
+    FractalView start;
+    double stepSeconds, zoomStep, budgetMs;
+    double cycleSteps; // how many steps before the zoom nears the path's precision and starts again
+    double depth = 0.0; // in steps
+
+    FractalImage image;
+    unsigned int texture = 0;
+    unsigned int emptyVAO; // the full-screen triangle comes from gl_VertexID
+    long long imageStep = -1; // the step the image is of
+    int imageWidth = 0, imageHeight = 0;
+
+    StageTimer refineTimer;
+    unsigned int stepsFinished = 0, stepsAbandoned = 0, framesRefining = 0;
+
+    static ShaderDefines defines(bool onGpu, bool julia) {
+        ShaderDefines defines;
+        if (!onGpu) defines["IMAGE"] = "";
+        if (julia) defines["JULIA"] = "";
+        return defines;
+    }
+
+    FractalView viewAt(double steps) const {
+        /* half the view's height shrinks by zoomStep a step, and each halving gets another 60 iterations */
+        FractalView view = start;
+        view.scale = start.scale * pow(zoomStep, -steps);
+        view.maxIterations = start.maxIterations + (unsigned int)(60.0 * log2(start.scale / view.scale));
+        return view;
+    }
+
+    double zoomLimit(double epsilon) const {
+        /* how far in a pixel of a 1080 row screen is still 4 of the smallest steps the numbers can take at the centre */
+        double centre = max(fabs(start.centreX), fabs(start.centreY));
+        return 2.0 * start.scale / (1080.0 * 4.0 * epsilon * centre);
+    }
+
+public:
+    FractalScene(const SceneContext &context)
+        : jobs(context.jobs),
+          /* --fractal-path=gpu|cpu picks where it is worked out, --fractal=mandelbrot|julia which fractal */
+          onGpu(context.option("fractal-path", "gpu") != "cpu"),
+          shader(context.shaders.get("shaders/fullscreenVertexShader.txt", "shaders/fractalFragmentShader.txt",
+                                     defines(onGpu, context.option("fractal", "mandelbrot") == "julia"))),
+          /* --zoom-seconds and --zoom-step set how long each step takes and how much it zooms, --fractal-budget the CPU path's ms a frame */
+          stepSeconds(max(0.05, stod(context.option("zoom-seconds", "1")))), zoomStep(max(1.01, stod(context.option("zoom-step", "1.25")))),
+          budgetMs(max(0.0, stod(context.option("fractal-budget", "8")))) {
+        start.julia = context.option("fractal", "mandelbrot") == "julia";
+        if (start.julia) {
+            /* a point on the edge of the Julia set, in among its spirals */
+            start.centreX = 0.78427;
+            start.centreY = 0.205875;
+        } else {
+            /* seahorse valley, to every digit a double holds so the CPU path still lands on the edge a trillion times in */
+            start.centreX = -0.743643887037158704752;
+            start.centreY = 0.131825904205311970493;
+        }
+        start.scale = 1.5;
+        start.maxIterations = 150;
+        double limit = onGpu ? zoomLimit(numeric_limits<float>::epsilon()) : zoomLimit(numeric_limits<double>::epsilon());
+        cycleSteps = max(1.0, floor(log(limit) / log(zoomStep)));
+
+        glGenVertexArrays(1, &emptyVAO);
+        shader.use();
+        shader.setVec2("uvScale", glm::vec2(1.0f));
+        if (onGpu) {
+            shader.setVec2("centre", glm::vec2((float)start.centreX, (float)start.centreY));
+            if (start.julia) shader.setVec2("juliaC", glm::vec2(start.juliaX, start.juliaY));
+        } else {
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            shader.setInt("image", 0);
+        }
+    }
+
+    void update(double time, float dt) override {
+        /* by the clock rather than the frame, so --zoom-seconds is seconds however fast the frames come */
+        depth = fmod(depth + dt / stepSeconds, cycleSteps);
+    }
+
+    void draw(int width, int height) override {
+        shader.use();
+        if (onGpu) {
+            FractalView view = viewAt(depth);
+            shader.setFloat("scale", (float)view.scale);
+            shader.setFloat("aspect", (float)width / max(height, 1));
+            shader.setInt("maxIterations", (int)view.maxIterations);
+        } else {
+            /* a new step, or a new size, starts a new image */
+            long long step = (long long)depth;
+            glBindTexture(GL_TEXTURE_2D, texture);
+            if (step != imageStep || width != imageWidth || height != imageHeight) {
+                if (width != imageWidth || height != imageHeight) {
+                    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, max(width, 1), max(height, 1), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                }
+                if (imageStep >= 0 && !image.finished()) stepsAbandoned ++; // the CPU couldn't keep up
+                image.begin(viewAt((double)step), width, height);
+                imageStep = step;
+                imageWidth = width;
+                imageHeight = height;
+            }
+
+            bool changed;
+            {
+                ScopedStage stage(refineTimer);
+                changed = image.refine(&jobs, budgetMs);
+            }
+            if (changed) {
+                framesRefining ++;
+                if (image.finished()) stepsFinished ++;
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.getWidth(), image.getHeight(), GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+            }
+            shader.setFloat("magnify", (float)pow(zoomStep, depth - step));
+        }
+
+        glDisable(GL_DEPTH_TEST); // every pixel is drawn once
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    void report() override {
+        FractalView view = viewAt(depth);
+        cout << "  fractal: " << (start.julia ? "Julia" : "Mandelbrot") << " on the " << (onGpu ? "GPU" : "CPU") << ", zoom " << start.scale / view.scale
+             << "x of " << pow(zoomStep, cycleSteps) << "x, " << view.maxIterations << " iterations";
+        if (!onGpu) {
+            cout << ", refine " << refineTimer.averageMs() << " ms/frame (" << jobs.threads() << " threads), " << stepsFinished << " steps finished";
+            if (stepsFinished) cout << " in " << (double)framesRefining / stepsFinished << " frames each";
+            cout << ", " << stepsAbandoned << " abandoned";
+        }
+        cout << endl;
+        refineTimer.reset();
+        stepsFinished = stepsAbandoned = framesRefining = 0;
+    }
+
+    void del() override {
+        if (texture) glDeleteTextures(1, &texture);
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include "shader.h" // glad is included here
+
+/* Measures how long the GPU spends on a stretch of commands, using GL_TIME_ELAPSED queries.
+Results arrive a few frames late, so several queries are kept in flight and read back only once available,
+which means timing never stalls the pipeline. */
+class GpuTimer {
+    static const int latency = 4; // queries in flight
+    unsigned int queries[latency];
+
+    unsigned int issued = 0, read = 0;
+    bool skipping = false; // every query is in flight, so this frame goes untimed
+    double lastMs = 0.0;
+
+public:
+    GpuTimer() {
+        glGenQueries(latency, queries);
+    }
+
+    void begin() {
+        if (issued - read == latency) {
+            skipping = true;
+            return;
+        }
+        glBeginQuery(GL_TIME_ELAPSED, queries[issued % latency]);
+    }
+    void end() {
+        if (skipping) {
+            skipping = false;
+            return;
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+        issued ++;
+    }
+
+    bool poll() {
+        /* reads back every finished query, returns true if there was a new result */
+        bool got = false;
+        while (read < issued) {
+            int available = 0;
+            glGetQueryObjectiv(queries[read % latency], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) break;
+
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(queries[read % latency], GL_QUERY_RESULT, &ns);
+            lastMs = ns / 1e6;
+            read ++;
+            got = true;
+        }
+        return got;
+    }
+    double ms() const { return lastMs; } // the most recent result
+
+    void del() {
+        glDeleteQueries(latency, queries);
+    }
+};
+
+#endif
@@ -1,2 +1,6 @@
 #define STB_IMAGE_IMPLEMENTATION
+/* stb_image only uses its NEON JPEG decoder if asked, its SSE2 one is on by default */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define STBI_NEON
+#endif
 #include "stb_image.h"
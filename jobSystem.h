@@ -0,0 +1,193 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/* A work-stealing job scheduler, created once by main and shared by everything that wants more than one core.
+Every thread owns a deque of jobs: it pushes and pops its own at the back,
+and when it runs dry it steals the oldest (usually the biggest) job from the front of another's.
+Threads outside the system (eg. the simulation thread) submit to a shared deque everyone steals from. */
+class JobSystem {
+public:
+    using Job = function<void()>;
+
+    /* Counts the jobs of one fork/join group still to finish */
+    struct Counter {
+        atomic<int> pending{0};
+    };
+
+private:
+    struct Task {
+        Job job;
+        Counter* counter;
+    };
+    struct Queue {
+        mutex lock;
+        deque<Task> tasks;
+    };
+
+    vector<unique_ptr<Queue>> queues; // one per thread, plus the shared one at the end
+    vector<thread> workers;
+
+    atomic<bool> running{true};
+    atomic<int> queued{0}; // tasks waiting in any queue, so idle workers know when to wake
+    mutex sleepLock;
+    condition_variable wake;
+
+    /* which of our queues the current thread owns, -1 for threads outside the system */
+    static inline thread_local JobSystem* localSystem = nullptr;
+    static inline thread_local int localIndex = -1;
+
+    int self() const { return localSystem == this ? localIndex : -1; }
+    Queue& sharedQueue() { return *queues.back(); }
+
+    bool popOwn(int index, Task &task) {
+        Queue &queue = *queues[index];
+        lock_guard<mutex> guard(queue.lock);
+        if (queue.tasks.empty()) return false;
+
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+    bool stealFrom(Queue &queue, Task &task) {
+        lock_guard<mutex> guard(queue.lock);
+        if (queue.tasks.empty()) return false;
+
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+    bool steal(int thief, Task &task) {
+        /* start with the shared queue, then try every other thread's, beginning with our neighbour */
+        if (stealFrom(sharedQueue(), task)) return true;
+
+        int numThreads = (int)queues.size() - 1;
+        int start = thief < 0 ? 0 : thief + 1;
+        for (int i = 0; i < numThreads; i++) {
+            int victim = (start + i) % numThreads;
+            if (victim != thief && stealFrom(*queues[victim], task)) return true;
+        }
+        return false;
+    }
+    bool runOne(int index) {
+        /* runs a single job if one can be found, returns false if there was no work anywhere */
+        Task task;
+        if (!(index >= 0 && popOwn(index, task)) && !steal(index, task)) return false;
+
+        queued.fetch_sub(1, memory_order_relaxed);
+        task.job();
+        task.counter->pending.fetch_sub(1, memory_order_release);
+        return true;
+    }
+    void workerLoop(int index) {
+        localSystem = this;
+        localIndex = index;
+
+        while (running.load(memory_order_relaxed)) {
+            if (runOne(index)) continue;
+
+            unique_lock<mutex> lock(sleepLock);
+            wake.wait(lock, [this] { return queued.load(memory_order_relaxed) > 0 || !running.load(memory_order_relaxed); });
+        }
+    }
+
+    template <typename F>
+    void splitFor(Counter &counter, size_t begin, size_t end, size_t grain, const F &fn) {
+        /* hand the top half to another job until what is left fits in a grain */
+        while (end - begin > grain) {
+            size_t mid = begin + (end - begin) / 2;
+            spawn(counter, [this, &counter, mid, end, grain, &fn] { splitFor(counter, mid, end, grain, fn); });
+            end = mid;
+        }
+        fn(begin, end);
+    }
+
+public:
+    JobSystem(unsigned int numThreads = 0) {
+        /* numThreads counts the calling thread, which becomes thread 0. 0 uses every core */
+        if (numThreads == 0) numThreads = max(1u, thread::hardware_concurrency());
+
+        for (unsigned int i = 0; i <= numThreads; i++) queues.push_back(make_unique<Queue>());
+
+        localSystem = this;
+        localIndex = 0;
+        for (unsigned int i = 1; i < numThreads; i++) {
+            workers.emplace_back(&JobSystem::workerLoop, this, (int)i);
+        }
+    }
+    ~JobSystem() {
+        {
+            lock_guard<mutex> guard(sleepLock);
+            running = false;
+        }
+        wake.notify_all();
+        for (thread &worker: workers) worker.join();
+
+        if (localSystem == this) localSystem = nullptr;
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    unsigned int threads() const { return (unsigned int)workers.size() + 1; }
+
+    void spawn(Counter &counter, Job job) {
+        /* queue a job as part of counter's group, wait(counter) joins the group */
+        counter.pending.fetch_add(1, memory_order_relaxed);
+
+        int index = self();
+        Queue &queue = index >= 0 ? *queues[index] : sharedQueue();
+        {
+            lock_guard<mutex> guard(queue.lock);
+            queue.tasks.push_back({std::move(job), &counter});
+        }
+
+        queued.fetch_add(1, memory_order_relaxed);
+        { lock_guard<mutex> guard(sleepLock); } // a worker about to sleep will now see queued > 0
+        wake.notify_one();
+    }
+
+    void wait(Counter &counter) {
+        /* run jobs (ours first) until every job in the group has finished */
+        int index = self();
+        while (counter.pending.load(memory_order_acquire) > 0) {
+            if (!runOne(index)) this_thread::yield();
+        }
+    }
+
+    bool help() {
+        /* runs one queued job on the calling thread, if there is one, for threads waiting on something other than a counter */
+        return runOne(self());
+    }
+
+    template <typename F>
+    void parallelFor(size_t begin, size_t end, size_t grain, const F &fn) {
+        /* calls fn(first, last) over [begin, end) in chunks of at most grain, and returns once all are done */
+        if (begin >= end) return;
+        grain = max(grain, (size_t)1);
+
+        Counter counter;
+        splitFor(counter, begin, end, grain, fn);
+        wait(counter);
+    }
+};
+
+/* Runs fn over [begin, end) on jobs if there is a job system, otherwise inline */
+template <typename F>
+void parallelFor(JobSystem* jobs, size_t begin, size_t end, size_t grain, const F &fn) {
+    if (jobs) jobs->parallelFor(begin, end, grain, fn);
+    else if (begin < end) fn(begin, end);
+}
+
+#endif
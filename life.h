@@ -0,0 +1,140 @@
+#ifndef LIFE_H
+#define LIFE_H
+
+#include "jobSystem.h"
+#include "simd.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+/* The same loads, stores and shifts for a plain 64 bit word as simd.h has for bits128, so one step of Life can be written for either */
+template <typename W> inline W loadWords(const uint64_t* p);
+template <> inline uint64_t loadWords<uint64_t>(const uint64_t* p) { return *p; }
+template <> inline bits128 loadWords<bits128>(const uint64_t* p) { return loadBits(p); }
+inline void storeWords(uint64_t* p, uint64_t a) { *p = a; }
+inline void storeWords(uint64_t* p, bits128 a) { storeBits(p, a); }
+template <int n> inline uint64_t shiftLeft(uint64_t a) { return a << n; }
+template <int n> inline uint64_t shiftRight(uint64_t a) { return a >> n; }
+
+/* Whether each cell of c lives on, given its eight neighbours a bit each, for every bit at once.
+The neighbours are added up bitwise with full adders, keeping the count mod 8, which is all the rules need:
+it lives with 3, or with 2 if it already is. Eight neighbours wraps to 0 and dies as it should */
+template <typename W>
+inline W lifeRule(W nw, W n, W ne, W w, W c, W e, W sw, W s, W se) {
+    W aboveSum = nw ^ n ^ ne, aboveCarry = (nw & n) | (ne & (nw ^ n));
+    W belowSum = sw ^ s ^ se, belowCarry = (sw & s) | (se & (sw ^ s));
+    W sideSum = w ^ e, sideCarry = w & e;
+
+    /* the ones, and the carries into the twos */
+    W ones = aboveSum ^ belowSum ^ sideSum, onesCarry = (aboveSum & belowSum) | (sideSum & (aboveSum ^ belowSum));
+
+    /* four bits of weight 2 make the twos and the fours */
+    W pairs = aboveCarry ^ belowCarry ^ sideCarry, pairsCarry = (aboveCarry & belowCarry) | (sideCarry & (aboveCarry ^ belowCarry));
+    W twos = pairs ^ onesCarry, fours = pairsCarry ^ (pairs & onesCarry);
+
+    return twos & ~fours & (ones | c);
+}
+
+/* Conway's Life on a torus, a bit per cell. Cell x of a row is bit x % 64 of word x / 64, so the rows can go straight to a texture.
+Each row keeps a copy of its last word before its first and of its first after its last, so the neighbours across the wrap
+are read like any others. A generation is worked out into a second grid in bands of rows over the job system, each row
+128 cells at a time in a bits128: its words and those above and below, shifted a bit either way with the bits carried in
+from the neighbouring words, go through lifeRule as 9 bit planes. */
+class LifeGrid {
+    int width, height, words; // words per row
+    size_t stride; // words per row with the copies at either end
+    vector<uint64_t> grids[2];
+    int current = 0;
+    uint64_t generations = 0;
+
+    static const int bandRows = 32;
+
+    template <typename W>
+    static W stepWords(const uint64_t* above, const uint64_t* row, const uint64_t* below) {
+        /* the next generation of the words at row, from theirs and their neighbours' */
+        auto westOf = [](const uint64_t* p) { return shiftLeft<1>(loadWords<W>(p)) | shiftRight<63>(loadWords<W>(p - 1)); };
+        auto eastOf = [](const uint64_t* p) { return shiftRight<1>(loadWords<W>(p)) | shiftLeft<63>(loadWords<W>(p + 1)); };
+        return lifeRule(westOf(above), loadWords<W>(above), eastOf(above), westOf(row), loadWords<W>(row), eastOf(row),
+                        westOf(below), loadWords<W>(below), eastOf(below));
+    }
+
+    template <typename W>
+    void stepRow(const uint64_t* above, const uint64_t* row, const uint64_t* below, uint64_t* out) const {
+        const int lanes = sizeof(W) / sizeof(uint64_t);
+        int i = 1;
+        for (; i + lanes <= words + 1; i += lanes) storeWords(out + i, stepWords<W>(above + i, row + i, below + i));
+        for (; i <= words; i++) out[i] = stepWords<uint64_t>(above + i, row + i, below + i);
+        out[0] = out[words];
+        out[words + 1] = out[1];
+    }
+
+    uint64_t* rowOf(int grid, int y) { return &grids[grid][(size_t)y * stride]; }
+
+public:
+    /* width is rounded up to a whole number of words */
+    LifeGrid(int widthIn, int heightIn)
+        : width((max(widthIn, 64) + 63) / 64 * 64), height(max(heightIn, 3)), words(width / 64), stride(words + 2) {
+        grids[0].assign(stride * height, 0);
+        grids[1].assign(stride * height, 0);
+    }
+
+    void randomize(int x, int y, int sizeX, int sizeY, uint64_t seed) {
+        /* fills the cells from (x, y), sizeX wide (rounded out to words) and sizeY high, wrapping, 3 in 8 alive */
+        uint64_t state = seed * 0x9E3779B97F4A7C15ull + 1;
+        auto random = [&state] {
+            state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+            return state;
+        };
+        int firstWord = x / 64, lastWord = (x + sizeX + 63) / 64;
+        for (int j = 0; j < sizeY; j++) {
+            uint64_t* row = rowOf(current, ((y + j) % height + height) % height);
+            for (int i = firstWord; i < lastWord; i++) row[1 + (i % words + words) % words] = random() & (random() | random());
+            row[0] = row[words];
+            row[words + 1] = row[1];
+        }
+    }
+
+    void step(JobSystem* jobs, bool vectorize = true) {
+        /* one generation, vectorize = false a word at a time to measure against */
+        int next = 1 - current;
+        size_t bands = (height + bandRows - 1) / bandRows;
+        parallelFor(jobs, 0, bands, 1, [&](size_t first, size_t last) {
+            for (size_t band = first; band < last; band++) {
+                int end = min((int)(band + 1) * bandRows, height);
+                for (int y = (int)band * bandRows; y < end; y++) {
+                    const uint64_t* above = rowOf(current, (y + height - 1) % height);
+                    const uint64_t* row = rowOf(current, y);
+                    const uint64_t* below = rowOf(current, (y + 1) % height);
+                    if (vectorize) stepRow<bits128>(above, row, below, rowOf(next, y));
+                    else stepRow<uint64_t>(above, row, below, rowOf(next, y));
+                }
+            }
+        });
+        current = next;
+        generations ++;
+    }
+
+    uint64_t population() const {
+        uint64_t alive = 0;
+        for (int y = 0; y < height; y++) {
+            const uint64_t* row = &grids[current][(size_t)y * stride];
+            for (int i = 1; i <= words; i++) alive += popcount(row[i]);
+        }
+        return alive;
+    }
+
+    bool alive(int x, int y) const { return (grids[current][(size_t)y * stride + 1 + x / 64] >> (x % 64)) & 1; }
+
+    /* the rows, each rowStride words with the copies at either end, so a row's cells start a word in */
+    const uint64_t* data() const { return grids[current].data(); }
+    size_t rowStride() const { return stride; }
+    size_t bytes() const { return grids[current].size() * sizeof(uint64_t); }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    uint64_t generation() const { return generations; }
+};
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef LIFE_SCENE_H
+#define LIFE_SCENE_H
+
+#include "scene.h"
+#include "life.h"
+#include "timing.h"
+#include <cstring>
+#include <iostream>
+#include <math.h>
+
+using namespace std;
+
+/* ---------------------------- Life scene ---------------------------- */
+/* Conway's Life on a large torus (see LifeGrid), seen through a window that drifts across it, with a fresh patch of soup dropped in now and then
+so it never settles into still life.
+
+The grid goes to the GPU as it is, a bit per cell, in a single channel R32UI texture: each frame it is copied into an orphaned pixel buffer,
+like the slideshow's, and the texture filled from that, skipping the copied words at either end of each row with GL_UNPACK_SKIP_PIXELS.
+A full-screen triangle then looks up the bit under each pixel. */
+class LifeScene : public Scene {
+    JobSystem &jobs;
+    Shader &shader;
+    LifeGrid grid;
+    FixedStep clock; // a generation per step
+    uint64_t generationsRun = 0; // since the last report
+    bool uploaded = false;
+    float pixelsPerCell;
+    glm::vec2 origin = glm::vec2(0.0f);
+    uint64_t sprinkles = 0;
+
+    unsigned int texture, pixelBuffer;
+    unsigned int emptyVAO; // the full-screen triangle comes from gl_VertexID
+
+    StageTimer stepTimer, uploadTimer;
+
+    static const unsigned int sprinkleGenerations = 120; // how often a patch of soup is dropped in
+    static const int sprinkleSize = 256;
+    static constexpr float driftX = 30.0f, driftY = 18.0f; // cells per second the window drifts
+
+    static FixedStep generationClock(const SceneContext &context) {
+        /* --life-rate=<n> sets the generations a second, and a frame runs at most a fifteenth of a second's */
+        double rate = max(1.0, stod(context.option("life-rate", "60")));
+        return FixedStep(1.0 / rate, (unsigned int)max(1.0, ceil(rate / 15.0)));
+    }
+
+public:
+    LifeScene(const SceneContext &context)
+        : jobs(context.jobs), shader(context.shaders.get("shaders/fullscreenVertexShader.txt", "shaders/lifeFragmentShader.txt")),
+          /* --life-size=<cells> is the torus' width and height */
+          grid(max(64, stoi(context.option("life-size", "8192"))), max(64, stoi(context.option("life-size", "8192")))),
+          clock(generationClock(context)),
+          /* --life-zoom=<pixels> sets how big a cell is */
+          pixelsPerCell(max(0.1f, stof(context.option("life-zoom", "2")))) {
+        grid.randomize(0, 0, grid.getWidth(), grid.getHeight(), 1);
+
+        glGenVertexArrays(1, &emptyVAO);
+        glGenBuffers(1, &pixelBuffer);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, grid.getWidth() / 32, grid.getHeight(), 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); // integer textures can't be filtered
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        shader.use();
+        shader.setVec2("uvScale", glm::vec2(1.0f));
+        shader.setInt("cells", 0);
+        glUniform2i(glGetUniformLocation(shader.ID, "gridSize"), grid.getWidth(), grid.getHeight());
+        shader.setFloat("pixelsPerCell", pixelsPerCell);
+    }
+
+    void update(double time, float dt) override {
+        /* the generations and the drift both go by the clock, so the scene runs at the same speed whatever the frame rate */
+        origin += glm::vec2(driftX, driftY) * dt;
+        origin = glm::mod(origin, glm::vec2(grid.getWidth(), grid.getHeight()));
+
+        unsigned int generations = clock.due(dt);
+        if (!generations && uploaded) return; // the texture still holds the last generation
+        uploaded = true;
+        generationsRun += generations;
+        {
+            ScopedStage stage(stepTimer);
+            for (unsigned int i = 0; i < generations; i++) {
+                if (grid.generation() % sprinkleGenerations == sprinkleGenerations - 1) {
+                    sprinkles ++;
+                    uint64_t where = sprinkles * 0x9E3779B97F4A7C15ull;
+                    grid.randomize((int)(where % grid.getWidth()), (int)((where >> 32) % grid.getHeight()), sprinkleSize, sprinkleSize, sprinkles + 1);
+                }
+                grid.step(&jobs);
+            }
+        }
+
+        /* orphan the buffer, so the copy never waits on the GPU reading the last one */
+        ScopedStage stage(uploadTimer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, grid.bytes(), nullptr, GL_STREAM_DRAW);
+        void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, grid.bytes(), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped) {
+            memcpy(mapped, grid.data(), grid.bytes());
+            if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+                glBindTexture(GL_TEXTURE_2D, texture);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, (GLint)grid.rowStride() * 2);
+                glPixelStorei(GL_UNPACK_SKIP_PIXELS, 2);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, grid.getWidth() / 32, grid.getHeight(), GL_RED_INTEGER, GL_UNSIGNED_INT, (void*)0);
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+                glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+            }
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    void draw(int width, int height) override {
+        glDisable(GL_DEPTH_TEST); // every pixel is drawn once
+        shader.use();
+        shader.setVec2("origin", origin);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    void report() override {
+        double cells = (double)grid.getWidth() * grid.getHeight() * generationsRun;
+        cout << "  life: " << grid.getWidth() << "x" << grid.getHeight() << ", generation " << grid.generation() << ", " << grid.population()
+             << " alive, step " << stepTimer.averageMs() << " ms/frame (" << cells / max(stepTimer.totalMs() * 1e6, 1e-9) << " G cell updates/s, "
+             << jobs.threads() << " threads), upload " << uploadTimer.averageMs() << " ms/frame (" << grid.bytes() / 1e6 << " MB)" << endl;
+        stepTimer.reset(); uploadTimer.reset();
+        generationsRun = 0;
+    }
+
+    void del() override {
+        glDeleteTextures(1, &texture);
+        glDeleteBuffers(1, &pixelBuffer);
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+};
+
+#endif
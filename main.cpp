@@ -3,10 +3,22 @@
 
 #include "shader.h" // glad is included here
 #include "VAO.h"
+#include "sineCurve.h"
+#include "simulation.h"
+#include "timing.h"
+#include "jobSystem.h"
+#include "benchmarks.h"
+#include "dynamicResolution.h"
+#include "curveRenderers.h"
+#include "taskGraph.h"
+#include "options.h"
+#include "scenes.h"
+#include "audio.h"
 #include "stb_image_implementation.h" // for importing images
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include <math.h>
+#include <memory>
 #include <vector>
 
 using namespace std;
@@ -15,6 +27,10 @@ using namespace std;
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     glViewport(0, 0, width, height);
+
+    /* with dynamic resolution the offscreen target has to follow the window too */
+    DynamicResolution* dynamicResolution = (DynamicResolution*)glfwGetWindowUserPointer(window);
+    if (dynamicResolution) dynamicResolution->onResize(width, height);
 }  
 
 /* Process the user input (non-callback) */
@@ -72,143 +88,354 @@ GLFWwindow* buildWindow() {
     return window;
 }
 
-float* genSineCurve(unsigned int points, unsigned int &vertices) {
-    // returns a set of triangle vertices that span the area under a sine curve
-    const int rectangles = points  - 1;
-    const int triangles = rectangles * 2;
-    vertices = triangles * 3;
-    
-    const float x_width = 3.0f;
-
-    const int attributes = 3; 
-    const int x_stretch = 15; // factor we stretch the x-axis
-
-    float * vertexArray = new float[vertices * attributes];
-
-    for (int i = 0; i < rectangles; i ++) {
-        // our rectangle goes from (x_1, -1), (x_2, -1), (x_1, y_1), (x_2, y_2)
-        float x_1 = -x_width + 2.0f * x_width * i / points;
-        float x_2 = -x_width + 2.0f * x_width * (i + 1) / points;
-        float y_1 = sin(x_1 * x_stretch) / 5, y_2 = sin(x_2 * x_stretch) / 5;
-
-        // (x_1, -1), (x_2, -1), (x_1, y_1)
-        vertexArray[18*i] = x_1;
-        vertexArray[18*i + 1] = y_1;
-        vertexArray[18*i + 2] = 0.0f;
-
-        vertexArray[18*i + 3] = x_1;
-        vertexArray[18*i + 4] = -1.0f;
-        vertexArray[18*i + 5] = 0.0f;
-
-        vertexArray[18*i + 6] = x_2;
-        vertexArray[18*i + 7] = -1.0f;
-        vertexArray[18*i + 8] = 0.0f;
-
-        // (x_2, y_2), (x_1, y_1), (x_2, -1)
-        vertexArray[18*i + 9] = x_2;
-        vertexArray[18*i + 10] = y_2;
-        vertexArray[18*i + 11] = 0.0f;
-
-        vertexArray[18*i + 12] = x_1;
-        vertexArray[18*i + 13] = y_1;
-        vertexArray[18*i + 14] = 0.0f;
-        
-        vertexArray[18*i + 15] = x_2;
-        vertexArray[18*i + 16] = -1.0f;
-        vertexArray[18*i + 17] = 0.0f;
+/* Prints the average time of each stage, and how much the simulation and render threads overlapped */
+void reportStageTimings(Clock::duration wall, unsigned int frames, Simulation &simulation,
+                        StageTimer &input, StageTimer &render, StageTimer &swap) {
+    double wallMs = chrono::duration<double, milli>(wall).count();
+    double simBusy = simulation.stepTimer.totalMs() + simulation.publishTimer.totalMs();
+    double renderBusy = input.totalMs() + render.totalMs() + swap.totalMs();
+
+    cout << "Frame stages over " << frames << " frames (" << wallMs / frames << " ms/frame):" << endl;
+    cout << "  render thread: input " << input.averageMs() << " ms, draw " << render.averageMs() << " ms, swap " << swap.averageMs() << " ms" << endl;
+    cout << "  sim thread: " << simulation.stepTimer.count() << " steps, step " << simulation.stepTimer.averageMs()
+         << " ms, publish " << simulation.publishTimer.averageMs() << " ms, " << simulation.droppedPackets.exchange(0) << " packets never shown" << endl;
+    cout << "  busy: render " << 100.0 * renderBusy / wallMs << "%, sim " << 100.0 * simBusy / wallMs
+         << "%, overlapped " << 100.0 * max(0.0, renderBusy + simBusy - wallMs) / wallMs << "%" << endl;
+
+    input.reset(); render.reset(); swap.reset();
+    simulation.stepTimer.reset(); simulation.publishTimer.reset();
+}
+
+/* The render loop for every scene but the curves, which have their own below. Returns main's exit code */
+int runScene(GLFWwindow* window, Scene &scene, ShaderCache &shaders, Clock::time_point launch, const TaskGraph &startup, bool startupBench) {
+    StageTimer updateTimer, drawTimer, swapTimer;
+    Clock::time_point start = Clock::now(), last = start, reportStart = start;
+    unsigned int framesSinceReport = 0;
+    bool firstFrame = true;
+
+    while (!glfwWindowShouldClose(window))
+    {
+        processInput(window);
+
+        Clock::time_point now = Clock::now();
+        {
+            ScopedStage stage(updateTimer);
+            scene.update(msBetween(start, now) / 1000.0, (float)(msBetween(last, now) / 1000.0));
+        }
+        last = now;
+
+        {
+            ScopedStage stage(drawTimer);
+            int width, height;
+            glfwGetFramebufferSize(window, &width, &height);
+            scene.draw(width, height);
+        }
+
+        {
+            ScopedStage stage(swapTimer);
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+
+        if (firstFrame) {
+            firstFrame = false;
+            cout << "Time to first frame: " << msBetween(launch, Clock::now()) << " ms (startup tasks " << startup.totalMs() << " ms)" << endl;
+            if (startupBench) break;
+        }
+
+        /* Report where the time went every few seconds */
+        if (++framesSinceReport == 300) {
+            double wallMs = msBetween(reportStart, Clock::now());
+            cout << "Frame stages over " << framesSinceReport << " frames (" << wallMs / framesSinceReport << " ms/frame): update "
+                 << updateTimer.averageMs() << " ms, draw " << drawTimer.averageMs() << " ms, swap " << swapTimer.averageMs() << " ms" << endl;
+            scene.report();
+            updateTimer.reset(); drawTimer.reset(); swapTimer.reset();
+            reportStart = Clock::now();
+            framesSinceReport = 0;
+        }
     }
 
-    return vertexArray;
+    /* De-allocate memory */
+    scene.del();
+    shaders.del();
 
+    /* Terminate glfw */
+    glfwTerminate();
+    return 0;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
-    init(); // init glfw
+    Clock::time_point launch = Clock::now(); // for the time to first frame
 
-    GLFWwindow* window = buildWindow(); // build the window
+    /* --bench=<name> runs a benchmark instead of the screensaver, only opening a (hidden) window if it needs OpenGL.
+    --bench=startup is the exception: it runs the normal startup, reports the time to the first frame, and quits */
+    string bench = getOption(argc, argv, "bench", "");
+    bool startupBench = bench == "startup";
+    if (!bench.empty() && !startupBench) {
+        if (!benchNeedsContext(bench)) return runBenchmarks(bench, false, argc, argv);
 
-    glEnable(GL_DEPTH_TEST); // enable depth testing
+        init(); // init glfw
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        GLFWwindow* window = buildWindow(); // build the window
+        if (!window) return -1;
 
-    Shader myShader("shaders/vertexShader.txt", "shaders/fragmentShader.txt"); // build the shader program
+        int result = runBenchmarks(bench, true, argc, argv);
+        glfwTerminate();
+        return result;
+    }
 
-    /* Load the sine curve into a VAO */
+    /* Read the options first, so startup knows all of its work up front */
+    /* --budget=<ms> renders offscreen at whatever resolution holds the GPU to that frame time */
+    /* --upscale=sharpen|bilinear picks how the result is scaled back up to the window */
+    float budgetMs = stof(getOption(argc, argv, "budget", "0"));
     unsigned int samplePoints = 100000;
-    unsigned int numVertices;
-    float * sineCurve = genSineCurve(samplePoints, numVertices);
-    
-    unsigned int attributes[] = {3};
-    unsigned int stride = 3 * sizeof(float);
-    MyVAO myVao;
-    myVao.addData(sineCurve, numVertices, stride);
-    myVao.addAttrib(attributes, 1);
-
-    /* Define attributes for each sine curve */
-    struct Curve {
-        float colour = 0.0f;
-        float colorStep = 0.01f;
-        float speed = 0.01f;
-
-        glm::vec3 trans;
-        glm::vec3 transStep;
-
-        Curve (float pos) { 
-            speed = pos / 500;
-            transStep = glm::vec3(speed, speed, speed);
-            trans = glm::vec3(0.0f, -1 + 2.0f * pos, 1.0f * pos);
-        }
+    SineFormat format = parseSineFormat(getOption(argc, argv, "format", "float")); // --format=float|half|short|packed
+    string wave = getOption(argc, argv, "wave", "none"); // --wave=none|drift|ripple|both|spectral
+    /* --spectral-size=<n> is how many height samples --wave=spectral synthesises across the curve, the FFT size, a power of two.
+    It sets how finely the waves are sampled, not how many there are */
+    unsigned int spectralSize = wave == "spectral" ? (unsigned int)stoul(getOption(argc, argv, "spectral-size", "2048")) : 0;
+    if (spectralSize && (!FFT::isPowerOfTwo(spectralSize) || spectralSize < 16)) {
+        cout << "--spectral-size must be a power of two of at least 16" << endl;
+        return -1;
+    }
+    SineWaveAnimator waveAnimator(wave == "drift" || wave == "both", wave == "ripple" || wave == "both", spectralSize);
+    /* --renderer=mesh|batched|analytic picks how the curves are drawn, see --bench=curves for which suits the device */
+    CurveRendererType rendererType = parseCurveRenderer(getOption(argc, argv, "renderer", "mesh"));
+    if (rendererType == CurveRendererType::Analytic && wave != "none" && wave != "drift") cout << "The analytic renderer only follows --wave=drift" << endl;
+    /* --overdraw shows how often each pixel is drawn by the mesh renderers instead of the curves' colours */
+    bool overdraw = getOption(argc, argv, "overdraw", "off") == "on";
+    /* --scene=curves|ocean|strings|slideshow|boids|starfield|metaballs|fractal|life|fluid picks what the screensaver shows */
+    string sceneName = getOption(argc, argv, "scene", "curves");
+    bool curves = sceneName == "curves";
+    const int numCurves = 9;
 
-        void step() {
-            // update the step
-            if (((trans.x > 1) && (transStep.x > 0)) || ((trans.x < -1) && (transStep.x < 0))) {
-                transStep.x = -transStep.x;
-            } 
+    /* --audio=<file.wav> pulses the curves with the music, a band each, --audio-fft=<n> is the analysis' FFT size, a power of two */
+    unique_ptr<AudioAnalysis> audio;
+    string audioPath = curves ? getOption(argc, argv, "audio", "") : "";
+    if (!audioPath.empty()) {
+        unsigned int audioFFTSize = (unsigned int)stoul(getOption(argc, argv, "audio-fft", "2048"));
+        if (!FFT::isPowerOfTwo(audioFFTSize) || audioFFTSize < 64) {
+            cout << "--audio-fft must be a power of two of at least 64" << endl;
+            return -1;
+        }
+        audio = make_unique<AudioAnalysis>();
+        if (!audio->open(audioPath, numCurves, audioFFTSize)) {
+            cout << "Couldn't read " << audioPath << " as a WAV file" << endl;
+            return -1;
+        }
+        cout << "Audio: " << audioPath << ", " << audio->seconds() << " s at " << audio->sampleRate() << " Hz" << endl;
+    }
 
-            // make the step
-            trans.x += transStep.x;
+    JobSystem jobs; // shared by everything that can use more than one core
+
+    GLFWwindow* window = nullptr;
+    ShaderCache shaders; // programs are built the first time something asks for them
+    unique_ptr<DynamicResolution> dynamicResolution;
+
+    ScratchArena staging; // CPU-side geometry only lives here until it is uploaded
+    ScratchArena meshMemory; // an animated wave keeps its CPU copy here, to regenerate parts of it
+    ScratchArena::Marker stagingStart = staging.mark();
+    SineMesh sineCurve;
+    vector<SineChunk> sineChunks;
+    unique_ptr<MyVAO> myVao; // needs the context, so it is made by the upload task
+    unique_ptr<MeshBatch> batch;
+
+    unique_ptr<MeshCurves> meshCurves;
+    unique_ptr<BatchedCurves> batchedCurves;
+    unique_ptr<AnalyticCurves> analyticCurves;
+    unique_ptr<Scene> scene;
+
+    /* ---------------------------- Startup ---------------------------- */
+    /* The window, the mesh and the shader files don't depend on each other, so they are made at the same time,
+    and each GL step runs on this thread as soon as what it needs is ready */
+    using Thread = TaskGraph::Thread;
+    TaskGraph startup;
+
+    unsigned int windowTask = startup.add("window", Thread::Main, {}, [&] {
+        init(); // init glfw
+        window = buildWindow(); // build the window
+        if (!window) return false;
+
+        glEnable(GL_DEPTH_TEST); // enable depth testing
+        /* --shader-cache=<dir> also keeps the programs on disk between runs */
+        shaders.useDisk((GLADloadproc)glfwGetProcAddress, getOption(argc, argv, "shader-cache", ""));
+        return true;
+    });
+
+    if (curves) {
+        unsigned int shaderFilesTask = startup.add("shader files", Thread::Worker, {}, [&] {
+            preloadCurveShaders(shaders, rendererType, overdraw);
+            return true;
+        });
+
+        /* the analytic renderer works the curves out in its fragment shader, so only the mesh renderers need the mesh */
+        bool needsMesh = rendererType != CurveRendererType::Analytic;
+        vector<unsigned int> renderersNeed = {windowTask, shaderFilesTask};
+        if (needsMesh) {
+            unsigned int meshTask = startup.add("sine mesh", Thread::Worker, {}, [&] {
+                /* an animated wave keeps its CPU copy to regenerate parts of it, otherwise it only lives until it is uploaded */
+                sineCurve = genSineCurvePacked(samplePoints, format, waveAnimator.animated() ? meshMemory : staging, &jobs);
+                sineChunks = chunkSineMesh(sineCurve);
+                return true;
+            });
+
+            renderersNeed.push_back(startup.add("mesh upload", Thread::Main, {windowTask, meshTask}, [&] {
+                GLenum usage = waveAnimator.animated() ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW;
+                if (rendererType == CurveRendererType::Batched) {
+                    /* the sine mesh is the batch's first mesh, so the wave animator can stream into the batch's VAO as usual */
+                    batch = make_unique<MeshBatch>(sineCurve.stride, (GLADloadproc)glfwGetProcAddress);
+                    batch->addMesh(sineCurve.data, sineCurve.numVertices);
+                    batch->build([&] { applySineLayout(sineCurve.format); }, usage);
+                } else {
+                    myVao = make_unique<MyVAO>();
+                    uploadSineMesh(*myVao, sineCurve, usage);
+                }
+
+                if (!waveAnimator.animated()) {
+                    /* the GPU has its own copy now, so the staging memory is rewound */
+                    staging.reset(stagingStart);
+                    sineCurve.data = nullptr;
+                }
+                return true;
+            }));
         }
-    };
-    const int numCurves = 9;
-    vector<Curve> curves;
-    for (int i = 0; i < numCurves; i ++) {
-        Curve c((float)i / numCurves);
 
-        curves.emplace_back(c);
+        startup.add("renderers", Thread::Main, renderersNeed, [&] {
+            if (rendererType == CurveRendererType::Mesh) meshCurves = make_unique<MeshCurves>(shaders, *myVao, sineCurve.scale, sineChunks, overdraw);
+            if (batch) batchedCurves = make_unique<BatchedCurves>(shaders, *batch, 0, sineCurve.scale, sineChunks, overdraw);
+            if (rendererType == CurveRendererType::Analytic) analyticCurves = make_unique<AnalyticCurves>(shaders);
+            return true;
+        });
+
+        startup.add("dynamic res", Thread::Main, {windowTask}, [&] {
+            if (budgetMs <= 0.0f) return true;
+            int width, height;
+            glfwGetFramebufferSize(window, &width, &height);
+            dynamicResolution = make_unique<DynamicResolution>(width, height, budgetMs, getOption(argc, argv, "upscale", "sharpen") == "sharpen");
+            glfwSetWindowUserPointer(window, dynamicResolution.get());
+            return true;
+        });
+    } else {
+        startup.add("scene", Thread::Main, {windowTask}, [&] {
+            scene = makeScene(sceneName, SceneContext{jobs, shaders, argc, argv});
+            if (!scene) cout << "Unknown scene " << sceneName << endl;
+            return scene != nullptr;
+        });
     }
 
+    /* --startup=serial runs the same tasks one after another, to compare against */
+    bool startupOk = startup.run(&jobs, getOption(argc, argv, "startup", "parallel") == "serial");
+    if (startupBench || !startupOk) startup.report();
+    if (!startupOk) return -1;
+    if (scene) return runScene(window, *scene, shaders, launch, startup, startupBench);
+
+    reportStagingMemory(staging);
+    if (!waveAnimator.animated()) staging.release(); // nothing will be regenerated, so give the blocks back
+    MyVAO* meshVao = batch ? &batch->getVAO() : myVao.get(); // null for the analytic renderer, which has no mesh
+    if (batch) cout << "Batched curves drawn with " << (batch->indirect() ? "one glMultiDrawArraysIndirect per frame" : "one glMultiDrawArrays per curve (no GL 4.3)") << endl;
+    cout << "Shaders: " << shaders.compiled() << " compiled, " << shaders.loadedFromDisk() << " loaded from disk" << endl;
+
+    /* Step the curves on their own thread */
+    Simulation simulation(numCurves, &jobs);
+    FramePacket frame = simulation.first();
+    if (meshVao) reportSineMemory(sineCurve, format, samplePoints, numCurves);
+
+    /* Time each stage on both threads, to see how much they overlap */
+    StageTimer inputTimer, renderTimer, swapTimer;
+    Clock::time_point reportStart = Clock::now();
+    unsigned int framesSinceReport = 0;
+    bool firstFrame = true;
+
+    simulation.start();
+    AudioBands audioBands; // the newest levels, kept for the frames between hops
+    if (audio) audio->start();
+
     /* ---------------------------- Render Loop ---------------------------- */
     while (!glfwWindowShouldClose(window))
     {
         /* Handle user input */
-        processInput(window);
-
-        /* Clear the colour buffer with dark turqoise */
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f); // (state setting)
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // (state using)
+        FramePacket shown; // what is drawn: the newest curves, pulsed with the music
+        {
+            ScopedStage stage(inputTimer);
+            processInput(window);
+            simulation.latest(frame); // take the newest curve positions, frame is kept as it is for frames with no new packet
+            shown = frame;
+            if (audio) {
+                audio->latest(audioBands);
+                pulseCurves(shown, audioBands);
+            }
+        }
 
-        /* Create the transformation matrix */
-        myShader.use();
-        for (Curve &curve: curves) {
-            glm::mat4 transform = glm::translate(glm::mat4(1.0f), curve.trans);
+        {
+            ScopedStage stage(renderTimer);
+
+            /* Draw into the scaled offscreen target rather than the window */
+            if (dynamicResolution) dynamicResolution->beginFrame();
+
+            /* Clear the colour buffer with dark turqoise */
+            if (overdraw && !analyticCurves) glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // black, so the overdraw shows
+            else glClearColor(1.0f, 1.0f, 1.0f, 1.0f); // (state setting)
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // (state using)
+
+            if (analyticCurves) {
+                /* the analytic pass follows the phase drift, but not the ripple or spectral waves */
+                waveAnimator.advancePhase();
+                analyticCurves->draw(shown, waveAnimator.getShape().phase);
+            } else {
+                /* Regenerate and upload whatever part of the wave changed shape */
+                if (waveAnimator.animated()) waveAnimator.step(sineCurve, *meshVao, staging, &jobs);
+                if (batchedCurves) batchedCurves->draw(shown);
+                else meshCurves->draw(shown);
+            }
+
+            if (dynamicResolution) dynamicResolution->endFrame();
+        }
 
-            myShader.setMat4("transform", transform);
-            myShader.setFloat("color", curve.colour);
+        {
+            ScopedStage stage(swapTimer);
 
-            curve.step();
+            /* Swap front and back buffers */
+            glfwSwapBuffers(window);
 
-            myVao.draw();
+            /* Poll for and process events */
+            glfwPollEvents();
         }
+        if (audio) audio->shown(audioBands, Clock::now());
 
-        /* Swap front and back buffers */
-        glfwSwapBuffers(window);
+        /* The first frame is on screen, so startup is over */
+        if (firstFrame) {
+            firstFrame = false;
+            cout << "Time to first frame: " << msBetween(launch, Clock::now()) << " ms (startup tasks " << startup.totalMs() << " ms)" << endl;
+            if (startupBench) break;
+        }
 
-        /* Poll for and process events */
-        glfwPollEvents();
+        /* Report where the time went every few seconds */
+        if (++framesSinceReport == 300) {
+            reportStageTimings(Clock::now() - reportStart, framesSinceReport, simulation, inputTimer, renderTimer, swapTimer);
+            if (meshCurves) cout << "  mesh: " << 100.0 * meshCurves->drawnFraction() << "% of vertices submitted after viewport culling" << endl;
+            if (dynamicResolution) {
+                cout << "  resolution scale " << dynamicResolution->getScale() << ", scene GPU time " << dynamicResolution->gpuMs() << " ms (budget " << budgetMs << " ms)" << endl;
+            }
+            if (audio) audio->report();
+            reportStart = Clock::now();
+            framesSinceReport = 0;
+        }
     }
+    simulation.stop();
+    if (audio) audio->stop();
 
     /* De-allocate memory */
-    myVao.del();
-    myShader.del();
+    if (myVao) myVao->del();
+    if (meshCurves) meshCurves->del();
+    if (analyticCurves) analyticCurves->del();
+    if (batchedCurves) batchedCurves->del();
+    if (batch) batch->del();
+    shaders.del();
+    if (dynamicResolution) {
+        glfwSetWindowUserPointer(window, nullptr);
+        dynamicResolution->del();
+    }
 
     /* Terminate glfw */
     glfwTerminate();
@@ -0,0 +1,148 @@
+#ifndef MESH_BATCH_H
+#define MESH_BATCH_H
+
+#include "VAO.h"
+#include <functional>
+#include <vector>
+
+using namespace std;
+
+/* glad is generated for 3.3, so the GL 4.3 multi-draw indirect pieces are declared here and loaded at runtime */
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+typedef void (APIENTRYP PFNGLMULTIDRAWARRAYSINDIRECTPROC)(GLenum mode, const void *indirect, GLsizei drawcount, GLsizei stride);
+
+/* The record glMultiDrawArraysIndirect reads for each draw */
+struct DrawArraysIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint baseInstance;
+};
+
+/* Keeps every mesh of one vertex layout in one shared vertex buffer, and submits a frame's draws together.
+
+Each draw carries a vec4 of per-draw data (eg. a curve's translation and colour) to attribute location 4.
+On GL 4.3 the draws are written as DrawArraysIndirectCommands, with the per-draw data as an instanced attribute
+picked out by baseInstance, and the whole frame is one glMultiDrawArraysIndirect.
+On 3.3 the attribute array is left disabled, so its constant value can be set before one glMultiDrawArrays per draw. */
+class MeshBatch {
+    MyVAO vao;
+    unsigned int instanceVBO, indirectBuffer;
+    unsigned int stride;
+
+    vector<unsigned char> vertices; // meshes waiting for build()
+    PFNGLMULTIDRAWARRAYSINDIRECTPROC multiDrawArraysIndirect = nullptr;
+
+    /* this frame's draws, kept between frames to avoid allocating */
+    vector<glm::vec4> instances;
+    vector<DrawArraysIndirectCommand> commands;
+    vector<unsigned int> firstCommand; // where each draw's commands start
+
+    /* scratch for the fallback path */
+    vector<GLint> firsts;
+    vector<GLsizei> counts;
+
+public:
+    static const unsigned int instanceLocation = 4;
+
+    MeshBatch(unsigned int strideIn, GLADloadproc loader) : stride(strideIn) {
+        /* only use indirect draws if the context really is 4.3+, the 3.3 glad loader won't have checked */
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major > 4 || (major == 4 && minor >= 3)) {
+            multiDrawArraysIndirect = (PFNGLMULTIDRAWARRAYSINDIRECTPROC)loader("glMultiDrawArraysIndirect");
+        }
+
+        glGenBuffers(1, &instanceVBO);
+        glGenBuffers(1, &indirectBuffer);
+    }
+
+    bool indirect() const { return multiDrawArraysIndirect != nullptr; }
+
+    unsigned int addMesh(const void* data, unsigned int numVertices) {
+        /* queues a mesh for the shared buffer, returning the vertex it will start at */
+        unsigned int base = (unsigned int)(vertices.size() / stride);
+        const unsigned char* bytes = (const unsigned char*)data;
+        vertices.insert(vertices.end(), bytes, bytes + (size_t)numVertices * stride);
+        return base;
+    }
+
+    void build(const function<void()> &applyLayout, GLenum usage = GL_STATIC_DRAW) {
+        /* uploads every queued mesh, applyLayout points the vertex attributes at the bound buffer */
+        vao.addData(vertices.data(), (unsigned int)(vertices.size() / stride), stride, usage);
+
+        vao.bind();
+        applyLayout();
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glVertexAttribPointer(instanceLocation, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+        glVertexAttribDivisor(instanceLocation, 1);
+        if (indirect()) glEnableVertexAttribArray(instanceLocation);
+        else glDisableVertexAttribArray(instanceLocation);
+        vao.unbind();
+
+        vertices.clear();
+        vertices.shrink_to_fit(); // the GPU has its own copy now
+    }
+
+    void begin() {
+        instances.clear();
+        commands.clear();
+        firstCommand.clear();
+    }
+
+    void addDraw(const glm::vec4 &instance, unsigned int base, const GLint meshFirsts[], const GLsizei meshCounts[], unsigned int numRanges) {
+        /* draws these ranges of the mesh starting at base, with instance as its per-draw data */
+        firstCommand.push_back((unsigned int)commands.size());
+        for (unsigned int i = 0; i < numRanges; i++) {
+            commands.push_back({(GLuint)meshCounts[i], 1, base + (GLuint)meshFirsts[i], (GLuint)instances.size()});
+        }
+        instances.push_back(instance);
+    }
+
+    void submit() {
+        if (commands.empty()) return;
+
+        if (indirect()) {
+            /* orphan and refill both buffers, so we never wait on last frame's draws */
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::vec4), instances.data(), GL_STREAM_DRAW);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawArraysIndirectCommand), commands.data(), GL_STREAM_DRAW);
+
+            vao.bind();
+            multiDrawArraysIndirect(GL_TRIANGLES, (void*)0, (GLsizei)commands.size(), 0);
+            vao.unbind();
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            return;
+        }
+
+        for (unsigned int draw = 0; draw < instances.size(); draw++) {
+            unsigned int first = firstCommand[draw];
+            unsigned int last = draw + 1 < firstCommand.size() ? firstCommand[draw + 1] : (unsigned int)commands.size();
+
+            firsts.clear();
+            counts.clear();
+            for (unsigned int c = first; c < last; c++) {
+                firsts.push_back(commands[c].first);
+                counts.push_back(commands[c].count);
+            }
+
+            glVertexAttrib4fv(instanceLocation, glm::value_ptr(instances[draw]));
+            vao.drawRanges(firsts.data(), counts.data(), (unsigned int)firsts.size());
+        }
+    }
+
+    MyVAO& getVAO() { return vao; }
+
+    void del() {
+        vao.del();
+        glDeleteBuffers(1, &instanceVBO);
+        glDeleteBuffers(1, &indirectBuffer);
+    }
+};
+
+#endif
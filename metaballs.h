@@ -0,0 +1,254 @@
+#ifndef METABALLS_H
+#define METABALLS_H
+
+#include "jobSystem.h"
+#include "simd.h"
+#include <algorithm>
+#include <cstdint>
+#include <math.h>
+#include <vector>
+
+using namespace std;
+
+/* Metaballs: balls drifting about a world as wide as the screen's aspect and 1 high, whose field
+    f(p) = sum of r^2 / |p - c|^2
+is filled in wherever it reaches 1, so balls that come close melt into each other.
+
+The field is sampled on a grid, four samples of a row at a time in a float4 and rows in parallel,
+then contoured with marching squares into filled triangles. That is two passes over the rows, both parallel:
+the first finds each cell's case and counts each row's vertices, a prefix sum of the counts says where each row's go,
+and the second writes them there, so they can go straight into a mapped buffer. Runs of cells wholly inside become one quad.
+Every buffer is sized for the finest grid up front, so changing resolution allocates nothing. */
+class Metaballs {
+public:
+    struct Ball {
+        float x, y, radius;
+    };
+
+private:
+    /* each ball follows its own Lissajous path */
+    struct Path {
+        float centreX, centreY, sizeX, sizeY, speedX, speedY, phaseX, phaseY, radius;
+    };
+    vector<Path> paths;
+    vector<Ball> ballsNow;
+    float worldWidth;
+
+    /* the grid: rows x columns cells, with a sample at each corner */
+    unsigned int maxRows, rows = 0, columns = 0;
+    float cellSize = 0.0f;
+    vector<float> field; // (rows + 1) x (columns + 1) samples
+    vector<uint8_t> cases; // rows x columns cells
+    vector<uint32_t> rowStart; // where each row's vertices start, one past the end for the last
+
+    /* a cell's corners count anticlockwise from (x, y): 0 (x, y), 1 (x + 1, y), 2 (x + 1, y + 1), 3 (x, y + 1),
+    and the points where the contour crosses its edges follow them: 4 on 0-1, 5 on 1-2, 6 on 2-3, 7 on 3-0.
+    Each case is up to two convex polygons over those points, drawn as fans. Cases 16 and 17 are the saddles, 5 and 10,
+    when the middle of the cell is inside and joins their two corners up */
+    struct Polygons {
+        uint8_t count[2];
+        uint8_t points[2][6];
+    };
+    static const Polygons& polygons(unsigned int c) {
+        static const Polygons table[18] = {
+            {{0, 0}, {}}, {{3, 0}, {{0, 4, 7}}}, {{3, 0}, {{1, 5, 4}}}, {{4, 0}, {{0, 1, 5, 7}}},
+            {{3, 0}, {{2, 6, 5}}}, {{3, 3}, {{0, 4, 7}, {2, 6, 5}}}, {{4, 0}, {{1, 2, 6, 4}}}, {{5, 0}, {{0, 1, 2, 6, 7}}},
+            {{3, 0}, {{3, 7, 6}}}, {{4, 0}, {{0, 4, 6, 3}}}, {{3, 3}, {{1, 5, 4}, {3, 7, 6}}}, {{5, 0}, {{0, 1, 5, 6, 3}}},
+            {{4, 0}, {{7, 5, 2, 3}}}, {{5, 0}, {{0, 4, 5, 2, 3}}}, {{5, 0}, {{1, 2, 3, 7, 4}}}, {{4, 0}, {{0, 1, 2, 3}}},
+            {{6, 0}, {{0, 4, 5, 2, 6, 7}}}, {{6, 0}, {{1, 5, 6, 3, 7, 4}}},
+        };
+        return table[c];
+    }
+    static unsigned int fanVertices(unsigned int c) {
+        const Polygons &p = polygons(c);
+        return 3 * (max(p.count[0], (uint8_t)2) - 2) + 3 * (max(p.count[1], (uint8_t)2) - 2);
+    }
+
+    float sample(unsigned int x, unsigned int y) const { return field[(size_t)y * (columns + 1) + x]; }
+
+    void evaluateRow(unsigned int y, bool vectorize) {
+        /* the field along sample row y */
+        float* out = &field[(size_t)y * (columns + 1)];
+        float py = y * cellSize;
+        unsigned int samples = columns + 1, x = 0;
+        if (vectorize) {
+            static const float lanes[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+            const float4 lane = load4(lanes), step = splat4(cellSize);
+            for (; x + 4 <= samples; x += 4) {
+                float4 px = (splat4((float)x) + lane) * step;
+                float4 sum = splat4(0.0f);
+                for (const Ball &ball: ballsNow) {
+                    float4 dx = px - splat4(ball.x);
+                    float dy = py - ball.y;
+                    sum = sum + splat4(ball.radius * ball.radius) / (dx * dx + splat4(dy * dy + 1e-12f));
+                }
+                store4(out + x, sum);
+            }
+        }
+        for (; x < samples; x++) {
+            float px = x * cellSize, sum = 0.0f;
+            for (const Ball &ball: ballsNow) {
+                float dx = px - ball.x, dy = py - ball.y;
+                sum += ball.radius * ball.radius / (dx * dx + dy * dy + 1e-12f);
+            }
+            out[x] = sum;
+        }
+    }
+
+    unsigned int classifyRow(unsigned int y) {
+        /* finds the case of each cell along row y, and returns how many vertices the row needs */
+        uint8_t* rowCases = &cases[(size_t)y * columns];
+        const float* below = &field[(size_t)y * (columns + 1)];
+        const float* above = below + columns + 1;
+        unsigned int vertices = 0;
+        bool inRun = false;
+
+        /* each cell's right hand corners are the next one's left */
+        unsigned int left = (below[0] >= 1.0f) | (above[0] >= 1.0f) << 3;
+        for (unsigned int x = 0; x < columns; x++) {
+            unsigned int right = (below[x + 1] >= 1.0f) << 1 | (above[x + 1] >= 1.0f) << 2;
+            unsigned int c = left | right;
+            left = (right & 2) >> 1 | (right & 4) << 1;
+            if ((c == 5 || c == 10) && below[x] + below[x + 1] + above[x + 1] + above[x] >= 4.0f) c = c == 5 ? 16 : 17;
+            rowCases[x] = (uint8_t)c;
+            if (c == 0) {
+                inRun = false;
+                continue;
+            }
+
+            /* a run of whole cells is one quad */
+            if (c == 15) {
+                if (!inRun) vertices += 6;
+                inRun = true;
+                continue;
+            }
+            inRun = false;
+            vertices += fanVertices(c);
+        }
+        return vertices;
+    }
+
+    void writeRow(unsigned int y, float* out) const {
+        /* writes row y's triangles as x, y pairs from out, which has room for exactly what classifyRow counted */
+        const uint8_t* rowCases = &cases[(size_t)y * columns];
+        float y0 = y * cellSize, y1 = (y + 1) * cellSize;
+        auto vertex = [&out](float px, float py) { out[0] = px; out[1] = py; out += 2; };
+
+        for (unsigned int x = 0; x < columns; x++) {
+            unsigned int c = rowCases[x];
+            if (c == 0) continue;
+            float x0 = x * cellSize;
+            if (c == 15) {
+                unsigned int end = x + 1;
+                while (end < columns && rowCases[end] == 15) end++;
+                float x1 = end * cellSize;
+                vertex(x0, y0); vertex(x1, y0); vertex(x1, y1);
+                vertex(x0, y0); vertex(x1, y1); vertex(x0, y1);
+                x = end - 1;
+                continue;
+            }
+
+            /* the cell's corners, then where the contour crosses each edge, interpolating the field linearly along it */
+            float f[4] = {sample(x, y), sample(x + 1, y), sample(x + 1, y + 1), sample(x, y + 1)};
+            float cornerX[4] = {x0, x0 + cellSize, x0 + cellSize, x0}, cornerY[4] = {y0, y0, y1, y1};
+            float pointX[8], pointY[8];
+            for (int i = 0; i < 4; i++) {
+                int j = (i + 1) & 3;
+                float t = (1.0f - f[i]) / (f[j] - f[i]);
+                t = min(max(t, 0.0f), 1.0f);
+                pointX[i] = cornerX[i];
+                pointY[i] = cornerY[i];
+                pointX[4 + i] = cornerX[i] + t * (cornerX[j] - cornerX[i]);
+                pointY[4 + i] = cornerY[i] + t * (cornerY[j] - cornerY[i]);
+            }
+
+            const Polygons &p = polygons(c);
+            for (int k = 0; k < 2; k++) {
+                for (int i = 2; i < p.count[k]; i++) {
+                    vertex(pointX[p.points[k][0]], pointY[p.points[k][0]]);
+                    vertex(pointX[p.points[k][i - 1]], pointY[p.points[k][i - 1]]);
+                    vertex(pointX[p.points[k][i]], pointY[p.points[k][i]]);
+                }
+            }
+        }
+    }
+
+public:
+    /* maxRowsIn is the finest grid that will be asked for */
+    Metaballs(unsigned int numBalls, float aspect, unsigned int maxRowsIn, uint32_t seed = 1) : worldWidth(aspect), maxRows(max(maxRowsIn, 2u)) {
+        uint32_t state = seed * 2654435761u + 1;
+        auto random = [&state] {
+            state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+            return (state >> 8) * (1.0f / 16777216.0f);
+        };
+        for (unsigned int i = 0; i < numBalls; i++) {
+            Path path;
+            path.radius = 0.03f + 0.05f * random();
+            path.centreX = worldWidth * (0.2f + 0.6f * random());
+            path.centreY = 0.2f + 0.6f * random();
+            path.sizeX = worldWidth * (0.1f + 0.3f * random());
+            path.sizeY = 0.1f + 0.3f * random();
+            path.speedX = 0.1f + 0.3f * random();
+            path.speedY = 0.1f + 0.3f * random();
+            path.phaseX = 6.2831853f * random();
+            path.phaseY = 6.2831853f * random();
+            paths.push_back(path);
+        }
+        ballsNow.resize(numBalls);
+
+        unsigned int maxColumns = (unsigned int)ceil(maxRows * worldWidth);
+        field.resize((size_t)(maxRows + 1) * (maxColumns + 1));
+        cases.resize((size_t)maxRows * maxColumns);
+        rowStart.resize(maxRows + 1);
+        setRows(maxRows);
+        move(0.0);
+    }
+
+    void setRows(unsigned int rowsIn) {
+        /* the grid's resolution, as a number of rows of cells, with square cells */
+        rows = min(max(rowsIn, 2u), maxRows);
+        cellSize = 1.0f / rows;
+        columns = max(2u, min((unsigned int)(worldWidth / cellSize), (unsigned int)ceil(maxRows * worldWidth)));
+    }
+
+    void move(double time) {
+        for (size_t i = 0; i < paths.size(); i++) {
+            const Path &p = paths[i];
+            ballsNow[i] = {(float)(p.centreX + p.sizeX * sin(p.speedX * time + p.phaseX)),
+                           (float)(p.centreY + p.sizeY * sin(p.speedY * time + p.phaseY)), p.radius};
+        }
+    }
+
+    void evaluate(JobSystem* jobs, bool vectorize = true) {
+        /* samples the field over the grid, vectorize = false a sample at a time to measure against */
+        parallelFor(jobs, 0, rows + 1, 8, [&](size_t first, size_t last) {
+            for (size_t y = first; y < last; y++) evaluateRow((unsigned int)y, vectorize);
+        });
+    }
+
+    unsigned int classify(JobSystem* jobs) {
+        /* the first contouring pass, returns how many vertices the second will write */
+        parallelFor(jobs, 0, rows, 8, [&](size_t first, size_t last) {
+            for (size_t y = first; y < last; y++) rowStart[y + 1] = classifyRow((unsigned int)y);
+        });
+        rowStart[0] = 0;
+        for (unsigned int y = 0; y < rows; y++) rowStart[y + 1] += rowStart[y];
+        return rowStart[rows];
+    }
+
+    void write(JobSystem* jobs, float* out) const {
+        /* the second pass, x and y of every vertex classify counted, as world units */
+        parallelFor(jobs, 0, rows, 8, [&](size_t first, size_t last) {
+            for (size_t y = first; y < last; y++) writeRow((unsigned int)y, out + 2 * (size_t)rowStart[y]);
+        });
+    }
+
+    const vector<Ball>& balls() const { return ballsNow; }
+    unsigned int gridRows() const { return rows; }
+    unsigned int gridColumns() const { return columns; }
+    unsigned int finestRows() const { return maxRows; }
+    float width() const { return worldWidth; }
+    float gridWidth() const { return columns * cellSize; } // a whisker under width, as the grid is whole cells
+};
+
+#endif
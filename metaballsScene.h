@@ -0,0 +1,144 @@
+#ifndef METABALLS_SCENE_H
+#define METABALLS_SCENE_H
+
+#include "scene.h"
+#include "metaballs.h"
+#include "VAO.h"
+#include "timing.h"
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+
+using namespace std;
+
+/* ---------------------------- Metaballs scene ---------------------------- */
+/* Metaballs (see Metaballs) melting into each other across the screen.
+
+--metaballs picks where the field is worked out, to compare the two:
+cpu samples it on a grid and contours it with marching squares into a MyVAO, whose buffer is orphaned and mapped each frame so the
+triangles are written straight into it. The grid's rows follow the measured CPU time like the dynamic resolution follows the GPU's,
+so the contour is as fine as the frame budget allows. gpu sums the field for every pixel in a fragment shader over a full-screen triangle. */
+class MetaballsScene : public Scene {
+    JobSystem &jobs;
+    bool onGpu;
+    Shader &shader;
+    Metaballs balls;
+    MyVAO contour;
+    unsigned int emptyVAO; // the full-screen triangle comes from gl_VertexID
+
+    float budgetMs; // the CPU time per frame the grid aims for, 0 to keep it at its finest
+    const unsigned int minRows = 32;
+    double smoothedMs = 0.0;
+    unsigned int framesSinceChange = 0;
+
+    StageTimer fieldTimer, contourTimer;
+
+    static ShaderDefines defines(bool onGpu) {
+        ShaderDefines defines;
+        if (onGpu) defines["FIELD"] = "";
+        return defines;
+    }
+
+    void adjustRows(double ms) {
+        /* the cost goes with the number of cells, ie. rows squared, so jump straight to the rows that should fit
+        when over budget, and creep back up when comfortably under */
+        if (budgetMs <= 0.0f) return;
+        smoothedMs = smoothedMs == 0.0 ? ms : 0.9 * smoothedMs + 0.1 * ms;
+        if (++framesSinceChange < 10) return;
+
+        float rows = (float)balls.gridRows();
+        if (smoothedMs > budgetMs) rows *= sqrt(budgetMs / smoothedMs) * 0.95f;
+        else if (smoothedMs < 0.7 * budgetMs) rows *= 1.05f;
+        unsigned int newRows = (unsigned int)clamp(rows, (float)minRows, (float)balls.finestRows());
+
+        if (newRows != balls.gridRows()) {
+            balls.setRows(newRows);
+            framesSinceChange = 0;
+        }
+    }
+
+public:
+    MetaballsScene(const SceneContext &context)
+        : jobs(context.jobs),
+          /* --metaballs=cpu|gpu picks where the field is worked out, --balls=<n> how many there are */
+          onGpu(context.option("metaballs", "cpu") == "gpu"),
+          shader(context.shaders.get(onGpu ? "shaders/fullscreenVertexShader.txt" : "shaders/metaballsVertexShader.txt",
+                                     "shaders/metaballsFragmentShader.txt", defines(onGpu))),
+          /* --metaball-rows=<n> is the finest grid, in rows of cells */
+          balls((unsigned int)clamp(stoi(context.option("balls", "24")), 1, 64), context.viewportAspect(),
+                (unsigned int)max(2, stoi(context.option("metaball-rows", "540")))),
+          /* --metaball-budget=<ms> is the CPU time the grid aims for each frame */
+          budgetMs(max(0.0f, stof(context.option("metaball-budget", "4")))) {
+        contour.addData(nullptr, 0, 2 * sizeof(float), GL_STREAM_DRAW);
+        const VertexAttrib position[1] = {{2, GL_FLOAT, false}};
+        contour.addAttrib(position, 1);
+        glGenVertexArrays(1, &emptyVAO);
+
+        if (budgetMs > 0.0f) balls.setRows(max(minRows, balls.finestRows() / 4)); // start coarse and work up
+
+        shader.use();
+        shader.setVec2("uvScale", glm::vec2(1.0f));
+    }
+
+    void update(double time, float dt) override {
+        /* the paths are worked out from the time alone, so they keep their speed whatever the frame rate */
+        balls.move(time);
+        if (onGpu) return;
+
+        Clock::time_point start = Clock::now();
+        {
+            ScopedStage stage(fieldTimer);
+            balls.evaluate(&jobs);
+        }
+        {
+            ScopedStage stage(contourTimer);
+            unsigned int vertices = balls.classify(&jobs);
+            float* mapped = (float*)contour.mapData(vertices);
+            if (mapped) {
+                balls.write(&jobs, mapped);
+                contour.unmapData();
+            }
+        }
+        adjustRows(msBetween(start, Clock::now()));
+    }
+
+    void draw(int width, int height) override {
+        glClearColor(0.02f, 0.03f, 0.06f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glDisable(GL_DEPTH_TEST); // flat, so the depth test would only cost
+        shader.use();
+        if (onGpu) {
+            glm::vec4 uniforms[64];
+            const vector<Metaballs::Ball> &now = balls.balls();
+            for (size_t i = 0; i < now.size(); i++) uniforms[i] = glm::vec4(now[i].x, now[i].y, now[i].radius * now[i].radius, 0.0f);
+            shader.setVec4Array("balls", uniforms, (unsigned int)now.size());
+            shader.setInt("numBalls", (int)now.size());
+            shader.setVec2("worldSize", glm::vec2(balls.width(), 1.0f));
+            glBindVertexArray(emptyVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(0);
+        } else {
+            shader.setVec2("worldSize", glm::vec2(balls.gridWidth(), 1.0f));
+            contour.draw();
+        }
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    void report() override {
+        cout << "  metaballs: " << balls.balls().size() << " balls on the " << (onGpu ? "GPU" : "CPU");
+        if (!onGpu) {
+            cout << ", " << balls.gridColumns() << "x" << balls.gridRows() << " grid, field " << fieldTimer.averageMs() << " ms, contour "
+                 << contourTimer.averageMs() << " ms/frame (" << contour.getNumVertices() / 3 << " triangles, " << jobs.threads() << " threads)";
+        }
+        cout << endl;
+        fieldTimer.reset(); contourTimer.reset();
+    }
+
+    void del() override {
+        contour.del();
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+};
+
+#endif
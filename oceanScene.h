@@ -0,0 +1,281 @@
+#ifndef OCEAN_SCENE_H
+#define OCEAN_SCENE_H
+
+#include "scene.h"
+#include "VAO.h"
+#include "vertexLayout.h"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+/* One of the sines summed into the ocean, the curves' sine turned to travel across a plane */
+struct OceanWave {
+    glm::vec2 direction;
+    float wavenumber; // radians per unit, 2 pi / wavelength
+    float amplitude;
+
+    double frequency() const { return sqrt(9.81 * wavenumber); } // deep water waves, so longer ones travel faster
+};
+
+/* ---------------------------- Ocean scene ---------------------------- */
+/* A 3D "ocean of sines": a heightfield of summed sines seen from a camera flying over it.
+
+The surface is a geometry clipmap: levels of the same indexed grid, each twice the cell size of the last and centred on the camera,
+so the triangle density falls off with distance. Level 0 is a full grid, the rest are rings around the level inside them.
+
+Every sine is sin(k.p + wt) = sin(k.p) cos(wt) + cos(k.p) sin(wt), so each level keeps sin(k.p) and cos(k.p) per cell in a texture,
+computed on the CPU in double precision, and the time part is two uniforms. The textures only change as the camera moves,
+and then only the rows and columns that scrolled into view are written, addressed toroidally (cell c lives at texel c mod gridSize). */
+class OceanScene : public Scene {
+public:
+    static const int gridSize = 129; // vertices along a level's side, 4 * ringCells + 1
+    static const int ringCells = 32; // the hole in a ring is 2 * ringCells cells of its own level across
+    static const int numWaves = 4;
+
+private:
+    struct Level {
+        glm::ivec2 origin = glm::ivec2(0); // the first cell of the level, in its own cells
+        glm::ivec2 stored = glm::ivec2(0); // the origin the texture currently holds
+        glm::ivec2 holeOffset = glm::ivec2(0); // 0 or 1 per axis, where the finer level sits inside this one
+        bool valid = false;
+        float cellSize;
+    };
+
+    JobSystem &jobs;
+    Shader &shader;
+    MyVAO grid;
+    unsigned int waveTable; // a 2D texture array, two RGBA layers per level: sin and cos of k.p for two waves each
+
+    vector<Level> levels;
+    OceanWave waves[numWaves];
+    vector<float> staging; // texels on their way to the texture
+
+    /* the element ranges of the full grid and the four ring variants, by hole offset x + 2 * z */
+    unsigned int fullFirst, fullCount;
+    unsigned int ringFirst[4], ringCount[4];
+
+    /* the camera flies a slowly curving path over the waves */
+    glm::vec3 camera = glm::vec3(0.0f, 1.6f, 0.0f);
+    float heading = 0.0f;
+    double time = 0.0;
+
+    /* texels written since the last report, to compare against rewriting every level every frame */
+    size_t texelsWritten = 0, framesSinceReport = 0;
+
+    static int posMod(int a, int n) { return ((a % n) + n) % n; }
+
+    void buildGrid() {
+        /* one grid of integer cell coordinates, shared by every level */
+        vector<glm::vec2> vertices;
+        for (int z = 0; z < gridSize; z++) {
+            for (int x = 0; x < gridSize; x++) vertices.push_back(glm::vec2(x, z));
+        }
+        grid.addData<VertexLayout<Attr<glm::vec2, Position>>>(std::span<const glm::vec2>(vertices));
+
+        vector<unsigned int> indices;
+        auto addCells = [&](int holeX, int holeZ, bool hole) {
+            /* two triangles per cell, skipping the 2 * ringCells square starting at ringCells + the hole offset */
+            for (int z = 0; z < gridSize - 1; z++) {
+                for (int x = 0; x < gridSize - 1; x++) {
+                    bool inHole = hole && x >= ringCells + holeX && x < 3 * ringCells + holeX && z >= ringCells + holeZ && z < 3 * ringCells + holeZ;
+                    if (inHole) continue;
+
+                    unsigned int corner = z * gridSize + x;
+                    indices.insert(indices.end(), {corner, corner + 1, corner + gridSize, corner + 1, corner + gridSize + 1, corner + gridSize});
+                }
+            }
+        };
+
+        fullFirst = 0;
+        addCells(0, 0, false);
+        fullCount = (unsigned int)indices.size();
+        for (int variant = 0; variant < 4; variant++) {
+            ringFirst[variant] = (unsigned int)indices.size();
+            addCells(variant & 1, variant >> 1, true);
+            ringCount[variant] = (unsigned int)indices.size() - ringFirst[variant];
+        }
+        grid.addIndices(indices.data(), (unsigned int)indices.size());
+    }
+
+    void writeTexel(float* texel, size_t layerStride, glm::ivec2 cell, float cellSize) {
+        /* sin and cos of each wave's spatial phase at a cell, two waves per layer */
+        double x = (double)cell.x * cellSize, z = (double)cell.y * cellSize;
+        for (int i = 0; i < numWaves; i++) {
+            double phase = waves[i].wavenumber * (waves[i].direction.x * x + waves[i].direction.y * z);
+            float* out = texel + (i / 2) * layerStride + (i % 2) * 2;
+            out[0] = (float)sin(phase);
+            out[1] = (float)cos(phase);
+        }
+    }
+
+    void writeColumn(unsigned int index, const Level &level, int cellX) {
+        /* a whole column of the level's window, uploaded as a 1 x gridSize x 2 block */
+        float* data = staging.data();
+        for (int t = 0; t < gridSize; t++) {
+            int cellZ = level.origin.y + posMod(t - level.origin.y, gridSize); // the cell in the window stored at texel row t
+            writeTexel(data + t * 4, gridSize * 4, glm::ivec2(cellX, cellZ), level.cellSize);
+        }
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, posMod(cellX, gridSize), 0, index * 2, 1, gridSize, 2, GL_RGBA, GL_FLOAT, data);
+        texelsWritten += gridSize;
+    }
+
+    void writeRow(unsigned int index, const Level &level, int cellZ) {
+        float* data = staging.data();
+        for (int t = 0; t < gridSize; t++) {
+            int cellX = level.origin.x + posMod(t - level.origin.x, gridSize);
+            writeTexel(data + t * 4, gridSize * 4, glm::ivec2(cellX, cellZ), level.cellSize);
+        }
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, posMod(cellZ, gridSize), index * 2, gridSize, 1, 2, GL_RGBA, GL_FLOAT, data);
+        texelsWritten += gridSize;
+    }
+
+    void writeLevel(unsigned int index, const Level &level) {
+        /* the whole level, rows in parallel */
+        const size_t layerStride = (size_t)gridSize * gridSize * 4;
+        float* data = staging.data();
+        parallelFor(&jobs, 0, gridSize, 16, [&](size_t first, size_t last) {
+            for (size_t tz = first; tz < last; tz++) {
+                int cellZ = level.origin.y + posMod((int)tz - level.origin.y, gridSize);
+                for (int tx = 0; tx < gridSize; tx++) {
+                    int cellX = level.origin.x + posMod(tx - level.origin.x, gridSize);
+                    writeTexel(data + (tz * gridSize + tx) * 4, layerStride, glm::ivec2(cellX, cellZ), level.cellSize);
+                }
+            }
+        });
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, index * 2, gridSize, gridSize, 2, GL_RGBA, GL_FLOAT, data);
+        texelsWritten += (size_t)gridSize * gridSize;
+    }
+
+    void updateLevel(unsigned int index) {
+        Level &level = levels[index];
+
+        /* snap to every other cell, so the finer level inside stays on this level's grid */
+        glm::ivec2 snapped = glm::ivec2(glm::floor(glm::vec2(camera.x, camera.z) / (2.0f * level.cellSize))) * 2;
+        glm::ivec2 finer = glm::ivec2(glm::floor(glm::vec2(camera.x, camera.z) / level.cellSize));
+        level.origin = snapped - glm::ivec2(2 * ringCells);
+        level.holeOffset = finer - snapped;
+
+        glm::ivec2 moved = level.origin - level.stored;
+        if (level.valid && moved == glm::ivec2(0)) return;
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, waveTable);
+        if (!level.valid || abs(moved.x) >= gridSize || abs(moved.y) >= gridSize) {
+            writeLevel(index, level);
+        } else {
+            /* only the columns and rows that scrolled in, the rest of the texture is still right where it is */
+            if (moved.x > 0) for (int x = level.stored.x + gridSize; x < level.origin.x + gridSize; x++) writeColumn(index, level, x);
+            if (moved.x < 0) for (int x = level.origin.x; x < level.stored.x; x++) writeColumn(index, level, x);
+            if (moved.y > 0) for (int z = level.stored.y + gridSize; z < level.origin.y + gridSize; z++) writeRow(index, level, z);
+            if (moved.y < 0) for (int z = level.origin.y; z < level.stored.y; z++) writeRow(index, level, z);
+        }
+        level.stored = level.origin;
+        level.valid = true;
+    }
+
+public:
+    OceanScene(const SceneContext &context)
+        : jobs(context.jobs), shader(context.shaders.get("shaders/oceanVertexShader.txt", "shaders/oceanFragmentShader.txt")) {
+        /* --ocean-levels=<n> sets how many clipmap levels there are, each doubling the distance covered */
+        unsigned int numLevels = (unsigned int)max(1, stoi(context.option("ocean-levels", "6")));
+        float cellSize = 0.05f;
+        for (unsigned int i = 0; i < numLevels; i++, cellSize *= 2.0f) {
+            Level level;
+            level.cellSize = cellSize;
+            levels.push_back(level);
+        }
+
+        /* the steepness (amplitude * wavenumber) of each is well below the curves' sine, which would fold over in 3D */
+        waves[0] = {glm::normalize(glm::vec2(1.0f, 0.2f)), 1.3f, 0.16f};
+        waves[1] = {glm::normalize(glm::vec2(0.7f, -0.6f)), 2.1f, 0.08f};
+        waves[2] = {glm::normalize(glm::vec2(0.2f, 1.0f)), 3.7f, 0.04f};
+        waves[3] = {glm::normalize(glm::vec2(-0.5f, 0.8f)), 6.3f, 0.02f};
+
+        buildGrid();
+        staging.resize((size_t)gridSize * gridSize * 2 * 4);
+
+        glGenTextures(1, &waveTable);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, waveTable);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA32F, gridSize, gridSize, numLevels * 2, 0, GL_RGBA, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        shader.use();
+        shader.setInt("waveTable", 0);
+        shader.setInt("gridSize", gridSize);
+        glm::vec4 waveUniforms[numWaves];
+        for (int i = 0; i < numWaves; i++) waveUniforms[i] = glm::vec4(waves[i].direction, waves[i].wavenumber, waves[i].amplitude);
+        shader.setVec4Array("waves", waveUniforms, numWaves);
+        shader.setFloat("fogEnd", 0.9f * 2 * ringCells * levels.back().cellSize);
+    }
+
+    void update(double timeIn, float dt) override {
+        time = timeIn;
+
+        /* fly forwards, weaving gently */
+        heading = 0.4f * (float)sin(time * 0.05);
+        camera += 1.5f * dt * glm::vec3(cos(heading), 0.0f, sin(heading));
+
+        for (unsigned int i = 0; i < levels.size(); i++) updateLevel(i);
+        framesSinceReport ++;
+    }
+
+    void draw(int width, int height) override {
+        glm::vec3 forward(cos(heading), -0.3f, sin(heading));
+        glm::mat4 view = glm::lookAt(camera, camera + forward, glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 projection = glm::perspective(glm::radians(60.0f), (float)width / max(height, 1), 0.05f, 1000.0f);
+
+        /* the time part of each sine, in double precision so it doesn't drift as the hours go by */
+        glm::vec4 phaseSin, phaseCos;
+        for (int i = 0; i < numWaves; i++) {
+            double phase = fmod(waves[i].frequency() * time, 2.0 * M_PI);
+            phaseSin[i] = (float)sin(phase);
+            phaseCos[i] = (float)cos(phase);
+        }
+
+        glClearColor(0.75f, 0.88f, 0.95f, 1.0f); // the sky, which the fog fades into
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        shader.use();
+        shader.setMat4("viewProjection", projection * view);
+        shader.setVec3("camera", camera);
+        glUniform4fv(glGetUniformLocation(shader.ID, "phaseSin"), 1, glm::value_ptr(phaseSin));
+        glUniform4fv(glGetUniformLocation(shader.ID, "phaseCos"), 1, glm::value_ptr(phaseCos));
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, waveTable);
+
+        GLint originLocation = glGetUniformLocation(shader.ID, "levelOrigin");
+        GLint cellSizeLocation = glGetUniformLocation(shader.ID, "cellSize");
+        GLint levelLocation = glGetUniformLocation(shader.ID, "level");
+        for (unsigned int i = 0; i < levels.size(); i++) {
+            const Level &level = levels[i];
+            glUniform2i(originLocation, level.origin.x, level.origin.y);
+            glUniform1f(cellSizeLocation, level.cellSize);
+            glUniform1i(levelLocation, (int)i);
+
+            if (i == 0) {
+                grid.drawIndexed(fullFirst, fullCount);
+            } else {
+                /* where the finer level sits depends on which half of this level's double cell the camera is in */
+                int variant = level.holeOffset.x + 2 * level.holeOffset.y;
+                grid.drawIndexed(ringFirst[variant], ringCount[variant]);
+            }
+        }
+    }
+
+    void report() override {
+        size_t fullTexels = levels.size() * gridSize * gridSize;
+        cout << "  ocean: " << levels.size() << " clipmap levels, " << (double)texelsWritten / max(framesSinceReport, (size_t)1)
+             << " texels written per frame (rewriting every level would be " << fullTexels << ")" << endl;
+        texelsWritten = framesSinceReport = 0;
+    }
+
+    void del() override {
+        grid.del();
+        glDeleteTextures(1, &waveTable);
+    }
+};
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <string>
+
+using namespace std;
+
+/* Returns the value of a "--name=value" command line option, or fallback if it wasn't given */
+inline string getOption(int argc, char* argv[], const string &name, const string &fallback) {
+    const string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; i ++) {
+        string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0) return arg.substr(prefix.size());
+    }
+    return fallback;
+}
+
+#endif
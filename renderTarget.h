@@ -0,0 +1,56 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include "shader.h" // glad is included here
+#include <iostream>
+
+/* An offscreen framebuffer with a colour texture and a depth buffer */
+class RenderTarget {
+    unsigned int FBO = 0, colour = 0, depth = 0;
+    int width = 0, height = 0;
+
+public:
+    void resize(int widthIn, int heightIn) {
+        /* (re)allocates the attachments, so should only be called when the size actually changes */
+        del();
+        width = widthIn;
+        height = heightIn;
+
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+        glGenTextures(1, &colour);
+        glBindTexture(GL_TEXTURE_2D, colour);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colour, 0);
+
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "ERROR::FRAMEBUFFER::INCOMPLETE" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void bind() const { glBindFramebuffer(GL_FRAMEBUFFER, FBO); }
+    unsigned int framebuffer() const { return FBO; }
+    unsigned int texture() const { return colour; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    void del() {
+        if (FBO) glDeleteFramebuffers(1, &FBO);
+        if (colour) glDeleteTextures(1, &colour);
+        if (depth) glDeleteRenderbuffers(1, &depth);
+        FBO = colour = depth = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include "simd.h"
+#include "jobSystem.h"
+#include <algorithm>
+#include <cstdint>
+#include <math.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* How each destination pixel is made from the source pixels around it */
+enum class ResampleFilter {
+    Box, // the average of the source it covers, cheap and soft
+    Lanczos // a windowed sinc three source pixels (or destination pixels, when shrinking) either side, sharp with slight ringing
+};
+
+inline ResampleFilter parseResampleFilter(const string &name) {
+    return name == "box" ? ResampleFilter::Box : ResampleFilter::Lanczos;
+}
+
+/* Which source pixels along one axis make up each destination pixel, and how much of each */
+struct ResampleWeights {
+    vector<int> first; // the first source pixel of each destination pixel
+    vector<int> offset; // where its weights start in weights, one past the end for the last
+    vector<float> weights;
+
+    int taps(int i) const { return offset[i + 1] - offset[i]; }
+    int end(int i) const { return first[i] + taps(i); } // one past its last source pixel
+};
+
+inline ResampleWeights boxWeights(int sourceLength, int destLength) {
+    /* each destination pixel averages the source it covers, weighting the pixels cut by its edges by how much of them it covers */
+    ResampleWeights axis;
+    double scale = (double)sourceLength / destLength;
+    axis.offset.push_back(0);
+    for (int i = 0; i < destLength; i++) {
+        double start = i * scale, end = (i + 1) * scale;
+        int first = (int)floor(start), last = min((int)ceil(end), sourceLength);
+        axis.first.push_back(first);
+        for (int j = first; j < last; j++) {
+            double covered = min(end, (double)j + 1.0) - max(start, (double)j);
+            axis.weights.push_back((float)(covered / scale));
+        }
+        axis.offset.push_back((int)axis.weights.size());
+    }
+    return axis;
+}
+
+inline double lanczos3(double x) {
+    if (x == 0.0) return 1.0;
+    if (fabs(x) >= 3.0) return 0.0;
+    double px = M_PI * x;
+    return 3.0 * sin(px) * sin(px / 3.0) / (px * px);
+}
+
+inline ResampleWeights lanczosWeights(int sourceLength, int destLength) {
+    /* Lanczos 3, stretched over the destination pixel spacing when shrinking so it still filters out what the destination can't hold.
+    Taps past the edges are dropped and the rest renormalized, which is the same as the edge pixels carrying on outwards */
+    ResampleWeights axis;
+    double scale = (double)sourceLength / destLength;
+    double stretch = max(scale, 1.0), support = 3.0 * stretch;
+    axis.offset.push_back(0);
+    for (int i = 0; i < destLength; i++) {
+        double centre = (i + 0.5) * scale - 0.5; // in source pixels
+        int first = max((int)floor(centre - support) + 1, 0), last = min((int)ceil(centre + support), sourceLength);
+        first = min(first, last - 1);
+
+        size_t start = axis.weights.size();
+        double sum = 0.0;
+        for (int j = first; j < last; j++) {
+            double weight = lanczos3((j - centre) / stretch);
+            axis.weights.push_back((float)weight);
+            sum += weight;
+        }
+        for (size_t k = start; k < axis.weights.size(); k++) axis.weights[k] = (float)(axis.weights[k] / sum);
+        axis.first.push_back(first);
+        axis.offset.push_back((int)axis.weights.size());
+    }
+    return axis;
+}
+
+inline ResampleWeights resampleWeights(ResampleFilter filter, int sourceLength, int destLength) {
+    return filter == ResampleFilter::Box ? boxWeights(sourceLength, destLength) : lanczosWeights(sourceLength, destLength);
+}
+
+/* A separable RGBA8 resampler, one pixel per float4.
+The destination is done in bands of rows, spread over the job system, and each band in tiles of columns.
+For each destination row of a tile, the source rows under it are first summed vertically into a float row just as wide as the tile needs,
+then that row is filtered horizontally. Neighbouring rows share most of their source rows (a Lanczos shrink of 5x reads 30 of them),
+so bounding tiles to a few thousand source pixels keeps those slices and the float row in a core's share of L2 however wide the photo.
+Much narrower tiles cost more than they save, in shorter runs for the prefetcher and tile edges done twice.
+Beyond the images, it only needs a tile's row per band in flight, so a 50 megapixel photo shrinks without a second copy of it. */
+class Resampler {
+    int sourceWidth, sourceHeight, destWidth, destHeight;
+    ResampleWeights horizontal, vertical;
+
+    struct Tile {
+        int firstColumn, lastColumn; // destination columns [first, last)
+        int sourceStart, sourceEnd; // the source columns they need
+    };
+    vector<Tile> tiles;
+
+    static const int bandRows = 16;
+
+    void resampleTile(const uint8_t* source, size_t sourceStride, uint8_t* dest, size_t destStride, int y, const Tile &tile, float* row) const {
+        /* one destination row of a tile, row holds the tile's source span of float4s */
+        const float* wy = vertical.weights.data() + vertical.offset[y];
+        const uint8_t* in = source + vertical.first[y] * sourceStride + 4 * (size_t)tile.sourceStart;
+        int taps = vertical.taps(y);
+        int span = tile.sourceEnd - tile.sourceStart;
+
+        /* two pixels at a time, so their sums over the taps overlap rather than each waiting on its last add */
+        int x = 0;
+        for (; x + 2 <= span; x += 2) {
+            const uint8_t* pixel = in + 4 * x;
+            float4 weight = splat4(wy[0]);
+            float4 sum0 = weight * loadBytes4(pixel), sum1 = weight * loadBytes4(pixel + 4);
+            for (int k = 1; k < taps; k++) {
+                weight = splat4(wy[k]);
+                sum0 = sum0 + weight * loadBytes4(pixel + k * sourceStride);
+                sum1 = sum1 + weight * loadBytes4(pixel + k * sourceStride + 4);
+            }
+            store4(row + 4 * x, sum0);
+            store4(row + 4 * x + 4, sum1);
+        }
+        for (; x < span; x++) {
+            const uint8_t* pixel = in + 4 * x;
+            float4 sum = splat4(wy[0]) * loadBytes4(pixel);
+            for (int k = 1; k < taps; k++) sum = sum + splat4(wy[k]) * loadBytes4(pixel + k * sourceStride);
+            store4(row + 4 * x, sum);
+        }
+
+        uint8_t* out = dest + y * destStride;
+        for (int x = tile.firstColumn; x < tile.lastColumn; x++) {
+            const float* wx = horizontal.weights.data() + horizontal.offset[x];
+            const float* pixel = row + 4 * (horizontal.first[x] - tile.sourceStart);
+            float4 sum = splat4(wx[0]) * load4(pixel);
+            for (int k = 1; k < horizontal.taps(x); k++) sum = sum + splat4(wx[k]) * load4(pixel + 4 * k);
+            storeBytes4(out + 4 * x, sum);
+        }
+    }
+
+public:
+    /* tileSpan is the most source columns a tile covers, 0 for whole rows */
+    Resampler(int sourceWidthIn, int sourceHeightIn, int destWidthIn, int destHeightIn, ResampleFilter filter = ResampleFilter::Lanczos, int tileSpan = 4096)
+        : sourceWidth(sourceWidthIn), sourceHeight(sourceHeightIn), destWidth(destWidthIn), destHeight(destHeightIn),
+          horizontal(resampleWeights(filter, sourceWidthIn, destWidthIn)), vertical(resampleWeights(filter, sourceHeightIn, destHeightIn)) {
+        /* greedily take destination columns into a tile until their source span would pass tileSpan, always at least one */
+        if (tileSpan <= 0) tileSpan = sourceWidth;
+        for (int x = 0; x < destWidth;) {
+            Tile tile = {x, x, horizontal.first[x], horizontal.end(x)};
+            while (tile.lastColumn < destWidth) {
+                int end = max(tile.sourceEnd, horizontal.end(tile.lastColumn));
+                if (tile.lastColumn > tile.firstColumn && end - tile.sourceStart > tileSpan) break;
+                tile.sourceStart = min(tile.sourceStart, horizontal.first[tile.lastColumn]);
+                tile.sourceEnd = end;
+                tile.lastColumn ++;
+            }
+            tiles.push_back(tile);
+            x = tile.lastColumn;
+        }
+    }
+
+    void resampleRows(const uint8_t* source, size_t sourceStride, uint8_t* dest, size_t destStride, int firstRow, int lastRow) const {
+        /* writes destination rows [firstRow, lastRow) on the calling thread, strides are in bytes */
+        size_t widest = 0;
+        for (const Tile &tile: tiles) widest = max(widest, (size_t)(tile.sourceEnd - tile.sourceStart));
+        vector<float> row(widest * 4);
+
+        for (const Tile &tile: tiles) {
+            for (int y = firstRow; y < lastRow; y++) resampleTile(source, sourceStride, dest, destStride, y, tile, row.data());
+        }
+    }
+
+    void resample(const uint8_t* source, uint8_t* dest, JobSystem* jobs = nullptr) const {
+        /* tightly packed images of the sizes given to the constructor, in bands of rows over jobs if given */
+        size_t sourceStride = (size_t)sourceWidth * 4, destStride = (size_t)destWidth * 4;
+        parallelFor(jobs, 0, destHeight, bandRows, [&](size_t first, size_t last) {
+            resampleRows(source, sourceStride, dest, destStride, (int)first, (int)last);
+        });
+    }
+
+    size_t tileCount() const { return tiles.size(); }
+};
+
+/* The same resampling, written plainly in double a pass at a time, to check Resampler against */
+inline void resampleReference(const uint8_t* source, int sourceWidth, int sourceHeight, uint8_t* dest, int destWidth, int destHeight, ResampleFilter filter) {
+    ResampleWeights horizontal = resampleWeights(filter, sourceWidth, destWidth), vertical = resampleWeights(filter, sourceHeight, destHeight);
+
+    vector<double> across((size_t)sourceHeight * destWidth * 4);
+    for (int y = 0; y < sourceHeight; y++) {
+        for (int x = 0; x < destWidth; x++) {
+            for (int c = 0; c < 4; c++) {
+                double sum = 0.0;
+                for (int k = 0; k < horizontal.taps(x); k++) {
+                    sum += horizontal.weights[horizontal.offset[x] + k] * source[((size_t)y * sourceWidth + horizontal.first[x] + k) * 4 + c];
+                }
+                across[((size_t)y * destWidth + x) * 4 + c] = sum;
+            }
+        }
+    }
+
+    for (int y = 0; y < destHeight; y++) {
+        for (int x = 0; x < destWidth; x++) {
+            for (int c = 0; c < 4; c++) {
+                double sum = 0.0;
+                for (int k = 0; k < vertical.taps(y); k++) {
+                    sum += vertical.weights[vertical.offset[y] + k] * across[((size_t)(vertical.first[y] + k) * destWidth + x) * 4 + c];
+                }
+                dest[((size_t)y * destWidth + x) * 4 + c] = (uint8_t)min(max(lround(sum), 0L), 255L);
+            }
+        }
+    }
+}
+
+/* The largest size with the source's aspect ratio that fits in width x height */
+inline void fitInside(int sourceWidth, int sourceHeight, int width, int height, int &fitWidth, int &fitHeight) {
+    double scale = min((double)width / sourceWidth, (double)height / sourceHeight);
+    fitWidth = max(1, (int)lround(sourceWidth * scale));
+    fitHeight = max(1, (int)lround(sourceHeight * scale));
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "jobSystem.h"
+#include "options.h"
+#include "shaderCache.h"
+#include <string>
+
+using namespace std;
+
+/* What a scene is given when it is made: the shared job system and shader cache, and the command line for its options */
+struct SceneContext {
+    JobSystem &jobs;
+    ShaderCache &shaders;
+    int argc;
+    char** argv;
+
+    string option(const string &name, const string &fallback) const {
+        return getOption(argc, argv, name, fallback);
+    }
+
+    float viewportAspect() const {
+        /* the window's, as scenes are made once it is up, for scenes that size their world to it */
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        return viewport[3] > 0 ? (float)viewport[2] / viewport[3] : 16.0f / 9.0f;
+    }
+};
+
+/* Turns each frame's dt into whole steps of a fixed length, for simulations that only work with one step size,
+so they run at the same speed whatever the frame rate, like the curves' simulation thread.
+A frame more than maxSteps late runs maxSteps and drops the rest, rather than falling further behind trying to catch up */
+class FixedStep {
+    double stepSeconds, owed = 0.0;
+    unsigned int maxSteps;
+
+public:
+    FixedStep(double stepSecondsIn = 1.0 / 60.0, unsigned int maxStepsIn = 4) : stepSeconds(stepSecondsIn), maxSteps(maxStepsIn) {}
+
+    unsigned int due(float dt) {
+        /* how many steps to run this frame */
+        owed += dt;
+        unsigned int steps = (unsigned int)(owed / stepSeconds);
+        if (steps > maxSteps) {
+            owed = 0.0;
+            return maxSteps;
+        }
+        owed -= steps * stepSeconds;
+        return steps;
+    }
+
+    double seconds() const { return stepSeconds; }
+};
+
+/* A screensaver scene other than the curves, picked with --scene=<name>, see makeScene.
+main owns the window and the loop, and calls update then draw once per frame. */
+class Scene {
+public:
+    virtual ~Scene() {}
+
+    /* time is seconds since the scene started, dt the seconds since the last update */
+    virtual void update(double time, float dt) = 0;
+
+    /* draws into the bound framebuffer, which is width x height pixels */
+    virtual void draw(int width, int height) = 0;
+
+    /* prints anything worth knowing about the last few seconds, called with the frame stage report */
+    virtual void report() {}
+
+    virtual void del() = 0;
+};
+
+#endif
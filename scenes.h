@@ -0,0 +1,33 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include "scene.h"
+#include "oceanScene.h"
+#include "stringsScene.h"
+#include "slideshowScene.h"
+#include "boidsScene.h"
+#include "starfieldScene.h"
+#include "metaballsScene.h"
+#include "fractalScene.h"
+#include "lifeScene.h"
+#include "fluidScene.h"
+#include <memory>
+#include <string>
+
+using namespace std;
+
+/* Makes the scene --scene=<name> asks for, or nullptr if there is no such scene. Needs a current GL context */
+inline unique_ptr<Scene> makeScene(const string &name, const SceneContext &context) {
+    if (name == "ocean") return make_unique<OceanScene>(context);
+    if (name == "strings") return make_unique<StringsScene>(context);
+    if (name == "slideshow") return make_unique<SlideshowScene>(context);
+    if (name == "boids") return make_unique<BoidsScene>(context);
+    if (name == "starfield") return make_unique<StarfieldScene>(context);
+    if (name == "metaballs") return make_unique<MetaballsScene>(context);
+    if (name == "fractal") return make_unique<FractalScene>(context);
+    if (name == "life") return make_unique<LifeScene>(context);
+    if (name == "fluid") return make_unique<FluidScene>(context);
+    return nullptr;
+}
+
+#endif
@@ -2,12 +2,14 @@
 #define SHADER_H
 
 #include "glad.c" // needed for OpenGL functions 
+#include "shaderPreprocessor.h"
 
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <string>
 
+#include <glm/vec2.hpp> // glm::vec2
 #include <glm/vec3.hpp> // glm::vec3
 #include <glm/vec4.hpp> // glm::vec4
 #include <glm/mat4x4.hpp> // glm::mat4
@@ -22,46 +24,25 @@ public:
     // the shader program ID
     unsigned int ID;
 
-    // constructor which reads and builds the shader
-    Shader(const char* vertexSrcPath, const char* framentSrcPath) {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
-        {
-            // open files
-            vShaderFile.open(vertexSrcPath);
-            fShaderFile.open(framentSrcPath);
-            std::stringstream vShaderStream, fShaderStream;
-
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();	
-
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-
-            // convert stream into string
-            vertexCode   = vShaderStream.str();
-            fragmentCode = fShaderStream.str();		
-        }
-        catch(std::ifstream::failure e)
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-        }
+    // constructor which reads, preprocesses and builds the shader
+    Shader(const char* vertexSrcPath, const char* framentSrcPath, const ShaderDefines &defines = {}) {
+        // 1. retrieve the vertex/fragment source code from filePath, expanding includes and adding the defines
+        ShaderSource vertexSource = preprocessShader(vertexSrcPath, defines);
+        ShaderSource fragmentSource = preprocessShader(framentSrcPath, defines);
 
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
+        // 2. compile and link them
+        ID = build(vertexSource, fragmentSource);
+    }
+
+    // wraps a program that is already linked (eg. loaded from a binary)
+    explicit Shader(unsigned int programID) : ID(programID) {}
+
+    static unsigned int build(const ShaderSource &vertexSource, const ShaderSource &fragmentSource) {
+        const char* vShaderCode = vertexSource.code.c_str();
+        const char* fShaderCode = fragmentSource.code.c_str();
 
         /* -------------------------------------------------- */
-        // 2. compile shaders
+        // compile shaders
         unsigned int vertex, fragment;
         int success;
         char infoLog[512];
@@ -76,7 +57,7 @@ public:
         if(!success)
         {
             glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+            std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << sourceLegend(vertexSource) << std::endl;
         };
 
         // fragment Shader
@@ -88,27 +69,35 @@ public:
         glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
         if(!success)
         {
-            glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+            glGetShaderInfoLog(fragment, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << sourceLegend(fragmentSource) << std::endl;
         };
 
         /* -------------------------------------------------- */
         // link the shader program
         /* Now combine the shaders into a shader program */
-        ID = glCreateProgram(); // create the program
-        glAttachShader(ID, vertex); // attach the vertex shader
-        glAttachShader(ID, fragment); // attach the fragment shader
-        glLinkProgram(ID); // link the shaders together within the program
+        unsigned int program = glCreateProgram(); // create the program
+        glAttachShader(program, vertex); // attach the vertex shader
+        glAttachShader(program, fragment); // attach the fragment shader
+        glLinkProgram(program); // link the shaders together within the program
 
         glDeleteShader(vertex);
         glDeleteShader(fragment); // delete the shaders post linking
 
-        glGetShaderiv(ID, GL_LINK_STATUS, &success);
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
         if(!success)
         {
-            glGetProgramInfoLog(ID, 512, NULL, infoLog);
+            glGetProgramInfoLog(program, 512, NULL, infoLog);
             std::cout << "ERROR::SHADER PROGRAM::LINK FAILED\n" << infoLog << std::endl;
         }
+        return program;
+    }
+
+    // which file each source number in a compile error refers to
+    static std::string sourceLegend(const ShaderSource &source) {
+        std::string legend;
+        for (unsigned int i = 0; i < source.files.size(); i++) legend += "  source " + std::to_string(i) + ": " + source.files[i] + "\n";
+        return legend;
     }
 
     // activate the shader
@@ -119,6 +108,14 @@ public:
         glDeleteProgram(ID);
     }
 
+    // point a uniform block at a binding point, where a UniformBuffer can be bound
+    void bindUniformBlock(const std::string &name, unsigned int binding) const
+    {
+        unsigned int index = glGetUniformBlockIndex(ID, name.c_str());
+        if (index == GL_INVALID_INDEX) return; // the block isn't used by this program
+        glUniformBlockBinding(ID, index, binding);
+    }
+
     // uniform setting functions - needed as no function overloading in OpenGL
     void setBool(const std::string &name, bool value) const
     {         
@@ -132,6 +129,18 @@ public:
     { 
         glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
     } 
+    void setVec2(const std::string &name, glm::vec2 value) const
+    { 
+        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value)); 
+    } 
+    void setVec3(const std::string &name, glm::vec3 value) const
+    { 
+        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value)); 
+    } 
+    void setVec4Array(const std::string &name, const glm::vec4 values[], unsigned int count) const
+    { 
+        glUniform4fv(glGetUniformLocation(ID, name.c_str()), count, glm::value_ptr(values[0])); 
+    } 
     void setMat4(const std::string &name, glm::mat4 trans) const
     { 
         glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(trans)); 
@@ -0,0 +1,185 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include "shader.h" // glad is included here
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* glad is generated for 3.3, so the GL 4.1 program binary pieces are declared here and loaded at runtime */
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+/* Every shader program the app uses, built the first time it is asked for, so permutations nobody draws with are never compiled.
+A permutation is a vertex and fragment file plus a set of defines, see preprocessShader.
+Its files can be read and preprocessed ahead of time on any thread with preload(), leaving get() only the GL work.
+
+Given a directory, linked programs are also saved there as driver binaries, keyed by a hash of their preprocessed source
+and the driver, and the next run loads them instead of compiling. A binary the driver rejects is simply rebuilt. */
+class ShaderCache {
+    map<string, Shader> programs;
+    string diskDir;
+
+    struct Sources {
+        ShaderSource vertex, fragment;
+    };
+    map<string, Sources> preloaded; // read by preload(), waiting for get()
+    mutex preloadLock;
+
+    PFNGLGETPROGRAMBINARYPROC getProgramBinary = nullptr;
+    PFNGLPROGRAMBINARYPROC programBinary = nullptr;
+    PFNGLPROGRAMPARAMETERIPROC programParameteri = nullptr;
+
+    /* stats, so the cost of shader building shows up in the startup report */
+    unsigned int numCompiled = 0, numLoaded = 0;
+
+    static uint64_t hash(const string &text, uint64_t seed = 1469598103934665603ull) {
+        /* FNV-1a, stable between runs and compilers unlike std::hash */
+        uint64_t value = seed;
+        for (unsigned char c: text) value = (value ^ c) * 1099511628211ull;
+        return value;
+    }
+
+    string binaryPath(const ShaderSource &vertex, const ShaderSource &fragment) const {
+        /* a new driver or new source gives a new file, so stale binaries are never loaded */
+        string driver = string((const char*)glGetString(GL_RENDERER)) + (const char*)glGetString(GL_VERSION);
+        uint64_t key = hash(fragment.code, hash(vertex.code, hash(driver)));
+
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return diskDir + "/" + name;
+    }
+
+    unsigned int load(const string &path) {
+        /* returns a linked program from a saved binary, or 0 */
+        ifstream file(path, ios::binary);
+        if (!file) return 0;
+
+        GLenum format;
+        if (!file.read((char*)&format, sizeof(format))) return 0;
+        vector<char> binary((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        if (binary.empty()) return 0;
+
+        unsigned int program = glCreateProgram();
+        programBinary(program, format, binary.data(), (GLsizei)binary.size());
+        int success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+
+    void save(unsigned int program, const string &path) {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) return;
+
+        vector<char> binary(length);
+        GLenum format;
+        getProgramBinary(program, length, nullptr, &format, binary.data());
+
+        ofstream file(path, ios::binary);
+        if (!file) {
+            cout << "Shader cache: could not write " << path << endl;
+            return;
+        }
+        file.write((const char*)&format, sizeof(format));
+        file.write(binary.data(), binary.size());
+    }
+
+public:
+    ShaderCache(GLADloadproc loader = nullptr, const string &diskDirIn = "") {
+        useDisk(loader, diskDirIn);
+    }
+
+    void useDisk(GLADloadproc loader, const string &diskDirIn) {
+        /* only cache to disk if the driver can hand back binaries at all, needs a current context */
+        if (!loader || diskDirIn.empty()) return;
+
+        GLint numFormats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+        getProgramBinary = (PFNGLGETPROGRAMBINARYPROC)loader("glGetProgramBinary");
+        programBinary = (PFNGLPROGRAMBINARYPROC)loader("glProgramBinary");
+        programParameteri = (PFNGLPROGRAMPARAMETERIPROC)loader("glProgramParameteri");
+        if (numFormats > 0 && getProgramBinary && programBinary && programParameteri) diskDir = diskDirIn;
+        else cout << "Shader cache: the driver has no program binary formats, caching in memory only" << endl;
+    }
+
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache& operator=(const ShaderCache&) = delete;
+
+    void preload(const string &vertexPath, const string &fragmentPath, const ShaderDefines &defines = {}) {
+        /* reads and preprocesses a permutation's files, without needing a GL context */
+        Sources sources{preprocessShader(vertexPath, defines), preprocessShader(fragmentPath, defines)};
+        lock_guard<mutex> guard(preloadLock);
+        preloaded[shaderPermutationKey(vertexPath, fragmentPath, defines)] = std::move(sources);
+    }
+
+    Shader& get(const string &vertexPath, const string &fragmentPath, const ShaderDefines &defines = {}) {
+        string key = shaderPermutationKey(vertexPath, fragmentPath, defines);
+        auto found = programs.find(key);
+        if (found != programs.end()) return found->second;
+
+        Sources sources;
+        bool wasPreloaded = false;
+        {
+            lock_guard<mutex> guard(preloadLock);
+            auto ready = preloaded.find(key);
+            if (ready != preloaded.end()) {
+                sources = std::move(ready->second);
+                preloaded.erase(ready);
+                wasPreloaded = true;
+            }
+        }
+        if (!wasPreloaded) sources = {preprocessShader(vertexPath, defines), preprocessShader(fragmentPath, defines)};
+        const ShaderSource &vertex = sources.vertex, &fragment = sources.fragment;
+
+        unsigned int program = 0;
+        string path;
+        if (!diskDir.empty() && vertex.ok && fragment.ok) {
+            path = binaryPath(vertex, fragment);
+            program = load(path);
+        }
+
+        if (program) {
+            numLoaded ++;
+        } else {
+            program = Shader::build(vertex, fragment);
+            numCompiled ++;
+            if (!path.empty()) {
+                /* the hint only has to be set before linking for the binary to be kept, relinking picks it up */
+                programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+                glLinkProgram(program);
+                save(program, path);
+            }
+        }
+
+        return programs.emplace(key, Shader(program)).first->second;
+    }
+
+    unsigned int compiled() const { return numCompiled; }
+    unsigned int loadedFromDisk() const { return numLoaded; }
+    size_t size() const { return programs.size(); }
+
+    void del() {
+        for (auto &program: programs) program.second.del();
+        programs.clear();
+    }
+};
+
+#endif
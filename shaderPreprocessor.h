@@ -0,0 +1,124 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* Defines injected into a shader, name to value (an empty value just defines the name).
+Kept sorted, so the same set always gives the same permutation key. */
+using ShaderDefines = map<string, string>;
+
+/* A shader's source ready for glShaderSource, with every #include expanded */
+struct ShaderSource {
+    string code;
+    vector<string> files; // the files pulled in, indexed by the source number in #line directives and compile errors
+    bool ok = true;
+};
+
+namespace shaderPreprocessor {
+    inline string directoryOf(const string &path) {
+        size_t slash = path.find_last_of("/\\");
+        return slash == string::npos ? "" : path.substr(0, slash + 1);
+    }
+
+    inline bool readFile(const string &path, string &contents) {
+        ifstream file(path);
+        if (!file) {
+            cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << endl;
+            return false;
+        }
+        stringstream stream;
+        stream << file.rdbuf();
+        contents = stream.str();
+        return true;
+    }
+
+    inline bool parseInclude(const string &line, string &name) {
+        /* matches #include "name" with any whitespace around the tokens */
+        size_t hash = line.find_first_not_of(" \t");
+        if (hash == string::npos || line[hash] != '#') return false;
+        size_t word = line.find_first_not_of(" \t", hash + 1);
+        if (word == string::npos || line.compare(word, 7, "include") != 0) return false;
+
+        size_t open = line.find('"', word + 7), close = open == string::npos ? open : line.find('"', open + 1);
+        if (close == string::npos) return false;
+        name = line.substr(open + 1, close - open - 1);
+        return true;
+    }
+
+    inline void expand(const string &path, ShaderSource &source, vector<string> &stack) {
+        for (const string &open: stack) {
+            if (open == path) {
+                cout << "ERROR::SHADER::INCLUDE_CYCLE " << path << endl;
+                source.ok = false;
+                return;
+            }
+        }
+
+        string contents;
+        if (!readFile(path, contents)) {
+            source.ok = false;
+            return;
+        }
+
+        unsigned int number = (unsigned int)source.files.size();
+        source.files.push_back(path);
+        stack.push_back(path);
+
+        istringstream lines(contents);
+        string line;
+        unsigned int lineNumber = 0;
+        bool topLevel = stack.size() == 1;
+        if (!topLevel) source.code += "#line 1 " + to_string(number) + "\n";
+        while (getline(lines, line)) {
+            lineNumber ++;
+            string name;
+            if (parseInclude(line, name)) {
+                /* each file is pasted in at most once per shader, like an include guard */
+                string includePath = directoryOf(path) + name;
+                bool seen = false;
+                for (const string &file: source.files) seen = seen || file == includePath;
+                if (!seen) expand(includePath, source, stack);
+                source.code += "#line " + to_string(lineNumber + 1) + " " + to_string(number) + "\n";
+                continue;
+            }
+            if (!topLevel && line.rfind("#version", 0) == 0) line = ""; // only the top file says which version, blanked to keep the line numbers
+            source.code += line + "\n";
+        }
+        stack.pop_back();
+    }
+}
+
+/* Reads a shader, pasting in #include "file" (relative to the including file) and adding defines after the #version line.
+#line directives keep compile errors pointing at the right file, see ShaderSource::files. */
+inline ShaderSource preprocessShader(const string &path, const ShaderDefines &defines = {}) {
+    ShaderSource expanded;
+    vector<string> stack;
+    shaderPreprocessor::expand(path, expanded, stack);
+    if (!expanded.ok) return expanded;
+
+    /* the defines have to come after #version, which has to come first */
+    ShaderSource source;
+    source.files = expanded.files;
+    size_t versionEnd = expanded.code.rfind("#version", 0) == 0 ? expanded.code.find('\n') + 1 : 0;
+    source.code = expanded.code.substr(0, versionEnd);
+    for (const auto &define: defines) source.code += "#define " + define.first + " " + define.second + "\n";
+    source.code += "#line " + to_string(versionEnd ? 2 : 1) + " 0\n";
+    source.code += expanded.code.substr(versionEnd);
+    return source;
+}
+
+/* The key a shader permutation is cached under: both files and every define */
+inline string shaderPermutationKey(const string &vertexPath, const string &fragmentPath, const ShaderDefines &defines) {
+    string key = vertexPath + "|" + fragmentPath;
+    for (const auto &define: defines) key += "|" + define.first + "=" + define.second;
+    return key;
+}
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+/* A 4 wide float vector, on whatever vector unit every CPU of the target has: NEON on arm64, SSE2 on x86-64, plain floats otherwise.
+Both are part of their base instruction sets, so nothing needs building with extra flags or checking for at runtime.
+loadBytes4 and storeBytes4 convert four bytes (eg. an RGBA8 pixel) to floats and back, rounding and saturating.
+less4 gives 1 in the lanes where a < b and 0 elsewhere, to weight by rather than branch on, and rsqrt4 is an estimate good to about 12 bits.
+bits128 is two 64 bit words side by side, for bitwise logic on 128 bits at once, with shifts that stay within each word.
+double2 is two doubles, for when float runs out of precision, with the same arithmetic as float4. */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SIMD_NEON 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SIMD_SSE 1
+#endif
+#include <cstdint>
+#include <cstring>
+#include <math.h>
+
+struct float4 {
+#if SIMD_NEON
+    float32x4_t v;
+#elif SIMD_SSE
+    __m128 v;
+#else
+    float v[4];
+#endif
+};
+
+struct double2 {
+#if SIMD_NEON
+    float64x2_t v;
+#elif SIMD_SSE
+    __m128d v;
+#else
+    double v[2];
+#endif
+};
+
+struct bits128 {
+#if SIMD_NEON
+    uint64x2_t v;
+#elif SIMD_SSE
+    __m128i v;
+#else
+    uint64_t v[2];
+#endif
+};
+
+inline const char* simdName() {
+#if SIMD_NEON
+    return "NEON";
+#elif SIMD_SSE
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+#if SIMD_NEON
+
+inline float4 load4(const float* p) { return {vld1q_f32(p)}; }
+inline void store4(float* p, float4 a) { vst1q_f32(p, a.v); }
+inline float4 splat4(float x) { return {vdupq_n_f32(x)}; }
+inline float4 operator+(float4 a, float4 b) { return {vaddq_f32(a.v, b.v)}; }
+inline float4 operator-(float4 a, float4 b) { return {vsubq_f32(a.v, b.v)}; }
+inline float4 operator*(float4 a, float4 b) { return {vmulq_f32(a.v, b.v)}; }
+inline float4 operator/(float4 a, float4 b) { return {vdivq_f32(a.v, b.v)}; }
+inline float4 operator-(float4 a) { return {vnegq_f32(a.v)}; }
+inline float4 min4(float4 a, float4 b) { return {vminq_f32(a.v, b.v)}; }
+inline float4 max4(float4 a, float4 b) { return {vmaxq_f32(a.v, b.v)}; }
+inline float4 less4(float4 a, float4 b) { return {vreinterpretq_f32_u32(vandq_u32(vcltq_f32(a.v, b.v), vreinterpretq_u32_f32(vdupq_n_f32(1.0f))))}; }
+inline float4 rsqrt4(float4 a) {
+    float32x4_t estimate = vrsqrteq_f32(a.v); // about 8 bits, and a Newton step doubles that
+    return {vmulq_f32(estimate, vrsqrtsq_f32(vmulq_f32(a.v, estimate), estimate))};
+}
+inline float sum4(float4 a) { return vaddvq_f32(a.v); }
+
+inline float4 loadBytes4(const uint8_t* p) {
+    uint32_t word;
+    memcpy(&word, p, 4);
+    uint16x8_t wide = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(word)));
+    return {vcvtq_f32_u32(vmovl_u16(vget_low_u16(wide)))};
+}
+inline void storeBytes4(uint8_t* p, float4 a) {
+    uint16x4_t narrow = vqmovn_u32(vcvtnq_u32_f32(a.v)); // rounds to nearest, negatives become 0
+    uint32_t word = vget_lane_u32(vreinterpret_u32_u8(vqmovn_u16(vcombine_u16(narrow, narrow))), 0);
+    memcpy(p, &word, 4);
+}
+
+inline void transpose4(float4 &a, float4 &b, float4 &c, float4 &d) {
+    float32x4x2_t ab = vtrnq_f32(a.v, b.v), cd = vtrnq_f32(c.v, d.v);
+    a.v = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+    b.v = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+    c.v = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+    d.v = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+
+inline double2 load2(const double* p) { return {vld1q_f64(p)}; }
+inline void store2(double* p, double2 a) { vst1q_f64(p, a.v); }
+inline double2 splat2(double x) { return {vdupq_n_f64(x)}; }
+inline double2 operator+(double2 a, double2 b) { return {vaddq_f64(a.v, b.v)}; }
+inline double2 operator-(double2 a, double2 b) { return {vsubq_f64(a.v, b.v)}; }
+inline double2 operator*(double2 a, double2 b) { return {vmulq_f64(a.v, b.v)}; }
+inline double2 less2(double2 a, double2 b) { return {vreinterpretq_f64_u64(vandq_u64(vcltq_f64(a.v, b.v), vreinterpretq_u64_f64(vdupq_n_f64(1.0))))}; }
+inline double sum2(double2 a) { return vaddvq_f64(a.v); }
+
+inline bits128 loadBits(const uint64_t* p) { return {vld1q_u64(p)}; }
+inline void storeBits(uint64_t* p, bits128 a) { vst1q_u64(p, a.v); }
+inline bits128 operator&(bits128 a, bits128 b) { return {vandq_u64(a.v, b.v)}; }
+inline bits128 operator|(bits128 a, bits128 b) { return {vorrq_u64(a.v, b.v)}; }
+inline bits128 operator^(bits128 a, bits128 b) { return {veorq_u64(a.v, b.v)}; }
+inline bits128 operator~(bits128 a) { return {vreinterpretq_u64_u32(vmvnq_u32(vreinterpretq_u32_u64(a.v)))}; }
+template <int n> inline bits128 shiftLeft(bits128 a) { return {vshlq_n_u64(a.v, n)}; }
+template <int n> inline bits128 shiftRight(bits128 a) { return {vshrq_n_u64(a.v, n)}; }
+
+#elif SIMD_SSE
+
+inline float4 load4(const float* p) { return {_mm_loadu_ps(p)}; }
+inline void store4(float* p, float4 a) { _mm_storeu_ps(p, a.v); }
+inline float4 splat4(float x) { return {_mm_set1_ps(x)}; }
+inline float4 operator+(float4 a, float4 b) { return {_mm_add_ps(a.v, b.v)}; }
+inline float4 operator-(float4 a, float4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline float4 operator*(float4 a, float4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline float4 operator/(float4 a, float4 b) { return {_mm_div_ps(a.v, b.v)}; }
+inline float4 operator-(float4 a) { return {_mm_xor_ps(a.v, _mm_set1_ps(-0.0f))}; }
+inline float4 min4(float4 a, float4 b) { return {_mm_min_ps(a.v, b.v)}; }
+inline float4 max4(float4 a, float4 b) { return {_mm_max_ps(a.v, b.v)}; }
+inline float4 less4(float4 a, float4 b) { return {_mm_and_ps(_mm_cmplt_ps(a.v, b.v), _mm_set1_ps(1.0f))}; }
+inline float4 rsqrt4(float4 a) { return {_mm_rsqrt_ps(a.v)}; }
+inline float sum4(float4 a) {
+    __m128 pairs = _mm_add_ps(a.v, _mm_movehl_ps(a.v, a.v));
+    return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+}
+
+inline float4 loadBytes4(const uint8_t* p) {
+    int word;
+    memcpy(&word, p, 4);
+    __m128i zero = _mm_setzero_si128();
+    __m128i wide = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(word), zero), zero);
+    return {_mm_cvtepi32_ps(wide)};
+}
+inline void storeBytes4(uint8_t* p, float4 a) {
+    __m128i whole = _mm_cvtps_epi32(a.v); // rounds to nearest
+    __m128i narrow = _mm_packs_epi32(whole, whole);
+    int word = _mm_cvtsi128_si32(_mm_packus_epi16(narrow, narrow));
+    memcpy(p, &word, 4);
+}
+
+inline void transpose4(float4 &a, float4 &b, float4 &c, float4 &d) {
+    _MM_TRANSPOSE4_PS(a.v, b.v, c.v, d.v);
+}
+
+inline double2 load2(const double* p) { return {_mm_loadu_pd(p)}; }
+inline void store2(double* p, double2 a) { _mm_storeu_pd(p, a.v); }
+inline double2 splat2(double x) { return {_mm_set1_pd(x)}; }
+inline double2 operator+(double2 a, double2 b) { return {_mm_add_pd(a.v, b.v)}; }
+inline double2 operator-(double2 a, double2 b) { return {_mm_sub_pd(a.v, b.v)}; }
+inline double2 operator*(double2 a, double2 b) { return {_mm_mul_pd(a.v, b.v)}; }
+inline double2 less2(double2 a, double2 b) { return {_mm_and_pd(_mm_cmplt_pd(a.v, b.v), _mm_set1_pd(1.0))}; }
+inline double sum2(double2 a) { return _mm_cvtsd_f64(_mm_add_sd(a.v, _mm_unpackhi_pd(a.v, a.v))); }
+
+inline bits128 loadBits(const uint64_t* p) { return {_mm_loadu_si128((const __m128i*)p)}; }
+inline void storeBits(uint64_t* p, bits128 a) { _mm_storeu_si128((__m128i*)p, a.v); }
+inline bits128 operator&(bits128 a, bits128 b) { return {_mm_and_si128(a.v, b.v)}; }
+inline bits128 operator|(bits128 a, bits128 b) { return {_mm_or_si128(a.v, b.v)}; }
+inline bits128 operator^(bits128 a, bits128 b) { return {_mm_xor_si128(a.v, b.v)}; }
+inline bits128 operator~(bits128 a) { return {_mm_xor_si128(a.v, _mm_set1_epi32(-1))}; }
+template <int n> inline bits128 shiftLeft(bits128 a) { return {_mm_slli_epi64(a.v, n)}; }
+template <int n> inline bits128 shiftRight(bits128 a) { return {_mm_srli_epi64(a.v, n)}; }
+
+#else
+
+inline float4 load4(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+inline void store4(float* p, float4 a) { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+inline float4 splat4(float x) { return {{x, x, x, x}}; }
+inline float4 operator+(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+inline float4 operator-(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+inline float4 operator*(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+inline float4 operator/(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] /= b.v[i]; return a; }
+inline float4 operator-(float4 a) { for (int i = 0; i < 4; i++) a.v[i] = -a.v[i]; return a; }
+inline float4 min4(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return a; }
+inline float4 max4(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return a; }
+inline float4 less4(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] = a.v[i] < b.v[i] ? 1.0f : 0.0f; return a; }
+inline float4 rsqrt4(float4 a) { for (int i = 0; i < 4; i++) a.v[i] = 1.0f / sqrtf(a.v[i]); return a; }
+inline float sum4(float4 a) { return a.v[0] + a.v[1] + a.v[2] + a.v[3]; }
+
+inline float4 loadBytes4(const uint8_t* p) { return {{(float)p[0], (float)p[1], (float)p[2], (float)p[3]}}; }
+inline void storeBytes4(uint8_t* p, float4 a) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(a.v[i] <= 0.0f ? 0 : a.v[i] >= 255.0f ? 255 : (int)(a.v[i] + 0.5f));
+}
+
+inline void transpose4(float4 &a, float4 &b, float4 &c, float4 &d) {
+    float4 rows[4] = {a, b, c, d}, columns[4];
+    for (int i = 0; i < 4; i++) for (int j = 0; j < 4; j++) columns[i].v[j] = rows[j].v[i];
+    a = columns[0]; b = columns[1]; c = columns[2]; d = columns[3];
+}
+
+inline double2 load2(const double* p) { return {{p[0], p[1]}}; }
+inline void store2(double* p, double2 a) { p[0] = a.v[0]; p[1] = a.v[1]; }
+inline double2 splat2(double x) { return {{x, x}}; }
+inline double2 operator+(double2 a, double2 b) { return {{a.v[0] + b.v[0], a.v[1] + b.v[1]}}; }
+inline double2 operator-(double2 a, double2 b) { return {{a.v[0] - b.v[0], a.v[1] - b.v[1]}}; }
+inline double2 operator*(double2 a, double2 b) { return {{a.v[0] * b.v[0], a.v[1] * b.v[1]}}; }
+inline double2 less2(double2 a, double2 b) { return {{a.v[0] < b.v[0] ? 1.0 : 0.0, a.v[1] < b.v[1] ? 1.0 : 0.0}}; }
+inline double sum2(double2 a) { return a.v[0] + a.v[1]; }
+
+inline bits128 loadBits(const uint64_t* p) { return {{p[0], p[1]}}; }
+inline void storeBits(uint64_t* p, bits128 a) { p[0] = a.v[0]; p[1] = a.v[1]; }
+inline bits128 operator&(bits128 a, bits128 b) { return {{a.v[0] & b.v[0], a.v[1] & b.v[1]}}; }
+inline bits128 operator|(bits128 a, bits128 b) { return {{a.v[0] | b.v[0], a.v[1] | b.v[1]}}; }
+inline bits128 operator^(bits128 a, bits128 b) { return {{a.v[0] ^ b.v[0], a.v[1] ^ b.v[1]}}; }
+inline bits128 operator~(bits128 a) { return {{~a.v[0], ~a.v[1]}}; }
+template <int n> inline bits128 shiftLeft(bits128 a) { return {{a.v[0] << n, a.v[1] << n}}; }
+template <int n> inline bits128 shiftRight(bits128 a) { return {{a.v[0] >> n, a.v[1] >> n}}; }
+
+#endif
+
+#endif
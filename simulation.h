@@ -0,0 +1,134 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "tripleBuffer.h"
+#include "timing.h"
+#include "jobSystem.h"
+#include <glm/vec3.hpp>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/* Define attributes for each sine curve */
+struct Curve {
+    float colour = 0.0f;
+    float colorStep = 0.01f;
+    float speed = 0.01f;
+
+    glm::vec3 trans;
+    glm::vec3 transStep;
+
+    Curve (float pos) { 
+        speed = pos / 500;
+        transStep = glm::vec3(speed, speed, speed);
+        trans = glm::vec3(0.0f, -1 + 2.0f * pos, 1.0f * pos);
+    }
+
+    void step() {
+        // update the step
+        if (((trans.x > 1) && (transStep.x > 0)) || ((trans.x < -1) && (transStep.x < 0))) {
+            transStep.x = -transStep.x;
+        } 
+
+        // make the step
+        trans.x += transStep.x;
+    }
+};
+
+/* Everything the renderer needs to draw one frame of curves.
+Packets are copied whole through the queue, so never change once published. */
+struct FramePacket {
+    static const unsigned int maxCurves = 64;
+
+    struct CurveState {
+        glm::vec3 trans;
+        float colour;
+        float amplitude = 1.0f; // how much the sine is scaled up, eg. by the music, see pulseCurves
+    };
+
+    uint64_t tick = 0; // the simulation step this is the result of
+    unsigned int numCurves = 0;
+    CurveState curves[maxCurves];
+};
+
+/* Steps the curves on their own thread at a fixed rate, publishing a FramePacket after each step.
+The render thread takes the newest packet each frame, so a slow swap no longer slows the curves,
+and a slow step no longer delays the swap. Packets go through a TripleBuffer, so however far behind the renderer falls,
+what it takes next is the latest step, and a packet it never got to is simply replaced. */
+class Simulation {
+    vector<Curve> curves;
+    JobSystem* jobs; // steps the curves in parallel once there are enough of them, may be null
+    TripleBuffer<FramePacket> packets;
+
+    thread worker;
+    atomic<bool> running{false};
+
+    const chrono::microseconds tickLength{16667}; // 60 steps per second, the old rate of one per frame
+    uint64_t tick = 0;
+
+    FramePacket snapshot() const {
+        FramePacket packet;
+        packet.tick = tick;
+        packet.numCurves = (unsigned int)min(curves.size(), (size_t)FramePacket::maxCurves);
+        for (unsigned int i = 0; i < packet.numCurves; i++) {
+            packet.curves[i] = {curves[i].trans, curves[i].colour};
+        }
+        return packet;
+    }
+
+    void run() {
+        Clock::time_point nextTick = Clock::now();
+        while (running.load(memory_order_relaxed)) {
+            {
+                ScopedStage stage(stepTimer);
+                parallelFor(jobs, 0, curves.size(), 256, [this](size_t first, size_t last) {
+                    for (size_t i = first; i < last; i++) curves[i].step();
+                });
+                tick ++;
+            }
+            {
+                ScopedStage stage(publishTimer);
+                /* replaces the last packet if the renderer hasn't taken it, it only ever wants the newest */
+                if (!packets.publish(snapshot())) droppedPackets.fetch_add(1, memory_order_relaxed);
+            }
+
+            nextTick += tickLength;
+            this_thread::sleep_until(nextTick);
+        }
+    }
+
+public:
+    StageTimer stepTimer, publishTimer; // written by the simulation thread
+    atomic<uint64_t> droppedPackets{0}; // packets replaced by a newer one before the render thread took them
+
+    Simulation(unsigned int numCurves, JobSystem* jobsIn = nullptr) : jobs(jobsIn) {
+        for (unsigned int i = 0; i < numCurves; i ++) {
+            Curve c((float)i / numCurves);
+
+            curves.emplace_back(c);
+        }
+    }
+
+    FramePacket first() const {
+        /* the state before any steps, for the frames before the first packet arrives */
+        return snapshot();
+    }
+
+    void start() {
+        running = true;
+        worker = thread(&Simulation::run, this);
+    }
+    void stop() {
+        running = false;
+        if (worker.joinable()) worker.join();
+    }
+
+    bool latest(FramePacket &packet) {
+        /* render thread only: replace packet with the newest one published, if there is one */
+        return packets.latest(packet);
+    }
+};
+
+#endif
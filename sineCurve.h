@@ -0,0 +1,461 @@
+#ifndef SINE_CURVE_H
+#define SINE_CURVE_H
+
+#include "VAO.h"
+#include "vertexLayout.h"
+#include "arena.h"
+#include "jobSystem.h"
+#include "spectralWaves.h"
+#include "timing.h"
+#include <glm/gtc/packing.hpp> // glm::packHalf1x16, glm::packSnorm1x16, glm::packSnorm3x10_1x2
+#include <math.h>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <limits>
+#include <sys/resource.h> // getrusage
+
+using namespace std;
+
+/* The shape of the wave: the base sine, drifted in phase, plus an optional travelling ripple */
+struct SineShape {
+    float phase = 0.0f; // phase drift of the base sine, moves every sample
+    float rippleCentre = 0.0f; // x position of the ripple
+    float rippleWidth = 0.1f; // the ripple is exactly zero beyond 3 widths of its centre
+    float rippleAmplitude = 0.0f; // 0 for no ripple
+
+    float height(float x) const {
+        const int x_stretch = 15; // factor we stretch the x-axis
+        float y = sin(x * x_stretch + phase) / 5;
+
+        float d = (x - rippleCentre) / rippleWidth;
+        if (rippleAmplitude != 0.0f && fabs(d) < 3.0f) {
+            y += rippleAmplitude * exp(-d * d) * cos(d * 4.0f);
+        }
+        return y;
+    }
+};
+
+template <typename Shape>
+void writeSineRect(float* vertexArray, int i, unsigned int points, const Shape &shape) {
+    // writes the 6 vertices of the i'th rectangle under the curve to vertexArray
+    // shape is anything with a height(x), a SineShape or a SpectralShape
+    const float x_width = 3.0f;
+
+    // our rectangle goes from (x_1, -1), (x_2, -1), (x_1, y_1), (x_2, y_2)
+    float x_1 = -x_width + 2.0f * x_width * i / points;
+    float x_2 = -x_width + 2.0f * x_width * (i + 1) / points;
+    float y_1 = shape.height(x_1), y_2 = shape.height(x_2);
+
+    // (x_1, -1), (x_2, -1), (x_1, y_1)
+    vertexArray[0] = x_1;
+    vertexArray[1] = y_1;
+    vertexArray[2] = 0.0f;
+
+    vertexArray[3] = x_1;
+    vertexArray[4] = -1.0f;
+    vertexArray[5] = 0.0f;
+
+    vertexArray[6] = x_2;
+    vertexArray[7] = -1.0f;
+    vertexArray[8] = 0.0f;
+
+    // (x_2, y_2), (x_1, y_1), (x_2, -1)
+    vertexArray[9] = x_2;
+    vertexArray[10] = y_2;
+    vertexArray[11] = 0.0f;
+
+    vertexArray[12] = x_1;
+    vertexArray[13] = y_1;
+    vertexArray[14] = 0.0f;
+    
+    vertexArray[15] = x_2;
+    vertexArray[16] = -1.0f;
+    vertexArray[17] = 0.0f;
+}
+
+/* rectangles per job when generating on a job system */
+const size_t sineGrain = 4096;
+
+float* genSineCurve(unsigned int points, unsigned int &vertices, ScratchArena &arena, const SineShape &shape = SineShape(), JobSystem* jobs = nullptr) {
+    // returns a set of triangle vertices that span the area under a sine curve
+    // the vertices live in the arena, so are freed when it is next rewound
+    const int rectangles = points  - 1;
+    const int triangles = rectangles * 2;
+    vertices = triangles * 3;
+
+    const int attributes = 3; 
+
+    float * vertexArray = arena.alloc<float>(vertices * attributes);
+
+    parallelFor(jobs, 0, rectangles, sineGrain, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i ++) {
+            writeSineRect(vertexArray + 18*i, (int)i, points, shape);
+        }
+    });
+
+    return vertexArray;
+
+}
+
+/* The ways a sine curve vertex may be stored in the VBO */
+enum class SineFormat {
+    Float, // vec3 of floats, 12 bytes
+    Half, // vec2 of half floats, 4 bytes
+    ShortNorm, // vec2 of normalized shorts, 4 bytes
+    Packed, // GL_INT_2_10_10_10_REV normalized, 4 bytes
+};
+
+/* Parses a format name as given on the command line, defaulting to floats */
+inline SineFormat parseSineFormat(const string &name) {
+    if (name == "half") return SineFormat::Half;
+    if (name == "short") return SineFormat::ShortNorm;
+    if (name == "packed") return SineFormat::Packed;
+    return SineFormat::Float;
+}
+
+inline const char* sineFormatName(SineFormat format) {
+    switch (format) {
+        case SineFormat::Half: return "half";
+        case SineFormat::ShortNorm: return "short";
+        case SineFormat::Packed: return "packed";
+        default: return "float";
+    }
+}
+
+/* The most samples whose x each get their own value in a format, so no rectangle collapses to nothing.
+The compact formats hold x divided by the curve's half-width, in [-1, 1], so the samples are 2/points apart there,
+and these are the counts that make that a whole number of the format's steps: 1/511 for packed, 1/32767 for short,
+and 1/2048 for half, whose steps are that size just below 1 and finer nearer 0. Floats' steps are too fine to matter */
+inline unsigned int sineFormatMaxPoints(SineFormat format) {
+    switch (format) {
+        case SineFormat::Half: return 4096;
+        case SineFormat::ShortNorm: return 65534;
+        case SineFormat::Packed: return 1022;
+        default: return numeric_limits<unsigned int>::max();
+    }
+}
+
+/* The largest step between the heights a format can hold, over the heights the curve reaches (under 0.5 either way, and -1 at the bottom) */
+inline float sineFormatYStep(SineFormat format) {
+    switch (format) {
+        case SineFormat::Half: return 1.0f / 4096.0f; // half's steps between 0.25 and 0.5
+        case SineFormat::ShortNorm: return 1.0f / 32767.0f;
+        case SineFormat::Packed: return 1.0f / 511.0f;
+        default: return numeric_limits<float>::epsilon() / 4.0f; // float's steps between 0.25 and 0.5
+    }
+}
+
+/* Typed vertices for each format, checked against their layouts when uploaded */
+struct SineVertexFloat { glm::vec3 pos; };
+struct SineVertexHalf { half2 pos; };
+struct SineVertexShort { snorm16x2 pos; };
+struct SineVertexPacked { snorm10x3_2 pos; };
+
+using SineLayoutFloat = VertexLayout<Attr<glm::vec3, Position>>;
+using SineLayoutHalf = VertexLayout<Attr<half2, Position>>;
+using SineLayoutShort = VertexLayout<Attr<snorm16x2, Position>>;
+using SineLayoutPacked = VertexLayout<Attr<snorm10x3_2, Position>>;
+
+/* Encode one point of the curve into each vertex type */
+/* normalized formats only span [-1, 1], so x arrives already divided by the curve's half-width */
+inline void encodeSine(SineVertexFloat &out, float x, float y) { out.pos = glm::vec3(x, y, 0.0f); }
+inline void encodeSine(SineVertexHalf &out, float x, float y) { out.pos = {glm::packHalf1x16(x), glm::packHalf1x16(y)}; }
+inline void encodeSine(SineVertexShort &out, float x, float y) { out.pos = {(int16_t)glm::packSnorm1x16(x), (int16_t)glm::packSnorm1x16(y)}; }
+inline void encodeSine(SineVertexPacked &out, float x, float y) { out.pos = {glm::packSnorm3x10_1x2(glm::vec4(x, y, 0.0f, 1.0f))}; } // w = 1 so it reads back as (x, y, 0, 1)
+
+/* A sine curve packed into one of the compact vertex formats */
+struct SineMesh {
+    unsigned char* data = nullptr; // the packed vertices, owned by the arena they were generated in
+    unsigned int numVertices = 0;
+    unsigned int points = 0; // samples along the curve, there is one rectangle between each pair
+    unsigned int stride = 0; // bytes per vertex
+    SineFormat format = SineFormat::Float;
+    glm::vec3 scale = glm::vec3(1.0f); // scale the vertex shader must apply to undo normalization
+
+    /* view the packed bytes as the vertex type of the mesh's format */
+    template <typename Vertex>
+    std::span<const Vertex> vertices() const {
+        return std::span<const Vertex>(reinterpret_cast<const Vertex*>(data), numVertices);
+    }
+};
+
+template <typename Vertex>
+void packSine(SineMesh &mesh, unsigned int points, float x_scale, ScratchArena &arena, JobSystem* jobs) {
+    // re-encodes genSineCurve's (x, y, z) floats as Vertex
+    // the packed vertices are allocated first, so the floats can be rewound straight after
+    mesh.numVertices = (points - 1) * 6;
+    mesh.stride = sizeof(Vertex);
+    Vertex* out = arena.alloc<Vertex>(mesh.numVertices);
+    mesh.data = reinterpret_cast<unsigned char*>(out);
+
+    ArenaScope scratch(arena);
+    const float* floats = genSineCurve(points, mesh.numVertices, arena, SineShape(), jobs);
+    parallelFor(jobs, 0, mesh.numVertices, 6 * sineGrain, [&](size_t first, size_t last) {
+        for (size_t v = first; v < last; v++) {
+            encodeSine(out[v], floats[3*v] / x_scale, floats[3*v + 1]);
+        }
+    });
+}
+
+SineMesh genSineCurvePacked(unsigned int points, SineFormat format, ScratchArena &arena, JobSystem* jobs = nullptr) {
+    // returns the sine curve from genSineCurve, re-encoded in the given format
+    // z is always 0 so the compact formats drop it, and the shader's vec3 input fills it back in
+    // points is capped at what the format can tell apart in x, see sineFormatMaxPoints
+    points = min(points, sineFormatMaxPoints(format));
+    SineMesh mesh;
+    mesh.format = format;
+    mesh.points = points;
+
+    const float x_width = 3.0f;
+
+    switch (format) {
+        case SineFormat::Float:
+            /* already in the right format, so no second copy is needed */
+            mesh.data = reinterpret_cast<unsigned char*>(genSineCurve(points, mesh.numVertices, arena, SineShape(), jobs));
+            mesh.stride = sizeof(SineVertexFloat);
+            break;
+        case SineFormat::Half: packSine<SineVertexHalf>(mesh, points, x_width, arena, jobs); break;
+        case SineFormat::ShortNorm: packSine<SineVertexShort>(mesh, points, x_width, arena, jobs); break;
+        case SineFormat::Packed: packSine<SineVertexPacked>(mesh, points, x_width, arena, jobs); break;
+    }
+    if (format != SineFormat::Float) {
+        mesh.scale = glm::vec3(x_width, 1.0f, 1.0f);
+    }
+
+    return mesh;
+}
+
+/* A run of the mesh's rectangles, with the x range it covers before translation */
+struct SineChunk {
+    unsigned int firstVertex, numVertices;
+    float xMin, xMax;
+};
+
+vector<SineChunk> chunkSineMesh(const SineMesh &mesh, unsigned int numChunks = 32, unsigned int minRectsPerChunk = 16) {
+    // splits the mesh into runs of rectangles, so draws can skip the runs that are off screen
+    // the runs are a fixed fraction of the curve's width whatever its samples, so culling works as well for the capped compact formats,
+    // unless that would leave fewer than minRectsPerChunk in each, when there are fewer runs
+    // x is in the curve's own units, ie. after any normalization is undone
+    const float x_width = 3.0f;
+    const unsigned int rectangles = mesh.points - 1;
+    const unsigned int rectsPerChunk = max((rectangles + numChunks - 1) / numChunks, minRectsPerChunk);
+
+    vector<SineChunk> chunks;
+    for (unsigned int first = 0; first < rectangles; first += rectsPerChunk) {
+        unsigned int last = min(first + rectsPerChunk, rectangles);
+
+        SineChunk chunk;
+        chunk.firstVertex = 6 * first;
+        chunk.numVertices = 6 * (last - first);
+        chunk.xMin = -x_width + 2.0f * x_width * first / mesh.points;
+        chunk.xMax = -x_width + 2.0f * x_width * last / mesh.points;
+        chunks.push_back(chunk);
+    }
+    return chunks;
+}
+
+void cullSineChunks(const vector<SineChunk> &chunks, float transX, vector<GLint> &firsts, vector<GLsizei> &counts) {
+    // gathers the chunks overlapping clip space x in [-1, 1] once translated by transX, merging neighbours into one range
+    firsts.clear();
+    counts.clear();
+    for (const SineChunk &chunk: chunks) {
+        if (chunk.xMax + transX < -1.0f || chunk.xMin + transX > 1.0f) continue;
+
+        if (!firsts.empty() && (GLuint)(firsts.back() + counts.back()) == chunk.firstVertex) {
+            counts.back() += chunk.numVertices;
+        } else {
+            firsts.push_back(chunk.firstVertex);
+            counts.push_back(chunk.numVertices);
+        }
+    }
+}
+
+/* Points the bound VAO's attributes at the bound VBO, laid out for a sine mesh format */
+void applySineLayout(SineFormat format) {
+    switch (format) {
+        case SineFormat::Float: SineLayoutFloat::apply(); break;
+        case SineFormat::Half: SineLayoutHalf::apply(); break;
+        case SineFormat::ShortNorm: SineLayoutShort::apply(); break;
+        case SineFormat::Packed: SineLayoutPacked::apply(); break;
+    }
+}
+
+/* Uploads a packed sine mesh with the compile-time layout of its format */
+void uploadSineMesh(MyVAO &vao, const SineMesh &mesh, GLenum usage = GL_STATIC_DRAW) {
+    switch (mesh.format) {
+        case SineFormat::Float: vao.addData<SineLayoutFloat>(mesh.vertices<SineVertexFloat>(), usage); break;
+        case SineFormat::Half: vao.addData<SineLayoutHalf>(mesh.vertices<SineVertexHalf>(), usage); break;
+        case SineFormat::ShortNorm: vao.addData<SineLayoutShort>(mesh.vertices<SineVertexShort>(), usage); break;
+        case SineFormat::Packed: vao.addData<SineLayoutPacked>(mesh.vertices<SineVertexPacked>(), usage); break;
+    }
+}
+
+template <typename Vertex, typename Shape>
+void regenSineRects(SineMesh &mesh, unsigned int firstRect, unsigned int lastRect, const Shape &shape, ScratchArena &arena, JobSystem* jobs) {
+    // rewrites rectangles [firstRect, lastRect) of the mesh in place for a new shape
+    ArenaScope scratch(arena);
+    float* floats = arena.alloc<float>(18 * (lastRect - firstRect));
+    Vertex* out = reinterpret_cast<Vertex*>(mesh.data) + 6 * firstRect;
+
+    parallelFor(jobs, firstRect, lastRect, sineGrain, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            writeSineRect(floats + 18 * (i - firstRect), (int)i, mesh.points, shape);
+        }
+        for (size_t v = 6 * (first - firstRect); v < 6 * (last - firstRect); v++) {
+            encodeSine(out[v], floats[3*v] / mesh.scale.x, floats[3*v + 1]);
+        }
+    });
+}
+
+template <typename Shape>
+void regenSineMesh(SineMesh &mesh, unsigned int firstRect, unsigned int lastRect, const Shape &shape, ScratchArena &arena, JobSystem* jobs = nullptr) {
+    switch (mesh.format) {
+        case SineFormat::Float: regenSineRects<SineVertexFloat, Shape>(mesh, firstRect, lastRect, shape, arena, jobs); break;
+        case SineFormat::Half: regenSineRects<SineVertexHalf, Shape>(mesh, firstRect, lastRect, shape, arena, jobs); break;
+        case SineFormat::ShortNorm: regenSineRects<SineVertexShort, Shape>(mesh, firstRect, lastRect, shape, arena, jobs); break;
+        case SineFormat::Packed: regenSineRects<SineVertexPacked, Shape>(mesh, firstRect, lastRect, shape, arena, jobs); break;
+    }
+}
+
+/* Animates the shape of a sine mesh, regenerating and uploading only the rectangles that change.
+A phase drift moves every sample so always re-uploads the whole mesh,
+while a travelling ripple only touches the rectangles it leaves and enters.
+Spectral waves replace the sine with the heights of SpectralWaves, which also move every sample. */
+class SineWaveAnimator {
+    SineShape shape;
+    bool drift, ripple;
+    unique_ptr<SpectralWaves> spectral;
+
+    const float driftSpeed = 0.02f; // radians per frame
+    const float rippleSpeed = 0.01f; // x per frame
+
+    /* stats for the upload report */
+    size_t uploadedBytes = 0, uploadedRanges = 0;
+    unsigned int frames = 0;
+    StageTimer synthesisTimer;
+
+    void addRectsNear(DirtyRanges &rects, float centre, unsigned int points) const {
+        /* the rectangles the ripple overlaps when centred here, with one spare each side for rounding */
+        const float x_width = 3.0f;
+        float reach = 3.0f * shape.rippleWidth;
+        float first = (centre - reach + x_width) * points / (2.0f * x_width) - 1.0f;
+        float last = (centre + reach + x_width) * points / (2.0f * x_width) + 2.0f;
+
+        first = max(first, 0.0f);
+        last = min(last, (float)(points - 1));
+        if (first < last) rects.add((unsigned int)first, (unsigned int)last);
+    }
+
+public:
+    /* spectralSize is the FFT size of spectral waves, 0 for none */
+    SineWaveAnimator(bool driftIn, bool rippleIn, unsigned int spectralSize = 0) : drift(driftIn), ripple(rippleIn) {
+        if (ripple) {
+            shape.rippleAmplitude = 0.15f;
+            shape.rippleCentre = -3.0f;
+        }
+        if (spectralSize) spectral = make_unique<SpectralWaves>(spectralSize);
+    }
+
+    bool animated() const { return drift || ripple || spectral; }
+
+    DirtyRanges advance(unsigned int points, JobSystem* jobs = nullptr) {
+        /* moves the shape on a frame, returning the rectangles of a mesh with this many points that changed */
+        const unsigned int numRects = points - 1;
+        const float x_width = 3.0f;
+
+        SineShape next = shape;
+        DirtyRanges rects; // coalesced rectangle ranges to regenerate
+
+        if (drift) {
+            next.phase += driftSpeed;
+            rects.add(0, numRects);
+        }
+        if (spectral) {
+            ScopedStage stage(synthesisTimer);
+            spectral->advance(jobs);
+            rects.add(0, numRects);
+        }
+        if (ripple) {
+            /* travel left to right, then wrap back round once fully off the curve */
+            next.rippleCentre += rippleSpeed;
+            if (next.rippleCentre > x_width + 3.0f * shape.rippleWidth) next.rippleCentre = -x_width - 3.0f * shape.rippleWidth;
+
+            addRectsNear(rects, shape.rippleCentre, points); // where it was
+            addRectsNear(rects, next.rippleCentre, points); // where it is now
+        }
+        shape = next;
+
+        return rects;
+    }
+
+    void advancePhase() {
+        /* moves only the phase drift on a frame, for renderers that work the sine out themselves and don't follow the ripple or spectral waves */
+        if (drift) shape.phase += driftSpeed;
+    }
+
+    const SineShape& getShape() const { return shape; }
+
+    void step(SineMesh &mesh, MyVAO &vao, ScratchArena &arena, JobSystem* jobs = nullptr) {
+        /* advances the shape, then regenerates and uploads just the rectangles that changed */
+        DirtyRanges rects = advance(mesh.points, jobs);
+
+        for (const DirtyRanges::Range &range: rects.get()) {
+            if (spectral) regenSineMesh(mesh, range.begin, range.end, SpectralShape{spectral->heights(0), spectral->size()}, arena, jobs);
+            else regenSineMesh(mesh, range.begin, range.end, shape, arena, jobs);
+            vao.markDirty(6 * range.begin, 6 * (range.end - range.begin));
+        }
+
+        uploadedRanges += vao.numDirtyRanges();
+        uploadedBytes += vao.uploadDirty(mesh.data);
+        frames ++;
+
+        /* report the average upload every few seconds */
+        if (frames == 300) {
+            cout << "Wave upload: " << uploadedBytes / 1024.0 / frames << " KB/frame in " << (double)uploadedRanges / frames
+                 << " ranges/frame, of " << mesh.numVertices * (size_t)mesh.stride / 1024.0 << " KB mesh" << endl;
+            if (spectral) cout << "  spectral synthesis: " << synthesisTimer.averageMs() << " ms/frame, " << spectral->size() << " point FFT of " << spectral->waves() << " waves (" << simdName() << ")" << endl;
+            uploadedBytes = uploadedRanges = 0;
+            synthesisTimer.reset();
+            frames = 0;
+        }
+    }
+};
+
+/* Prints the precision of a mesh's format, and its VRAM and per-frame vertex fetch against the same samples in the 12 byte float layout */
+void reportSineMemory(const SineMesh &mesh, SineFormat format, unsigned int requestedPoints, unsigned int drawsPerFrame) {
+    const double MB = 1024.0 * 1024.0;
+    const unsigned int floatStride = 3 * sizeof(float);
+    const float x_width = 3.0f;
+
+    double bytes = (double)mesh.stride * mesh.numVertices;
+    double floatBytes = (double)floatStride * mesh.numVertices;
+
+    cout << "Vertex format: " << sineFormatName(format) << " (" << mesh.stride << " B/vertex, float is " << floatStride << " B)" << endl;
+    cout << "  Samples: " << mesh.points << " of the " << requestedPoints << " asked for";
+    if (mesh.points < requestedPoints) cout << ", as many as get their own x in this format";
+    cout << ", x step " << 2.0f * x_width / mesh.points << ", y step up to " << sineFormatYStep(format)
+         << " (" << sineFormatYStep(format) * 540.0f << " px at 1080p)" << endl;
+    cout << "  VRAM: " << bytes / MB << " MB, saving " << (floatBytes - bytes) / MB << " MB" << endl;
+    cout << "  Vertex fetch per frame: " << bytes * drawsPerFrame / MB << " MB, saving "
+         << (floatBytes - bytes) * drawsPerFrame / MB << " MB (" << (floatBytes - bytes) * drawsPerFrame * 60 / MB << " MB/s at 60 fps)" << endl;
+}
+
+/* Prints how much staging memory generating geometry took, and the process' peak RSS */
+void reportStagingMemory(const ScratchArena &arena) {
+    const double MB = 1024.0 * 1024.0;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    double peakRSS = usage.ru_maxrss / MB; // bytes on macOS
+#else
+    double peakRSS = usage.ru_maxrss / 1024.0; // kilobytes on linux
+#endif
+
+    cout << "Geometry staging: peak " << arena.peakBytes() / MB << " MB, reserved " << arena.reservedBytes() / MB << " MB, "
+         << arena.allocations() << " allocations from " << arena.systemAllocations() << " system allocations" << endl;
+    cout << "  Peak RSS: " << peakRSS << " MB" << endl;
+}
+
+#endif
@@ -0,0 +1,197 @@
+#ifndef SLIDE_LOADER_H
+#define SLIDE_LOADER_H
+
+#include "resample.h"
+#include "timing.h"
+#include "stb_image.h" // the implementation is compiled in main.cpp
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+/* A file mapped read only, so the decoder reads it straight out of the page cache rather than from a copy */
+class MappedFile {
+    void* data = MAP_FAILED;
+    size_t length = 0;
+
+public:
+    MappedFile() {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const string &path) {
+        close();
+        int file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0) return false;
+
+        struct stat info;
+        if (fstat(file, &info) == 0 && info.st_size > 0) {
+            length = (size_t)info.st_size;
+            data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file, 0);
+            if (data != MAP_FAILED) madvise(data, length, MADV_SEQUENTIAL); // decoders read front to back
+        }
+        ::close(file); // the mapping keeps the file alive
+        return data != MAP_FAILED;
+    }
+
+    void close() {
+        if (data != MAP_FAILED) munmap(data, length);
+        data = MAP_FAILED;
+        length = 0;
+    }
+
+    const uint8_t* bytes() const { return (const uint8_t*)data; }
+    size_t size() const { return length; }
+};
+
+/* A slide decoded and shrunk to fit the framebuffer, ready to upload. Rows run top to bottom */
+struct Slide {
+    unsigned int index = 0; // in the slide list
+    int width = 0, height = 0;
+    vector<uint8_t> pixels; // RGBA8, empty if the file couldn't be read
+    size_t sourcePixels = 0;
+    double decodeMs = 0.0, resampleMs = 0.0;
+
+    bool ok() const { return !pixels.empty(); }
+};
+
+/* Decodes slides ahead of the slideshow on threads of its own.
+They aren't jobs, because a thread waiting on the job system runs whatever job is queued,
+and a render thread picking up a second long JPEG decode is exactly the hitch this is here to avoid. */
+class SlideLoader {
+    vector<string> paths;
+    ResampleFilter filter;
+    vector<thread> threads;
+
+    struct Request {
+        uint64_t sequence; // slides are numbered as shown, so a short list can loop and still be loaded ahead
+        unsigned int index;
+        int width, height;
+    };
+    mutex lock;
+    condition_variable wake;
+    deque<Request> requests;
+    map<uint64_t, Slide> ready; // by sequence
+    bool running = true;
+
+    void run() {
+        while (true) {
+            Request request;
+            {
+                unique_lock<mutex> guard(lock);
+                wake.wait(guard, [this] { return !running || !requests.empty(); });
+                if (!running) return;
+                request = requests.front();
+                requests.pop_front();
+            }
+
+            Slide slide = load(paths[request.index], request.width, request.height, filter);
+            slide.index = request.index;
+
+            lock_guard<mutex> guard(lock);
+            ready[request.sequence] = std::move(slide);
+        }
+    }
+
+public:
+    SlideLoader(const vector<string> &pathsIn, unsigned int numThreads, ResampleFilter filterIn = ResampleFilter::Lanczos) : paths(pathsIn), filter(filterIn) {
+        if (paths.empty()) return;
+        for (unsigned int i = 0; i < max(numThreads, 1u); i++) threads.emplace_back(&SlideLoader::run, this);
+    }
+    ~SlideLoader() { stop(); }
+
+    SlideLoader(const SlideLoader&) = delete;
+    SlideLoader& operator=(const SlideLoader&) = delete;
+
+    static vector<string> list(const string &directory) {
+        /* every image stb_image can read in the directory, in name order */
+        vector<string> found;
+        error_code error;
+        for (const filesystem::directory_entry &entry: filesystem::directory_iterator(directory, error)) {
+            string extension = entry.path().extension().string();
+            transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+            for (const char* known: {".jpg", ".jpeg", ".png", ".bmp", ".tga", ".gif", ".psd", ".pnm", ".ppm", ".pgm"}) {
+                if (extension == known) found.push_back(entry.path().string());
+            }
+        }
+        if (error) cout << "Slideshow: can't read " << directory << ": " << error.message() << endl;
+        sort(found.begin(), found.end());
+        return found;
+    }
+
+    static Slide load(const string &path, int width, int height, ResampleFilter filter = ResampleFilter::Lanczos) {
+        /* maps, decodes and shrinks one image to fit width x height, never enlarging it */
+        Slide slide;
+        MappedFile file;
+        if (!file.open(path)) {
+            cout << "Slideshow: can't open " << path << endl;
+            return slide;
+        }
+
+        Clock::time_point start = Clock::now();
+        int sourceWidth, sourceHeight, channels;
+        uint8_t* source = stbi_load_from_memory(file.bytes(), (int)min(file.size(), (size_t)INT32_MAX), &sourceWidth, &sourceHeight, &channels, 4);
+        file.close();
+        if (!source) {
+            cout << "Slideshow: can't decode " << path << ": " << stbi_failure_reason() << endl;
+            return slide;
+        }
+        Clock::time_point decoded = Clock::now();
+
+        fitInside(sourceWidth, sourceHeight, min(width, sourceWidth), min(height, sourceHeight), slide.width, slide.height);
+        slide.pixels.resize((size_t)slide.width * slide.height * 4);
+        /* on this thread alone, the loader's threads already work on different slides */
+        Resampler(sourceWidth, sourceHeight, slide.width, slide.height, filter).resample(source, slide.pixels.data());
+        stbi_image_free(source);
+
+        slide.sourcePixels = (size_t)sourceWidth * sourceHeight;
+        slide.decodeMs = msBetween(start, decoded);
+        slide.resampleMs = msBetween(decoded, Clock::now());
+        return slide;
+    }
+
+    size_t size() const { return paths.size(); }
+
+    void request(uint64_t sequence, int width, int height) {
+        /* queues the sequence'th slide shown (looping over the list) to be loaded at this size, in the order asked for */
+        lock_guard<mutex> guard(lock);
+        requests.push_back({sequence, (unsigned int)(sequence % paths.size()), width, height});
+        wake.notify_one();
+    }
+
+    bool take(uint64_t sequence, Slide &slide) {
+        /* hands over a requested slide once it has loaded, without waiting */
+        lock_guard<mutex> guard(lock);
+        auto found = ready.find(sequence);
+        if (found == ready.end()) return false;
+        slide = std::move(found->second);
+        ready.erase(found);
+        return true;
+    }
+
+    void stop() {
+        {
+            lock_guard<mutex> guard(lock);
+            running = false;
+        }
+        wake.notify_all();
+        for (thread &worker: threads) worker.join();
+        threads.clear();
+    }
+};
+
+#endif
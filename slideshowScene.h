@@ -0,0 +1,235 @@
+#ifndef SLIDESHOW_SCENE_H
+#define SLIDESHOW_SCENE_H
+
+#include "scene.h"
+#include "slideLoader.h"
+#include "timing.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+/* ---------------------------- Slideshow scene ---------------------------- */
+/* Shows the images in a directory (--slides=<dir>) one after another, crossfading between them.
+
+Nothing slow happens on the render thread. SlideLoader maps, decodes and shrinks the next few slides to the framebuffer size on its own threads.
+A loaded slide is then copied into a pixel buffer a few megabytes per frame, and the texture is filled from that buffer,
+which the driver can do without stalling the frame. If a slide still isn't ready when its turn comes,
+the current one simply stays up longer. */
+class SlideshowScene : public Scene {
+    Shader &shader;
+    unsigned int emptyVAO; // the full-screen triangle comes from gl_VertexID
+    unsigned int textures[2]; // the slide being shown, and the one fading in or waiting to
+    glm::ivec2 sizes[2];
+    int shown = 0; // which of textures is on screen
+
+    SlideLoader loader;
+    unsigned int ahead; // slides to keep loading ahead of the one shown
+    int64_t showing = -1; // the sequence number of the slide on screen, counting every slide shown, -1 before the first
+    int64_t requested = 0; // the next sequence number to ask the loader for
+
+    /* the next slide on its way into textures[1 - shown] */
+    unsigned int pixelBuffer;
+    Slide incoming;
+    bool uploading = false, nextReady = false;
+    size_t copied = 0;
+    uint8_t* mapped = nullptr;
+    static const size_t uploadBytesPerFrame = 4 << 20;
+
+    double slideSeconds, fadeSeconds;
+    double slideStart = 0.0, fadeBegan = -1.0, fade = 0.0;
+    glm::ivec2 framebuffer;
+
+    /* for the report */
+    StageTimer decodeTimer, resampleTimer, uploadTimer;
+    size_t sourcePixels = 0, slidesLate = 0, slidesFailed = 0;
+    bool waiting = false;
+
+    static void fillBlack(unsigned int texture) {
+        uint8_t black[4] = {0, 0, 0, 255};
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, black);
+    }
+
+    void requestAhead() {
+        /* keep the loader busy with the next few slides, at the current framebuffer size */
+        if (loader.size() == 0) return;
+        while (requested <= showing + ahead) loader.request(requested++, framebuffer.x, framebuffer.y);
+    }
+
+    void upload() {
+        /* moves the next slide along, doing at most one bounded step per frame */
+        ScopedStage stage(uploadTimer);
+        if (!uploading) {
+            if (nextReady || !loader.take(showing + 1, incoming)) return;
+            if (!incoming.ok()) {
+                /* skip what can't be read, the next one is already on its way */
+                slidesFailed ++;
+                showing ++;
+                requestAhead();
+                return;
+            }
+            decodeTimer.add(chrono::duration_cast<Clock::duration>(chrono::duration<double, milli>(incoming.decodeMs)));
+            resampleTimer.add(chrono::duration_cast<Clock::duration>(chrono::duration<double, milli>(incoming.resampleMs)));
+            sourcePixels += incoming.sourcePixels;
+
+            /* orphan the buffer, so mapping it never waits on the last transfer */
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, incoming.pixels.size(), nullptr, GL_STREAM_DRAW);
+            mapped = (uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, incoming.pixels.size(), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            uploading = true;
+            copied = 0;
+            return;
+        }
+
+        size_t size = incoming.pixels.size();
+        size_t count = min(uploadBytesPerFrame, size - copied);
+        if (mapped) memcpy(mapped + copied, incoming.pixels.data() + copied, count);
+        copied += count;
+        if (copied < size) return;
+
+        /* all there, so fill the texture from the buffer */
+        int next = 1 - shown;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+        bool ok = mapped && glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER); // false if the buffer's contents were lost meanwhile
+        glBindTexture(GL_TEXTURE_2D, textures[next]);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        if (ok) {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, incoming.width, incoming.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (!ok) glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, incoming.width, incoming.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, incoming.pixels.data());
+
+        sizes[next] = glm::ivec2(incoming.width, incoming.height);
+        incoming = Slide();
+        mapped = nullptr;
+        uploading = false;
+        nextReady = true;
+    }
+
+    glm::vec2 coverage(glm::ivec2 size) const {
+        /* the share of the screen a slide covers, fitted inside it */
+        int fitWidth, fitHeight;
+        fitInside(size.x, size.y, framebuffer.x, framebuffer.y, fitWidth, fitHeight);
+        return glm::vec2((float)fitWidth / framebuffer.x, (float)fitHeight / framebuffer.y);
+    }
+
+public:
+    SlideshowScene(const SceneContext &context)
+        : shader(context.shaders.get("shaders/fullscreenVertexShader.txt", "shaders/slideshowFragmentShader.txt")),
+          /* --slides-ahead=<n> sets how many slides are decoded ahead, on up to that many threads, leaving a core for rendering.
+          --slide-filter=lanczos|box picks how they are shrunk to fit */
+          loader(SlideLoader::list(context.option("slides", ".")),
+                 min((unsigned int)max(1, stoi(context.option("slides-ahead", "3"))), max(1u, thread::hardware_concurrency() - 1)),
+                 parseResampleFilter(context.option("slide-filter", "lanczos"))),
+          ahead((unsigned int)max(1, stoi(context.option("slides-ahead", "3")))),
+          /* --slide-seconds and --fade-seconds set how long each slide is up for, including its crossfade */
+          slideSeconds(max(0.1, stod(context.option("slide-seconds", "6")))), fadeSeconds(max(0.0, stod(context.option("fade-seconds", "1.5")))) {
+        if (loader.size() == 0) cout << "Slideshow: no images in " << context.option("slides", ".") << ", pass a directory with --slides=<dir>" << endl;
+        else cout << "Slideshow: " << loader.size() << " images" << endl;
+
+        glGenVertexArrays(1, &emptyVAO);
+        glGenBuffers(1, &pixelBuffer);
+        glGenTextures(2, textures);
+        for (int i = 0; i < 2; i++) {
+            fillBlack(textures[i]);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            sizes[i] = glm::ivec2(1);
+        }
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        framebuffer = glm::ivec2(max(viewport[2], 1), max(viewport[3], 1));
+
+        /* the first slide fades in from black as soon as it loads */
+        requestAhead();
+        slideStart = -slideSeconds;
+
+        shader.use();
+        shader.setVec2("uvScale", glm::vec2(1.0f));
+        shader.setInt("current", 0);
+        shader.setInt("next", 1);
+    }
+
+    void update(double time, float dt) override {
+        upload();
+
+        /* crossfade once the slide has been up long enough and the next is ready, otherwise keep waiting */
+        if (loader.size() == 0 || time < slideStart + slideSeconds - fadeSeconds) return;
+        if (!nextReady) {
+            if (!waiting && showing >= 0) slidesLate ++;
+            waiting = true;
+            return;
+        }
+        waiting = false;
+
+        if (fadeBegan < 0.0) fadeBegan = time;
+        fade = fadeSeconds > 0.0 ? min(1.0, (time - fadeBegan) / fadeSeconds) : 1.0;
+        if (fade < 1.0) return;
+
+        /* the next slide is fully up, so it becomes the current one */
+        shown = 1 - shown;
+        showing ++;
+        nextReady = false;
+        fade = 0.0;
+        fadeBegan = -1.0;
+        slideStart = time;
+        fillBlack(textures[1 - shown]); // let the old slide's memory go
+        sizes[1 - shown] = glm::ivec2(1);
+        requestAhead();
+    }
+
+    void draw(int width, int height) override {
+        framebuffer = glm::ivec2(max(width, 1), max(height, 1));
+
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        shader.use();
+        shader.setVec2("currentScale", coverage(sizes[shown]));
+        shader.setVec2("nextScale", coverage(sizes[1 - shown]));
+        float eased = (float)(fade * fade * (3.0 - 2.0 * fade));
+        shader.setFloat("fade", eased);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, textures[shown]);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, textures[1 - shown]);
+        glActiveTexture(GL_TEXTURE0);
+
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+    }
+
+    void report() override {
+        size_t slides = decodeTimer.count();
+        cout << "  slideshow: " << slides << " slides loaded";
+        if (slides) {
+            cout << ", decode " << decodeTimer.averageMs() << " ms (" << sourcePixels / (decodeTimer.totalMs() * 1e3) << " MP/s), resample "
+                 << resampleTimer.averageMs() << " ms (" << sourcePixels / (resampleTimer.totalMs() * 1e3) << " MP/s)";
+        }
+        cout << ", upload step " << uploadTimer.averageMs() << " ms/frame, " << slidesLate << " slides late, " << slidesFailed << " unreadable" << endl;
+        decodeTimer.reset(); resampleTimer.reset(); uploadTimer.reset();
+        sourcePixels = slidesLate = slidesFailed = 0;
+    }
+
+    void del() override {
+        loader.stop();
+        if (mapped) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &pixelBuffer);
+        glDeleteTextures(2, textures);
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+};
+
+#endif
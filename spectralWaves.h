@@ -0,0 +1,154 @@
+#ifndef SPECTRAL_WAVES_H
+#define SPECTRAL_WAVES_H
+
+#include "fft.h"
+#include "jobSystem.h"
+#include "simd.h"
+#include <cstring>
+#include <math.h>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+/* Heights along the curve made of about a hundred travelling waves, like the sea, so a long running screensaver never visibly repeats.
+The waves are a spectrum over the curve's width, with random phases and deep water speeds (the long waves overtaking the short ones),
+and each frame turns the spectrum into heights with one inverse FFT per row.
+The spectrum is cut off at maxK whatever the size, so the size only sets how finely the heights are sampled, not how many waves there are:
+the shortest wave is 6 / 114 across, so 2048 samples give it about 18, and anything under 256 drops the shortest waves.
+Rows are independent seas, eg. one for each curve, synthesised in parallel on the job system. */
+class SpectralWaves {
+    FFT fft;
+    unsigned int numRows;
+    unsigned int frame = 0;
+    unsigned int numWaves = 0; // frequency bins with any height, the same in every row
+
+    /* the period the heights repeat over, the curve's full width */
+    static constexpr float width = 6.0f;
+    /* the strongest wave, about the wavelength of the plain sine, and its angular speed */
+    static constexpr double peakK = 15.0, peakOmega = 1.2;
+    /* the spectrum is cut off where its ripples would only make the curve look jagged */
+    static constexpr double maxK = 8.0 * peakK;
+    /* the standard deviation of the height, against the plain sine's amplitude of 0.2 */
+    static constexpr double heightDeviation = 0.08;
+    /* frames are a fixed step, like the other wave animations */
+    static constexpr double frameSeconds = 1.0 / 60.0;
+    /* the spectrum is rotated a frame at a time, and rebuilt exactly this often so float rounding never accumulates */
+    static constexpr unsigned int resyncFrames = 600;
+
+    vector<float> amplitude, omega, rotorR, rotorI; // per frequency bin, shared by every row
+    vector<float> phase; // starting phase of each row's bins, numRows x size
+    vector<float> spectrumR, spectrumI; // each row's spectrum at the current frame
+    vector<float> heightR, heightI, scratchR, scratchI; // each row's transform, the real part of which is its heights
+
+    float* row(vector<float> &data, unsigned int r) { return data.data() + (size_t)r * fft.size(); }
+
+    void resync(unsigned int r) {
+        /* the spectrum at this frame, straight from the starting phases, in double */
+        const unsigned int n = fft.size();
+        double t = frame * frameSeconds;
+        const float* start = row(phase, r);
+        float *re = row(spectrumR, r), *im = row(spectrumI, r);
+        for (unsigned int j = 0; j < n; j++) {
+            double angle = start[j] - omega[j] * t;
+            re[j] = (float)(amplitude[j] * cos(angle));
+            im[j] = (float)(amplitude[j] * sin(angle));
+        }
+    }
+
+    void rotate(unsigned int r) {
+        /* moves every wave on a frame: multiplies each bin by its e^(-i omega dt) */
+        const unsigned int n = fft.size();
+        float *re = row(spectrumR, r), *im = row(spectrumI, r);
+        const float *wr = rotorR.data(), *wi = rotorI.data();
+        for (unsigned int j = 0; j < n; j += 4) {
+            float4 a = load4(re + j), b = load4(im + j), c = load4(wr + j), d = load4(wi + j);
+            store4(re + j, a * c - b * d);
+            store4(im + j, a * d + b * c);
+        }
+    }
+
+    void synthesise(unsigned int r) {
+        /* heights are the real part of the inverse transform, the spectrum is kept for the next frame */
+        const unsigned int n = fft.size();
+        float *re = row(heightR, r), *im = row(heightI, r);
+        memcpy(re, row(spectrumR, r), n * sizeof(float));
+        memcpy(im, row(spectrumI, r), n * sizeof(float));
+        fft.inverse(re, im, row(scratchR, r), row(scratchI, r));
+    }
+
+public:
+    /* size is the number of height samples per row, a power of two of at least 16 */
+    SpectralWaves(unsigned int size, unsigned int rows = 1, unsigned int seed = 1) : fft(size), numRows(rows) {
+        const unsigned int n = size;
+        amplitude.assign(n, 0.0f);
+        omega.assign(n, 0.0f);
+        rotorR.assign(n, 1.0f);
+        rotorI.assign(n, 0.0f);
+
+        /* a Pierson-Moskowitz like spectrum over wavenumber, rolled off below the peak, with a steeper k^-4 tail to keep the curve smooth.
+        Only positive frequencies are used, so the real part of the transform is the sum of the cosines */
+        double variance = 0.0;
+        for (unsigned int j = 1; j < n / 2; j++) {
+            double k = 2.0 * M_PI * j / width;
+            if (k > maxK) break;
+            double spectrum = pow(k, -4.0) * exp(-1.25 * pow(peakK / k, 2.0));
+            amplitude[j] = (float)sqrt(spectrum);
+            omega[j] = (float)(peakOmega * sqrt(k / peakK));
+            rotorR[j] = (float)cos(omega[j] * frameSeconds);
+            rotorI[j] = (float)-sin(omega[j] * frameSeconds);
+            variance += 0.5 * spectrum;
+            numWaves ++;
+        }
+        float normalise = (float)(heightDeviation / sqrt(variance));
+        for (float &a: amplitude) a *= normalise;
+
+        mt19937 random(seed);
+        uniform_real_distribution<float> angle(0.0f, 2.0f * (float)M_PI);
+        phase.resize((size_t)rows * n);
+        for (float &p: phase) p = angle(random);
+
+        for (vector<float>* data: {&spectrumR, &spectrumI, &heightR, &heightI, &scratchR, &scratchI}) data->assign((size_t)rows * n, 0.0f);
+        for (unsigned int r = 0; r < rows; r++) {
+            resync(r);
+            synthesise(r);
+        }
+    }
+
+    unsigned int size() const { return fft.size(); }
+    unsigned int rows() const { return numRows; }
+    unsigned int waves() const { return numWaves; }
+    const FFT& transform() const { return fft; }
+
+    void advance(JobSystem* jobs = nullptr) {
+        /* moves every row on a frame and synthesises its new heights, one job per row */
+        frame ++;
+        bool exact = frame % resyncFrames == 0;
+        parallelFor(jobs, 0, numRows, 1, [&](size_t first, size_t last) {
+            for (size_t r = first; r < last; r++) {
+                if (exact) resync((unsigned int)r);
+                else rotate((unsigned int)r);
+                synthesise((unsigned int)r);
+            }
+        });
+    }
+
+    const float* heights(unsigned int r) const { return heightR.data() + (size_t)r * fft.size(); }
+};
+
+/* One row of SpectralWaves as a shape, so the sine mesh can be generated from it just like from a SineShape */
+struct SpectralShape {
+    const float* heights;
+    unsigned int size;
+
+    float height(float x) const {
+        /* linear between the samples, which repeat over the curve's width of 6 */
+        float u = (x + 3.0f) / 6.0f * size;
+        float below = floor(u);
+        unsigned int i = (unsigned int)(long long)below & (size - 1);
+        float t = u - below;
+        return heights[i] + t * (heights[(i + 1) & (size - 1)] - heights[i]);
+    }
+};
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef STARFIELD_H
+#define STARFIELD_H
+
+#include "jobSystem.h"
+#include "simd.h"
+#include <cstdint>
+#include <cstring>
+#include <math.h>
+#include <vector>
+
+using namespace std;
+
+/* A field of stars flying towards the camera down a slowly twisting tunnel.
+
+Each star is a seed: an angle and radius around the axis it flies down, where it starts along the tunnel, and how many turns it makes
+about the axis per spin period, so stars near the axis swirl faster. Its position at any time follows exactly from those:
+    angle = angle0 + turns * spin,          spin = 2 pi (t / spinPeriod mod 1)
+    z = far - (far - near) ((z0 + t / flightSeconds) mod 1)
+Both phases are taken mod 1 in double on the CPU, so the GPU can work out every star from its seed in float however long it has run.
+That is the analytic path. The CPU path keeps x, y and z per star instead, structure of arrays, and steps them four at a time:
+a fixed rotation per star (its turns times one step's spin) and a fixed distance in z, wrapping back to the far plane.
+A slice of the stars is reset to the exact positions each step, so rounding never builds up.
+Both paths move in whole steps of stepSeconds, the scene running as many a frame as the time since the last one calls for. */
+class Starfield {
+public:
+    static constexpr float near = 0.1f, far = 6.0f;
+    static constexpr double flightSeconds = 10.0; // to fly the tunnel's length
+    static constexpr double spinPeriod = 240.0;
+    static constexpr double stepSeconds = 1.0 / 60.0; // the fixed step both paths move in
+
+private:
+    unsigned int numStars;
+    uint64_t steps = 0;
+
+    /* the seeds: angle0, radius, z0 (a fraction of the way along) and turns per spin period, four floats per star */
+    vector<float> seedData;
+
+    /* the CPU path's state and per step rotations, structure of arrays */
+    vector<float> x, y, z, cosStep, sinStep;
+    unsigned int resyncNext = 0;
+    static const unsigned int resyncSteps = 600; // every star is reset once this often
+
+    static constexpr double twoPi = 6.283185307179586;
+
+    void exact(unsigned int i, double spin, double flight, float &outX, float &outY, float &outZ) const {
+        const float* seed = &seedData[4 * (size_t)i];
+        double angle = seed[0] + seed[3] * spin;
+        double along = seed[2] + flight;
+        along -= floor(along);
+        outX = (float)(seed[1] * cos(angle));
+        outY = (float)(seed[1] * sin(angle));
+        outZ = (float)(far - (far - near) * along);
+    }
+
+public:
+    Starfield(unsigned int numStarsIn, uint32_t seed = 1) : numStars(max(numStarsIn, 1u)) {
+        seedData.resize((size_t)numStars * 4);
+        x.resize(numStars); y.resize(numStars); z.resize(numStars);
+        cosStep.resize(numStars); sinStep.resize(numStars);
+
+        uint32_t state = seed * 2654435761u + 1;
+        auto random = [&state] {
+            state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+            return (state >> 8) * (1.0f / 16777216.0f);
+        };
+        for (unsigned int i = 0; i < numStars; i++) {
+            /* spread evenly over the tunnel's cross section, and faster nearer the axis */
+            float radius = 0.02f + 1.2f * sqrt(random());
+            float* s = &seedData[4 * (size_t)i];
+            s[0] = (float)(twoPi * random());
+            s[1] = radius;
+            s[2] = random();
+            s[3] = floor(1.0f + 6.0f / (1.0f + 8.0f * radius));
+
+            double angle = s[3] * twoPi * stepSeconds / spinPeriod;
+            cosStep[i] = (float)cos(angle);
+            sinStep[i] = (float)sin(angle);
+            exact(i, 0.0, 0.0, x[i], y[i], z[i]);
+        }
+    }
+
+    unsigned int stars() const { return numStars; }
+    const vector<float>& seeds() const { return seedData; }
+
+    /* the phases for the analytic path, in [0, 2 pi) and [0, 1), at the current step */
+    float spinPhase() const { return (float)(twoPi * fmod(steps * stepSeconds / spinPeriod, 1.0)); }
+    float flightPhase() const { return (float)fmod(steps * stepSeconds / flightSeconds, 1.0); }
+
+    void step(unsigned int count = 1) {
+        /* moves time on for the analytic path alone */
+        steps += count;
+    }
+
+    void write(float* out) const {
+        /* writes the CPU path's stars where they are now, laid out like advance's out */
+        memcpy(out, x.data(), numStars * sizeof(float));
+        memcpy(out + numStars, y.data(), numStars * sizeof(float));
+        memcpy(out + 2 * (size_t)numStars, z.data(), numStars * sizeof(float));
+    }
+
+    void advance(JobSystem* jobs, float* out = nullptr) {
+        /* steps the CPU path's stars, writing x, y then z for every star to out if given, eg. a mapped buffer */
+        double spin = twoPi * fmod(steps * stepSeconds / spinPeriod, 1.0), flight = fmod(steps * stepSeconds / flightSeconds, 1.0);
+        unsigned int slice = (numStars + resyncSteps - 1) / resyncSteps;
+        size_t resyncFirst = resyncNext, resyncLast = min((size_t)resyncNext + slice, (size_t)numStars);
+        resyncNext = resyncLast < numStars ? (unsigned int)resyncLast : 0;
+        steps ++;
+
+        float dz = (float)((far - near) * stepSeconds / flightSeconds);
+        float* outX = out;
+        float* outY = out ? out + numStars : nullptr;
+        float* outZ = out ? out + 2 * (size_t)numStars : nullptr;
+
+        parallelFor(jobs, 0, numStars, 65536, [&](size_t first, size_t last) {
+            /* the slice due a reset goes back to where it should be now, before this step moves it on */
+            for (size_t j = max(first, resyncFirst); j < min(last, resyncLast); j++) exact((unsigned int)j, spin, flight, x[j], y[j], z[j]);
+
+            const float4 depth = splat4(far - near), nearPlane = splat4(near), dz4 = splat4(dz);
+            size_t i = first;
+            for (; i + 4 <= last; i += 4) {
+                float4 px = load4(&x[i]), py = load4(&y[i]), c = load4(&cosStep[i]), s = load4(&sinStep[i]);
+                float4 nx = px * c - py * s, ny = px * s + py * c;
+                float4 nz = load4(&z[i]) - dz4;
+                nz = nz + depth * less4(nz, nearPlane); // past the near plane, back to the far one
+                store4(&x[i], nx); store4(&y[i], ny); store4(&z[i], nz);
+                if (out) { store4(outX + i, nx); store4(outY + i, ny); store4(outZ + i, nz); }
+            }
+            for (; i < last; i++) {
+                float px = x[i], py = y[i];
+                x[i] = px * cosStep[i] - py * sinStep[i];
+                y[i] = px * sinStep[i] + py * cosStep[i];
+                z[i] -= dz;
+                if (z[i] < near) z[i] += far - near;
+                if (out) { outX[i] = x[i]; outY[i] = y[i]; outZ[i] = z[i]; }
+            }
+        });
+    }
+};
+
+#endif
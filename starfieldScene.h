@@ -0,0 +1,130 @@
+#ifndef STARFIELD_SCENE_H
+#define STARFIELD_SCENE_H
+
+#include "scene.h"
+#include "starfield.h"
+#include "timing.h"
+#include <iostream>
+#include <limits>
+
+using namespace std;
+
+/* ---------------------------- Starfield scene ---------------------------- */
+/* A million or more stars (see Starfield) drawn as GL_POINTS sprites from one VBO in one draw, blended additively.
+
+--star-motion picks where they move, as which is cheaper depends on the device:
+gpu keeps only the seeds in a static VBO and the vertex shader works out each star from them and two phases,
+cpu steps the stars on the CPU into a streaming VBO, orphaned and mapped each frame like the strings' heights, so the vertex shader only projects. */
+class StarfieldScene : public Scene {
+    JobSystem &jobs;
+    bool analytic;
+    Shader &shader;
+    Starfield field;
+
+    unsigned int VAO, VBO;
+    size_t streamBytes = 0;
+
+    FixedStep clock;
+    StageTimer stepTimer;
+
+    static ShaderDefines defines(bool analytic) {
+        ShaderDefines defines;
+        if (analytic) defines["ANALYTIC"] = "";
+        return defines;
+    }
+
+public:
+    StarfieldScene(const SceneContext &context)
+        : jobs(context.jobs),
+          /* --star-motion=gpu|cpu picks where the stars move, --stars=<n> how many there are */
+          analytic(context.option("star-motion", "gpu") != "cpu"),
+          shader(context.shaders.get("shaders/starfieldVertexShader.txt", "shaders/starfieldFragmentShader.txt", defines(analytic))),
+          field((unsigned int)max(1, stoi(context.option("stars", "1000000")))),
+          /* the GPU path's steps cost nothing however many there are, the CPU path's are each a pass over every star */
+          clock(Starfield::stepSeconds, analytic ? numeric_limits<unsigned int>::max() : 4) {
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        if (analytic) {
+            glBufferData(GL_ARRAY_BUFFER, field.seeds().size() * sizeof(float), field.seeds().data(), GL_STATIC_DRAW);
+            glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(0);
+        } else {
+            /* x, y then z for every star, one after another */
+            streamBytes = (size_t)field.stars() * 3 * sizeof(float);
+            glBufferData(GL_ARRAY_BUFFER, streamBytes, nullptr, GL_STREAM_DRAW);
+            /* where they start, for the frames before the first step is due */
+            float* mapped = (float*)glMapBufferRange(GL_ARRAY_BUFFER, 0, streamBytes, GL_MAP_WRITE_BIT);
+            if (mapped) {
+                field.write(mapped);
+                glUnmapBuffer(GL_ARRAY_BUFFER);
+            }
+            for (unsigned int i = 0; i < 3; i++) {
+                glVertexAttribPointer(i, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)(i * (size_t)field.stars() * sizeof(float)));
+                glEnableVertexAttribArray(i);
+            }
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        shader.use();
+        shader.setFloat("near", Starfield::near);
+        shader.setFloat("far", Starfield::far);
+    }
+
+    void update(double time, float dt) override {
+        /* as many fixed steps as the time since the last frame calls for, so the flight keeps its speed whatever the frame rate */
+        ScopedStage stage(stepTimer);
+        unsigned int steps = clock.due(dt);
+        if (analytic) {
+            field.step(steps);
+            return;
+        }
+        if (!steps) return; // the buffer still holds the last step
+        for (unsigned int i = 1; i < steps; i++) field.advance(&jobs); // only the last step's positions are drawn
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        float* mapped = (float*)glMapBufferRange(GL_ARRAY_BUFFER, 0, streamBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        field.advance(&jobs, mapped);
+        if (mapped) glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void draw(int width, int height) override {
+        glClearColor(0.0f, 0.0f, 0.02f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        shader.use();
+        shader.setFloat("aspect", (float)width / max(height, 1));
+        shader.setFloat("pointScale", 1.5f * height / 1080.0f);
+        if (analytic) {
+            shader.setFloat("spin", field.spinPhase());
+            shader.setFloat("flight", field.flightPhase());
+        }
+
+        /* additive, so overlapping stars add up, and with no depth test as the order doesn't matter */
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glEnable(GL_PROGRAM_POINT_SIZE);
+        glBindVertexArray(VAO);
+        glDrawArrays(GL_POINTS, 0, field.stars());
+        glBindVertexArray(0);
+        glDisable(GL_PROGRAM_POINT_SIZE);
+        glDisable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    void report() override {
+        cout << "  starfield: " << field.stars() << " stars moved on the " << (analytic ? "GPU" : "CPU") << ", step " << stepTimer.averageMs()
+             << " ms/frame" << (analytic ? "" : " including writing them to the buffer") << endl;
+        stepTimer.reset();
+    }
+
+    void del() override {
+        glDeleteBuffers(1, &VBO);
+        glDeleteVertexArrays(1, &VAO);
+    }
+};
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef STRINGS_SCENE_H
+#define STRINGS_SCENE_H
+
+#include "scene.h"
+#include "timing.h"
+#include "waveStrings.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+/* ---------------------------- Strings scene ---------------------------- */
+/* Rows of curves that vibrate like plucked strings (see WaveStrings), seen in perspective, each hiding the ones behind it.
+
+The solver writes its heights straight into a mapped buffer, which is orphaned each frame so the GPU can still be drawing the last one.
+The shader reads it as a buffer texture and makes every vertex from gl_VertexID and gl_InstanceID,
+so there is no vertex data: one instanced triangle strip per frame, a string per instance. */
+class StringsScene : public Scene {
+    JobSystem &jobs;
+    Shader &shader;
+    WaveStrings strings;
+
+    unsigned int heightBuffer, heightTexture;
+    unsigned int emptyVAO; // core profile still needs a VAO bound to draw
+    size_t heightBytes;
+
+    FixedStep clock; // the strings always step 1/60 s, as many times a frame as the time since the last calls for
+    unsigned int stepsRun = 0; // since the last report
+
+    StageTimer solveTimer;
+
+    /* the world layout: strings as wide as the curves, receding into the distance */
+    static constexpr float halfWidth = 3.0f;
+    static constexpr float depthCovered = 20.0f;
+
+    /* --strings=<n> and --string-samples=<n> set how many strings there are, and how finely each is simulated */
+    static unsigned int askedStrings(const SceneContext &context) { return (unsigned int)max(1, stoi(context.option("strings", "1000"))); }
+    static unsigned int askedSamples(const SceneContext &context) { return (unsigned int)max(3, stoi(context.option("string-samples", "4096"))); }
+
+    static size_t maxTexels() {
+        GLint texels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &texels);
+        return (size_t)max(texels, 3);
+    }
+
+    /* all the heights are one buffer texture, so the strings and samples asked for are cut down to what the driver's hold */
+    static unsigned int fittedSamples(const SceneContext &context) { return (unsigned int)min((size_t)askedSamples(context), maxTexels()); }
+    static unsigned int fittedStrings(const SceneContext &context) {
+        return (unsigned int)max((size_t)1, min((size_t)askedStrings(context), maxTexels() / fittedSamples(context)));
+    }
+
+public:
+    StringsScene(const SceneContext &context)
+        : jobs(context.jobs), shader(context.shaders.get("shaders/stringsVertexShader.txt", "shaders/stringsFragmentShader.txt")),
+          strings(fittedStrings(context), fittedSamples(context)) {
+        heightBytes = (size_t)strings.strings() * strings.samplesPerString() * sizeof(float);
+
+        if (strings.strings() < askedStrings(context) || strings.samplesPerString() < askedSamples(context)) {
+            cout << "Strings: " << askedStrings(context) << " x " << askedSamples(context) << " samples is more than this driver's buffer textures hold ("
+                 << maxTexels() << "), using " << strings.strings() << " x " << strings.samplesPerString() << endl;
+        }
+
+        glGenBuffers(1, &heightBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, heightBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, heightBytes, nullptr, GL_STREAM_DRAW);
+        /* the strings start at rest, for the frames before the first step is due */
+        void* mapped = glMapBufferRange(GL_TEXTURE_BUFFER, 0, heightBytes, GL_MAP_WRITE_BIT);
+        if (mapped) {
+            memset(mapped, 0, heightBytes);
+            glUnmapBuffer(GL_TEXTURE_BUFFER);
+        }
+        glGenTextures(1, &heightTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, heightTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, heightBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glGenVertexArrays(1, &emptyVAO);
+
+        shader.use();
+        shader.setInt("heights", 0);
+        shader.setInt("samples", (int)strings.samplesPerString());
+        shader.setInt("numStrings", (int)strings.strings());
+        shader.setFloat("width", halfWidth);
+        shader.setFloat("spacing", depthCovered / strings.strings());
+        shader.setFloat("amplitude", 0.25f);
+        shader.setFloat("curtain", 0.6f);
+    }
+
+    void update(double time, float dt) override {
+        /* fixed steps, so the strings keep their speed whatever the frame rate. Only the last is written to the buffer,
+        and orphaning the buffer means mapping it never waits on the GPU */
+        unsigned int steps = clock.due(dt);
+        if (!steps) return; // the buffer still holds the last step
+        ScopedStage stage(solveTimer);
+        stepsRun += steps;
+        for (unsigned int i = 1; i < steps; i++) strings.advance(&jobs);
+        glBindBuffer(GL_TEXTURE_BUFFER, heightBuffer);
+        float* mapped = (float*)glMapBufferRange(GL_TEXTURE_BUFFER, 0, heightBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        strings.advance(&jobs, mapped);
+        if (mapped) glUnmapBuffer(GL_TEXTURE_BUFFER);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void draw(int width, int height) override {
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 1.4f, -2.5f), glm::vec3(0.0f, 0.0f, 4.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 projection = glm::perspective(glm::radians(60.0f), (float)width / max(height, 1), 0.1f, 100.0f);
+        /* looking along +z with y up puts +x on the left, so flip it back to match the curves */
+        projection = glm::scale(projection, glm::vec3(-1.0f, 1.0f, 1.0f));
+
+        glClearColor(0.02f, 0.03f, 0.06f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        shader.use();
+        shader.setMat4("viewProjection", projection * view);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_BUFFER, heightTexture);
+
+        /* instances are drawn in order, nearest first, so the depth test rejects most of each hidden curtain early */
+        glBindVertexArray(emptyVAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 2 * strings.samplesPerString(), strings.strings());
+        glBindVertexArray(0);
+    }
+
+    void report() override {
+        double ms = solveTimer.averageMs();
+        cout << "  strings: " << strings.strings() << " x " << strings.samplesPerString() << " samples, solve and write "
+             << ms << " ms/frame (" << (double)stepsRun / max(solveTimer.count(), (uint64_t)1) << " steps each, "
+             << strings.updatesPerStep() * stepsRun / max(solveTimer.totalMs() * 1e6, 1e-9) << " G updates/s, " << jobs.threads() << " threads)" << endl;
+        solveTimer.reset();
+        stepsRun = 0;
+    }
+
+    void del() override {
+        glDeleteTextures(1, &heightTexture);
+        glDeleteBuffers(1, &heightBuffer);
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+};
+
+#endif
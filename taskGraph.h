@@ -0,0 +1,156 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include "jobSystem.h"
+#include "timing.h"
+#include <atomic>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/* A one-shot graph of tasks, used to overlap the steps of startup.
+Each task runs once all the tasks it depends on have finished. Worker tasks go to the job system,
+main tasks (anything touching the window or the GL context) run on the thread calling run(), as soon as they are ready.
+A task returns false to fail, and every task depending on it is then skipped. */
+class TaskGraph {
+public:
+    enum class Thread { Main, Worker };
+    using Task = function<bool()>;
+
+private:
+    struct Node {
+        string name;
+        Thread thread;
+        vector<unsigned int> dependencies;
+        Task task;
+
+        /* written by whichever thread runs the task, read by the main thread once finished is set */
+        atomic<bool> finished{false};
+        bool started = false, failed = false, counted = false;
+        Clock::time_point start, end;
+    };
+
+    vector<unique_ptr<Node>> nodes;
+    Clock::time_point graphStart, graphEnd;
+    bool serial = false;
+
+    static void runNode(Node &node) {
+        node.start = Clock::now();
+        node.failed = !node.task();
+        node.end = Clock::now();
+        node.finished.store(true, memory_order_release);
+    }
+
+    int state(unsigned int index) const {
+        /* 1 if a task's dependencies have all succeeded, 0 if it must wait, -1 if one failed */
+        for (unsigned int dependency: nodes[index]->dependencies) {
+            const Node &node = *nodes[dependency];
+            if (!node.finished.load(memory_order_acquire)) return 0;
+            if (node.failed) return -1;
+        }
+        return 1;
+    }
+
+public:
+    unsigned int add(const string &name, Thread thread, const vector<unsigned int> &dependencies, Task task) {
+        /* dependencies have to be added first, so the graph can't have cycles */
+        unique_ptr<Node> node = make_unique<Node>();
+        node->name = name;
+        node->thread = thread;
+        node->dependencies = dependencies;
+        node->task = std::move(task);
+        nodes.push_back(std::move(node));
+        return (unsigned int)nodes.size() - 1;
+    }
+
+    bool run(JobSystem* jobs, bool serialIn = false) {
+        /* returns false if any task failed. Serial runs every task in the order added on this thread, to compare against */
+        serial = serialIn || !jobs;
+        graphStart = Clock::now();
+
+        JobSystem::Counter counter;
+        unsigned int remaining = (unsigned int)nodes.size();
+        while (remaining > 0) {
+            bool progressed = false;
+
+            /* hand every ready worker task out first, so they start before the main thread gets busy */
+            for (unsigned int i = 0; i < nodes.size(); i++) {
+                Node &node = *nodes[i];
+                if (node.started || node.thread != Thread::Worker || serial) continue;
+                int ready = state(i);
+                if (ready == 0) continue;
+
+                node.started = true;
+                progressed = true;
+                if (ready < 0) {
+                    node.failed = true;
+                    node.finished.store(true, memory_order_release);
+                    continue;
+                }
+                Node* running = &node;
+                jobs->spawn(counter, [running] { runNode(*running); });
+            }
+
+            /* then run one ready main task */
+            for (unsigned int i = 0; i < nodes.size(); i++) {
+                Node &node = *nodes[i];
+                if (node.started || (node.thread == Thread::Worker && !serial)) continue;
+                int ready = state(i);
+                if (ready == 0) continue;
+
+                node.started = true;
+                progressed = true;
+                if (ready < 0) {
+                    node.failed = true;
+                    node.finished.store(true, memory_order_release);
+                } else {
+                    runNode(node);
+                }
+                node.counted = true;
+                remaining --;
+                break;
+            }
+
+            /* count worker tasks as done once they have finished */
+            for (const unique_ptr<Node> &node: nodes) {
+                if (node->counted || !node->started || !node->finished.load(memory_order_acquire)) continue;
+                node->counted = true;
+                remaining --;
+                progressed = true;
+            }
+
+            /* everything left is waiting on workers, so help them rather than spin */
+            if (!progressed && !(jobs && jobs->help())) this_thread::yield();
+        }
+        if (jobs) jobs->wait(counter);
+
+        graphEnd = Clock::now();
+        for (const unique_ptr<Node> &node: nodes) if (node->failed) return false;
+        return true;
+    }
+
+    double totalMs() const { return msBetween(graphStart, graphEnd); }
+
+    void report() const {
+        /* when each task ran, relative to the start of the graph */
+        cout << "Startup tasks (" << (serial ? "serial" : "parallel") << "), " << totalMs() << " ms:" << endl;
+        for (const unique_ptr<Node> &node: nodes) {
+            cout << "  " << left << setw(16) << node->name << right;
+            if (node->failed && node->start == Clock::time_point()) {
+                cout << " skipped" << endl;
+                continue;
+            }
+            cout << " " << (node->thread == Thread::Main || serial ? "main  " : "worker") << " "
+                 << fixed << setprecision(1) << msBetween(graphStart, node->start) << " -> " << msBetween(graphStart, node->end) << " ms"
+                 << (node->failed ? " (failed)" : "") << defaultfloat << setprecision(6) << endl;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+using namespace std;
+
+using Clock = chrono::steady_clock;
+
+inline double msBetween(Clock::time_point start, Clock::time_point end) {
+    return chrono::duration<double, milli>(end - start).count();
+}
+
+/* Accumulates the time spent in one stage of a frame.
+One thread may add to it while another reads the totals. */
+class StageTimer {
+    atomic<uint64_t> totalNs{0};
+    atomic<uint64_t> samples{0};
+
+public:
+    void add(Clock::duration duration) {
+        totalNs.fetch_add(chrono::duration_cast<chrono::nanoseconds>(duration).count(), memory_order_relaxed);
+        samples.fetch_add(1, memory_order_relaxed);
+    }
+    double totalMs() const { return totalNs.load(memory_order_relaxed) / 1e6; }
+    uint64_t count() const { return samples.load(memory_order_relaxed); }
+    double averageMs() const {
+        uint64_t n = count();
+        return n ? totalMs() / n : 0.0;
+    }
+    void reset() {
+        totalNs.store(0, memory_order_relaxed);
+        samples.store(0, memory_order_relaxed);
+    }
+};
+
+/* Adds the time until the end of the scope to a StageTimer */
+class ScopedStage {
+    StageTimer &timer;
+    Clock::time_point start;
+
+public:
+    ScopedStage(StageTimer &timerIn) : timer(timerIn), start(Clock::now()) {}
+    ~ScopedStage() { timer.add(Clock::now() - start); }
+};
+
+#endif
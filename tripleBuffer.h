@@ -0,0 +1,48 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+/* A lock-free way to hand the newest value from exactly one writer thread to exactly one reader thread, when only the newest matters.
+There are three slots: the writer's, the reader's, and a spare. Publishing swaps the writer's slot with the spare and marks it new,
+taking the newest swaps the reader's slot with the spare if it is new. Neither ever waits for the other, nor copies more than one value,
+and unlike a queue the writer can publish as often as it likes without filling anything up. */
+template <typename T>
+class TripleBuffer {
+    static const uint8_t fresh = 4; // set on the spare's index when it holds a value the reader hasn't taken
+
+    T slots[3];
+    alignas(64) atomic<uint8_t> spare{2};
+    alignas(64) uint8_t writing = 0; // only touched by the writer
+    alignas(64) uint8_t reading = 1; // only touched by the reader
+
+public:
+    T& back() {
+        /* writer only: the slot to fill before publish() */
+        return slots[writing];
+    }
+    bool publish() {
+        /* writer only: hands back() to the reader, and takes the spare as the next back().
+        Returns false if that replaced a value the reader never took */
+        uint8_t old = spare.exchange(writing | fresh, memory_order_acq_rel);
+        writing = old & ~fresh;
+        return !(old & fresh);
+    }
+    bool publish(const T &value) {
+        back() = value;
+        return publish();
+    }
+
+    bool latest(T &value) {
+        /* reader only: copies the newest value published into value, returns false if nothing new was published since the last call */
+        if (!(spare.load(memory_order_relaxed) & fresh)) return false;
+        reading = spare.exchange(reading, memory_order_acq_rel) & ~fresh;
+        value = slots[reading];
+        return true;
+    }
+};
+
+#endif
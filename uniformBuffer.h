@@ -0,0 +1,115 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include "shader.h" // glad is included here
+#include <array>
+#include <cstring>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/* ---------------------------- std140 member rules ---------------------------- */
+/* The base alignment and size std140 gives each member type, undefined for the ones we don't support */
+template <typename T> struct Std140Traits;
+
+template <> struct Std140Traits<float> { static constexpr size_t align = 4, size = 4; };
+template <> struct Std140Traits<int> { static constexpr size_t align = 4, size = 4; };
+template <> struct Std140Traits<unsigned int> { static constexpr size_t align = 4, size = 4; };
+template <> struct Std140Traits<glm::vec2> { static constexpr size_t align = 8, size = 8; };
+template <> struct Std140Traits<glm::vec3> { static constexpr size_t align = 16, size = 12; }; // a following scalar can fill the gap
+template <> struct Std140Traits<glm::vec4> { static constexpr size_t align = 16, size = 16; };
+template <> struct Std140Traits<glm::mat4> { static constexpr size_t align = 16, size = 64; }; // four vec4 columns, as glm stores them
+
+/* The std140 layout of a block whose members have these types, in order.
+A block used as an array element is padded to 16 bytes, so size is also the array stride. */
+template <typename... Fields>
+struct Std140Layout {
+    static constexpr size_t count = sizeof...(Fields);
+
+    /* byte offset of each member, rounded up to its base alignment */
+    static constexpr auto offsets = [] {
+        constexpr size_t aligns[] = {Std140Traits<Fields>::align...};
+        constexpr size_t sizes[] = {Std140Traits<Fields>::size...};
+        std::array<size_t, sizeof...(Fields)> result{};
+        size_t offset = 0;
+        for (size_t i = 0; i < sizeof...(Fields); i++) {
+            offset = (offset + aligns[i] - 1) & ~(aligns[i] - 1);
+            result[i] = offset;
+            offset += sizes[i];
+        }
+        return result;
+    }();
+    static constexpr size_t size = (offsets[count - 1] + Std140Traits<typename tuple_element<count - 1, tuple<Fields...>>::type>::size + 15) & ~(size_t)15;
+
+    /* Writes the members into dst at their std140 offsets */
+    static void write(unsigned char* dst, const tuple<const Fields&...> &values) {
+        write(dst, values, std::index_sequence_for<Fields...>{});
+    }
+
+private:
+    template <size_t... I>
+    static void write(unsigned char* dst, const tuple<const Fields&...> &values, std::index_sequence<I...>) {
+        (memcpy(dst + offsets[I], &get<I>(values), Std140Traits<Fields>::size), ...);
+    }
+};
+
+/* A C++ struct describes its uniform block by returning its members from fields() with tie(), in the block's order.
+This turns that into the block's layout, eg. Std140Of<FrameUniforms>::size */
+template <typename Tuple> struct Std140FromTie;
+template <typename... Fields> struct Std140FromTie<tuple<const Fields&...>> { using type = Std140Layout<Fields...>; };
+
+template <typename Block>
+using Std140Of = typename Std140FromTie<decltype(declval<const Block&>().fields())>::type;
+
+/* ---------------------------- Uniform buffer ---------------------------- */
+/* An array of one C++ uniform block, packed to std140 on the CPU and uploaded with one call.
+Shaders declare the block at the binding point it was made with, see Shader::bindUniformBlock. */
+template <typename Block>
+class UniformBuffer {
+    using Layout = Std140Of<Block>;
+
+    unsigned int UBO;
+    unsigned int binding;
+    unsigned int capacity; // how many blocks the buffer holds
+    vector<unsigned char> staging; // the packed blocks, rewritten every update
+
+public:
+    UniformBuffer(unsigned int capacityIn, unsigned int bindingIn) : binding(bindingIn), capacity(capacityIn), staging(capacityIn * Layout::size) {
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, staging.size(), nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    static constexpr size_t stride() { return Layout::size; }
+    unsigned int getBinding() const { return binding; }
+    unsigned int getCapacity() const { return capacity; }
+
+    void set(unsigned int index, const Block &block) {
+        /* packs one block into the staging copy, nothing reaches the GPU until upload() */
+        if (index >= capacity) return;
+        Layout::write(staging.data() + index * Layout::size, block.fields());
+    }
+
+    void upload(unsigned int count) {
+        /* orphans the buffer and sends the first count blocks, then binds it to its binding point */
+        if (count > capacity) count = capacity;
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, staging.size(), nullptr, GL_STREAM_DRAW);
+        if (count) glBufferSubData(GL_UNIFORM_BUFFER, 0, count * Layout::size, staging.data());
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        bind();
+    }
+
+    void bind() {
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, UBO);
+    }
+
+    void del() {
+        glDeleteBuffers(1, &UBO);
+    }
+};
+
+#endif
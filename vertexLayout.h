@@ -0,0 +1,125 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include "shader.h" // glad is included here
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/* ---------------------------- Attribute semantics ---------------------------- */
+/* Each semantic fixes the shader location its attribute is bound to */
+struct Position { static constexpr unsigned int location = 0; };
+struct UV { static constexpr unsigned int location = 1; };
+struct Normal { static constexpr unsigned int location = 2; };
+struct Colour { static constexpr unsigned int location = 3; };
+
+/* ---------------------------- Compact component types ---------------------------- */
+/* These are plain storage types, the GPU does the conversion back to floats */
+struct half2 { uint16_t x, y; }; // two GL_HALF_FLOATs
+struct half4 { uint16_t x, y, z, w; }; // four GL_HALF_FLOATs
+struct snorm16x2 { int16_t x, y; }; // two GL_SHORTs normalized to [-1, 1]
+struct unorm8x4 { uint8_t r, g, b, a; }; // four GL_UNSIGNED_BYTEs normalized to [0, 1]
+struct snorm10x3_2 { uint32_t bits; }; // GL_INT_2_10_10_10_REV normalized, xyz in the low 30 bits
+
+/* Maps a C++ attribute type to how OpenGL should read it */
+template <typename T> struct AttrTraits; // undefined for unsupported types, so they fail to compile
+
+template <> struct AttrTraits<float> { static constexpr GLint components = 1; static constexpr GLenum type = GL_FLOAT; static constexpr bool normalized = false; };
+template <> struct AttrTraits<glm::vec2> { static constexpr GLint components = 2; static constexpr GLenum type = GL_FLOAT; static constexpr bool normalized = false; };
+template <> struct AttrTraits<glm::vec3> { static constexpr GLint components = 3; static constexpr GLenum type = GL_FLOAT; static constexpr bool normalized = false; };
+template <> struct AttrTraits<glm::vec4> { static constexpr GLint components = 4; static constexpr GLenum type = GL_FLOAT; static constexpr bool normalized = false; };
+template <> struct AttrTraits<half2> { static constexpr GLint components = 2; static constexpr GLenum type = GL_HALF_FLOAT; static constexpr bool normalized = false; };
+template <> struct AttrTraits<half4> { static constexpr GLint components = 4; static constexpr GLenum type = GL_HALF_FLOAT; static constexpr bool normalized = false; };
+template <> struct AttrTraits<snorm16x2> { static constexpr GLint components = 2; static constexpr GLenum type = GL_SHORT; static constexpr bool normalized = true; };
+template <> struct AttrTraits<unorm8x4> { static constexpr GLint components = 4; static constexpr GLenum type = GL_UNSIGNED_BYTE; static constexpr bool normalized = true; };
+template <> struct AttrTraits<snorm10x3_2> { static constexpr GLint components = 4; static constexpr GLenum type = GL_INT_2_10_10_10_REV; static constexpr bool normalized = true; };
+
+/* One attribute of a vertex: its storage type and what it means */
+template <typename T, typename Semantic>
+struct Attr {
+    using type = T;
+    using semantic = Semantic;
+    using traits = AttrTraits<T>;
+
+    static_assert(sizeof(T) % 4 == 0, "vertex attributes must be a multiple of 4 bytes");
+};
+
+/* A vertex layout known entirely at compile time.
+The attributes are packed in order with no padding between them,
+so a matching vertex struct holds exactly these members in this order. */
+template <typename... Attrs>
+struct VertexLayout {
+    static constexpr size_t count = sizeof...(Attrs);
+    static constexpr size_t sizes[] = {sizeof(typename Attrs::type)...};
+    static constexpr size_t stride = (sizeof(typename Attrs::type) + ...);
+
+    /* byte offset of each attribute within a vertex */
+    static constexpr auto offsets = [] {
+        std::array<size_t, sizeof...(Attrs)> result{};
+        size_t offset = 0;
+        for (size_t i = 0; i < sizeof...(Attrs); i++) {
+            result[i] = offset;
+            offset += sizes[i];
+        }
+        return result;
+    }();
+
+    /* Checks at compile time that a vertex struct can be uploaded with this layout: its members must be the attributes' types, in order.
+A structured binding names a struct's members in the order they are declared, and fails to compile unless it names every one,
+so matching the types it sees checks the count, the order and the types. A standard layout struct keeps its members in that order,
+and one the size of the stride has no padding between them, so each member is then at its attribute's offset too.
+A layout of one attribute may also be uploaded straight from an array of that attribute's type. */
+    template <typename Vertex>
+    static constexpr void check() {
+        static_assert(std::is_standard_layout_v<Vertex> && std::is_trivially_copyable_v<Vertex>, "vertices must be plain structs");
+        static_assert(sizeof(Vertex) == stride, "vertex struct size does not match the layout's stride");
+        if constexpr (!(count == 1 && (std::is_same_v<Vertex, typename Attrs::type> && ...))) {
+            static_assert(std::is_aggregate_v<Vertex>, "vertices must be plain structs, so their members can be checked");
+            static_assert(std::is_same_v<typename decltype(memberTypes<Vertex>())::type, std::tuple<typename Attrs::type...>>,
+                          "vertex struct members do not match the layout's attribute types in order");
+        }
+    }
+
+    /* Points the attributes of the bound VAO at the bound VBO */
+    static void apply() {
+        apply(std::index_sequence_for<Attrs...>{});
+    }
+
+private:
+    template <typename Vertex>
+    static auto memberTypes() {
+        /* only used unevaluated, for the types of the vertex's members in declaration order */
+        Vertex v{};
+        static_assert(count <= 4, "layouts have at most one attribute per semantic");
+        if constexpr (count == 1) { auto &[a] = v; return std::type_identity<std::tuple<std::remove_cvref_t<decltype(a)>>>{}; }
+        else if constexpr (count == 2) {
+            auto &[a, b] = v;
+            return std::type_identity<std::tuple<std::remove_cvref_t<decltype(a)>, std::remove_cvref_t<decltype(b)>>>{};
+        } else if constexpr (count == 3) {
+            auto &[a, b, c] = v;
+            return std::type_identity<std::tuple<std::remove_cvref_t<decltype(a)>, std::remove_cvref_t<decltype(b)>, std::remove_cvref_t<decltype(c)>>>{};
+        } else {
+            auto &[a, b, c, d] = v;
+            return std::type_identity<std::tuple<std::remove_cvref_t<decltype(a)>, std::remove_cvref_t<decltype(b)>, std::remove_cvref_t<decltype(c)>,
+                                                 std::remove_cvref_t<decltype(d)>>>{};
+        }
+    }
+
+    template <size_t... I>
+    static void apply(std::index_sequence<I...>) {
+        (enable<Attrs>(offsets[I]), ...);
+    }
+
+    template <typename A>
+    static void enable(size_t offset) {
+        glVertexAttribPointer(A::semantic::location, A::traits::components, A::traits::type,
+                              A::traits::normalized ? GL_TRUE : GL_FALSE, (GLsizei)stride, (void*)offset);
+        glEnableVertexAttribArray(A::semantic::location);
+    }
+};
+
+#endif
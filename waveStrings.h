@@ -0,0 +1,139 @@
+#ifndef WAVE_STRINGS_H
+#define WAVE_STRINGS_H
+
+#include "jobSystem.h"
+#include "simd.h"
+#include <cstdint>
+#include <cstring>
+#include <math.h>
+#include <vector>
+
+using namespace std;
+
+/* Curves that move like vibrating strings: the 1D wave equation over each curve's samples, with damping and random plucks.
+
+Each step, 1/60 s, is a few explicit substeps of
+    next = u + (1 - damping) (u - previous) + c^2 (left - 2u + right)
+with the ends held at 0. next only depends on previous at the same sample, so it overwrites previous and the two buffers swap roles.
+
+The work is cache blocked by string: one job runs every substep of a string while its two buffers (2 x 16 KB at 4096 samples)
+sit in L1, rather than sweeping every string once per substep and streaming all of them through memory each time.
+Strings are independent, so they run in parallel, and the samples of each four at a time in a float4. */
+class WaveStrings {
+    unsigned int numStrings, samples;
+    bool vectorize;
+
+    vector<float> bufferA, bufferB; // numStrings x samples each
+    bool flipped = false; // true once bufferB holds the current heights
+    vector<uint32_t> randomState; // one generator per string, so the plucks don't depend on which thread runs a string
+
+    /* c^2 of the scheme, which is stable up to 1: the waves travel 0.9 samples a substep */
+    static constexpr float courant2 = 0.81f;
+    static constexpr float damping = 0.0004f;
+    static constexpr unsigned int substeps = 4;
+    /* each string is plucked every 4 seconds on average, with a bump this many samples wide out of 4096 */
+    static constexpr float pluckChance = 1.0f / 240.0f;
+    static constexpr float pluckWidth = 24.0f;
+
+    float* current(unsigned int s) { return (flipped ? bufferB : bufferA).data() + (size_t)s * samples; }
+    float* previous(unsigned int s) { return (flipped ? bufferA : bufferB).data() + (size_t)s * samples; }
+
+    float random(unsigned int s) {
+        /* xorshift32, in [0, 1) */
+        uint32_t &x = randomState[s];
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return (x >> 8) * (1.0f / 16777216.0f);
+    }
+
+    void pluck(unsigned int s, float* u, float* p) {
+        /* a bump at rest, which splits into two pulses running apart */
+        if (random(s) >= pluckChance) return;
+        float centre = (0.1f + 0.8f * random(s)) * samples;
+        float width = pluckWidth * samples / 4096.0f;
+        float height = (random(s) < 0.5f ? -1.0f : 1.0f) * (0.4f + 0.6f * random(s));
+
+        int first = max(1, (int)(centre - 4.0f * width)), last = min((int)samples - 1, (int)(centre + 4.0f * width));
+        for (int i = first; i < last; i++) {
+            float d = (i - centre) / width;
+            float bump = height * exp(-d * d);
+            u[i] += bump;
+            p[i] += bump;
+        }
+    }
+
+    void substep(const float* u, float* p) const {
+        /* writes the next heights over previous, p */
+        const float keep = 1.0f - damping;
+        unsigned int i = 1;
+        if (vectorize) {
+            const float4 keep4 = splat4(keep), c4 = splat4(courant2), two = splat4(2.0f);
+            for (; i + 4 < samples; i += 4) {
+                float4 centre = load4(u + i), left = load4(u + i - 1), right = load4(u + i + 1);
+                float4 laplacian = left + right - two * centre;
+                store4(p + i, centre + keep4 * (centre - load4(p + i)) + c4 * laplacian);
+            }
+        }
+        for (; i + 1 < samples; i++) {
+            float centre = u[i];
+            p[i] = centre + keep * (centre - p[i]) + courant2 * (u[i - 1] + u[i + 1] - 2.0f * centre);
+        }
+    }
+
+public:
+    /* vectorize = false runs the same solver a sample at a time, to measure against */
+    WaveStrings(unsigned int numStringsIn, unsigned int samplesIn, bool vectorizeIn = true)
+        : numStrings(numStringsIn), samples(max(samplesIn, 3u)), vectorize(vectorizeIn) {
+        bufferA.assign((size_t)numStrings * samples, 0.0f);
+        bufferB.assign((size_t)numStrings * samples, 0.0f);
+        randomState.resize(numStrings);
+        for (unsigned int s = 0; s < numStrings; s++) randomState[s] = 2654435761u * (s + 1);
+    }
+
+    unsigned int strings() const { return numStrings; }
+    unsigned int samplesPerString() const { return samples; }
+
+    /* sample updates per step, for throughput figures */
+    double updatesPerStep() const { return (double)numStrings * (samples - 2) * substeps; }
+
+    void advance(JobSystem* jobs, float* heights = nullptr, bool blocked = true) {
+        /* steps every string on by 1/60 s, then copies the heights to heights (numStrings x samples) if given,
+        eg. straight into a mapped vertex buffer. blocked = false sweeps all the strings once per substep instead */
+        parallelFor(jobs, 0, numStrings, 8, [&](size_t first, size_t last) {
+            for (size_t s = first; s < last; s++) pluck((unsigned int)s, current((unsigned int)s), previous((unsigned int)s));
+        });
+
+        if (blocked) {
+            parallelFor(jobs, 0, numStrings, 8, [&](size_t first, size_t last) {
+                for (size_t s = first; s < last; s++) {
+                    float *u = current((unsigned int)s), *p = previous((unsigned int)s);
+                    for (unsigned int step = 0; step < substeps; step++) {
+                        substep(u, p);
+                        swap(u, p);
+                    }
+                    if (heights) memcpy(heights + s * samples, u, samples * sizeof(float));
+                }
+            });
+        } else {
+            for (unsigned int step = 0; step < substeps; step++) {
+                bool odd = step % 2 == 1;
+                parallelFor(jobs, 0, numStrings, 8, [&](size_t first, size_t last) {
+                    for (size_t s = first; s < last; s++) {
+                        if (odd) substep(previous((unsigned int)s), current((unsigned int)s));
+                        else substep(current((unsigned int)s), previous((unsigned int)s));
+                    }
+                });
+            }
+        }
+        if (substeps % 2 == 1) flipped = !flipped;
+
+        if (heights && !blocked) {
+            parallelFor(jobs, 0, numStrings, 8, [&](size_t first, size_t last) {
+                for (size_t s = first; s < last; s++) memcpy(heights + s * samples, current((unsigned int)s), samples * sizeof(float));
+            });
+        }
+    }
+};
+
+#endif